@@ -0,0 +1,69 @@
+-- Random reads: blocking f:read and io.async with several coroutines.
+-- os.clock counts the CPU time of all threads, so this shows the cost per
+-- operation; with a cached file there is no device latency to overlap.
+-- usage: lua bench/async.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+-- a 64 MB file, and random block-aligned offsets into it
+local SIZE = 64 * 1024 * 1024
+local path = os.tmpname()
+do
+    local f     = assert(io.open(path, "wb"))
+    local block = string.rep("0123456789abcdef", 4096)  -- 64 KB
+    for _ = 1, SIZE / #block do f:write(block) end
+    f:close()
+end
+
+local function offsets(n, size)
+    local t, x = {}, 1
+    for i = 1, n do
+        x = (x * 1103515245 + 12345) % 2147483648
+        t[i] = (x % (SIZE / size)) * size
+    end
+    return t
+end
+
+local function blocking(offs, size)
+    local f = assert(io.open(path, "rb"))
+    for i = 1, #offs do
+        f:seek("set", offs[i])
+        local s = f:read(size)
+    end
+    f:close()
+end
+
+-- `nco' coroutines share the reads
+local function async(offs, size, nco)
+    local f = assert(io.open(path, "rb"))
+    for c = 1, nco do
+        io.async.spawn(function()
+            for i = c, #offs, nco do
+                local s = io.async.read(f, offs[i], size)
+            end
+        end)
+    end
+    io.async.run()
+    f:close()
+end
+
+
+local big, small = offsets(2048, 65536), offsets(20000, 4096)
+local ok = io.async and pcall(io.async.read, io.stdin, 0, 0)
+bench("f:read 64 KB, 2048", blocking, big, 65536)
+if ok then
+    for _, nco in ipairs{1, 8, 64} do
+        bench("io.async 64 KB, 2048, " .. nco .. " coroutines", async,
+              big, 65536, nco)
+    end
+end
+bench("f:read 4 KB, 2*10^4", blocking, small, 4096)
+if ok then
+    for _, nco in ipairs{1, 8, 64} do
+        bench("io.async 4 KB, 2*10^4, " .. nco .. " coroutines", async,
+              small, 4096, nco)
+    end
+end
+
+os.remove(path)
@@ -0,0 +1,21 @@
+-- Timing helper shared by the benchmark scripts, which load it with
+--     local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+-- bench(name, f, ...) prints the best time of five runs of f(...);
+-- best(f, ...), the second result, returns that time in seconds.
+
+local function best(f, ...)
+    local t0 = math.huge
+    for _ = 1, 5 do
+        collectgarbage()
+        local t = os.clock()
+        f(...)
+        t0 = math.min(t0, os.clock() - t)
+    end
+    return t0
+end
+
+local function bench(name, f, ...)
+    print(string.format("%-40s %8.1f ms", name, best(f, ...) * 1000))
+end
+
+return bench, best
@@ -0,0 +1,30 @@
+-- Sweeping with and without the background freeing thread.
+-- usage: lua bench/bgsweep.lua [0 | 1]
+-- The helper thread only pays off with a second core to run on.
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local on = (tonumber(arg[1]) or 0) ~= 0
+local ok, prev = pcall(collectgarbage, "bgsweep", on and 1 or 0)
+if on and not (ok and prev >= 0) then
+    print("bgsweep not available")
+    return
+end
+local name = on and "bgsweep on" or "bgsweep off"
+
+-- rounds of 30000 small tables, keeping the last few rounds alive, so
+-- that every cycle has a lot of dead objects to free
+local function churn(rounds)
+    local keep = {}
+    for r = 1, rounds do
+        local t = {}
+        for i = 1, 30000 do
+            t[i] = {i, i .. "", {}}
+        end
+        keep[r % 4] = t
+    end
+end
+
+
+bench(name .. ", 60 rounds x 30000", churn, 60)
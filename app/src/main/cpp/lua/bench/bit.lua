@@ -0,0 +1,85 @@
+-- Bit operations: the `bit' library against the same code in arithmetic.
+-- usage: lua bench/bit.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+-- what plain Lua 5.1 code does without a bit library
+local floor = math.floor
+
+local function exor(a, b)
+    local r, p = 0, 1
+    for _ = 1, 32 do
+        local x, y = a % 2, b % 2
+        if x ~= y then r = r + p end
+        a, b, p = (a - x) / 2, (b - y) / 2, p * 2
+    end
+    return r
+end
+
+local function eand(a, b)
+    local r, p = 0, 1
+    for _ = 1, 32 do
+        local x, y = a % 2, b % 2
+        if x + y == 2 then r = r + p end
+        a, b, p = (a - x) / 2, (b - y) / 2, p * 2
+    end
+    return r
+end
+
+local function ershift(a, n)
+    return floor(a % 4294967296 / 2 ^ n)
+end
+
+local function crctable(xor, rshift, band)
+    local t = {}
+    for i = 0, 255 do
+        local c = i
+        for _ = 1, 8 do
+            if band(c, 1) == 1 then c = xor(rshift(c, 1), 0xEDB88320)
+            else c = rshift(c, 1) end
+        end
+        t[i] = c
+    end
+    return t
+end
+
+local data = {}
+do
+    local x = 1
+    for i = 1, 200 * 1024 do
+        x = (x * 1103515245 + 12345) % 2147483648
+        data[i] = x % 256
+    end
+end
+
+local function crc32(n, xor, rshift, band)
+    local t = crctable(xor, rshift, band)
+    local c = 0xFFFFFFFF
+    for i = 1, n do
+        c = xor(t[band(xor(c, data[i]), 0xFF)], rshift(c, 8))
+    end
+    return xor(c, 0xFFFFFFFF)
+end
+
+-- xorshift32, a typical mix of shifts and xors
+local function xorshift(n)
+    local bxor, lshift, rshift = bit.bxor, bit.lshift, bit.rshift
+    local x = 2463534242
+    for _ = 1, n do
+        x = bxor(x, lshift(x, 13))
+        x = bxor(x, rshift(x, 17))
+        x = bxor(x, lshift(x, 5))
+    end
+    return x
+end
+
+
+bench("crc32 of 20 KB, emulated", crc32, 20 * 1024, exor, ershift, eand)
+if bit then
+    bench("crc32 of 20 KB, bit", crc32, 20 * 1024, bit.bxor, bit.rshift,
+          bit.band)
+    bench("crc32 of 200 KB, bit", crc32, 200 * 1024, bit.bxor, bit.rshift,
+          bit.band)
+    bench("xorshift32, 10^6", xorshift, 1000000)
+end
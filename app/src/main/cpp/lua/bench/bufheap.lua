@@ -0,0 +1,60 @@
+-- Building 10 MB results: table.concat, string.rep, gsub and read("*a").
+-- "alloc" is what the build allocates with the collector stopped, so it
+-- counts the intermediate strings too.
+-- usage: lua bench/bufheap.lua
+
+local _, best = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local function bench(name, f, ...)
+    local t = best(f, ...)
+    collectgarbage()
+    collectgarbage("stop")
+    local before = collectgarbage("count")
+    local r = f(...)
+    local alloc = collectgarbage("count") - before
+    collectgarbage("restart")
+    print(string.format("%-30s %8.1f ms %8.1f MB alloc", name, t * 1000,
+                        alloc / 1024))
+end
+
+
+local SIZE = 10 * 1024 * 1024
+
+local parts = {}
+for i = 1, SIZE / 16 do parts[i] = string.format("%15d,", i) end
+local text = table.concat(parts)
+
+local path = os.tmpname()
+do
+    local f = assert(io.open(path, "wb"))
+    f:write(text)
+    f:close()
+end
+
+local function concat()
+    return table.concat(parts)
+end
+
+local function rep()
+    return string.rep("0123456789abcdef", SIZE / 16)
+end
+
+local function gsub()
+    return (text:gsub(",", ";"))
+end
+
+local function readall()
+    local f = assert(io.open(path, "rb"))
+    local s = f:read("*a")
+    f:close()
+    return s
+end
+
+
+bench("table.concat, 10 MB", concat)
+bench("string.rep, 10 MB", rep)
+bench("gsub, 10 MB", gsub)
+bench("read('*a'), 10 MB", readall)
+
+os.remove(path)
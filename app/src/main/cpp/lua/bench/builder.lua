@@ -0,0 +1,79 @@
+-- Building a string from many pieces: `..', table.concat and string.builder.
+-- usage: lua bench/builder.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local piece = "0123456789abcdef"
+
+local function concat(n)
+    local s = ""
+    for _ = 1, n do s = s .. piece end
+    return s
+end
+
+local function tconcat(n)
+    local t = {}
+    for i = 1, n do t[i] = piece end
+    return table.concat(t)
+end
+
+local function builder(n)
+    local b = string.builder()
+    for _ = 1, n do b:add(piece) end
+    return b:tostring()
+end
+
+local function builder4(n)
+    local b = string.builder()
+    for _ = 1, n, 4 do b:add(piece, piece, piece, piece) end
+    return b:tostring()
+end
+
+local function tformat(n)
+    local t = {}
+    for i = 1, n do t[i] = string.format("%d:%s;", i, piece) end
+    return table.concat(t)
+end
+
+local function addf(n)
+    local b = string.builder()
+    for i = 1, n do b:addf("%d:%s;", i, piece) end
+    return b:tostring()
+end
+
+-- one builder (or table) reused for many small results
+local function treuse(n)
+    local t = {}
+    for i = 1, n do
+        for j = 1, 8 do t[j] = piece end
+        local s = table.concat(t, "", 1, 8)
+    end
+end
+
+local function breuse(n)
+    local b = string.builder()
+    for i = 1, n do
+        b:clear()
+        for j = 1, 8 do b:add(piece) end
+        local s = b:tostring()
+    end
+end
+
+
+bench("s = s .. x, 2*10^4", concat, 20000)
+bench("table.concat, 2*10^4", tconcat, 20000)
+bench("table.concat, 10^6", tconcat, 1000000)
+if string.builder then
+    bench("builder add, 2*10^4", builder, 20000)
+    bench("builder add, 10^6", builder, 1000000)
+    bench("builder add 4 at a time, 10^6", builder4, 1000000)
+end
+bench("table of string.format, 10^5", tformat, 100000)
+if string.builder then
+    bench("builder addf, 10^5", addf, 100000)
+end
+bench("table.concat of 8, reused, 10^5", treuse, 100000)
+if string.builder then
+    bench("builder of 8, cleared, 10^5", breuse, 100000)
+end
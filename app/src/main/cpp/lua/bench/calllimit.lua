@@ -0,0 +1,49 @@
+-- Deep recursion: stack growth, the overflow error, and ordinary calls.
+-- usage: lua bench/calllimit.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local function down(n)
+    if n == 0 then return 0 end
+    return 1 + down(n - 1)
+end
+
+-- each descent in a new coroutine, whose stack starts small
+local function fresh(n)
+    for _ = 1, 10 do
+        local co = coroutine.create(down)
+        assert(coroutine.resume(co, n))
+    end
+end
+
+-- the same coroutine again and again, with its stack already grown
+local co = coroutine.wrap(function(n)
+    while true do n = coroutine.yield(down(n)) end
+end)
+local function grown(n)
+    for _ = 1, 10 do co(n) end
+end
+
+local function overflow()
+    local function inf(n) return 1 + inf(n + 1) end
+    for _ = 1, 10 do assert(not pcall(inf, 1)) end
+end
+
+local function fib(n)
+    if n < 2 then return n end
+    return fib(n - 1) + fib(n - 2)
+end
+
+
+bench("10 descents to 15000, new stacks", fresh, 15000)
+bench("10 descents to 15000, grown stack", grown, 15000)
+bench("10 stack overflows", overflow)
+bench("fib(27)", fib, 27)
+-- past the built-in limit, where the state allows it
+local old = debug.setcalllimit and debug.setcalllimit(200000)
+if old and old ~= 0 then
+    bench("10 descents to 10^5, new stacks", fresh, 100000)
+    bench("10 descents to 10^5, grown stack", grown, 100000)
+    debug.setcalllimit(old)
+end
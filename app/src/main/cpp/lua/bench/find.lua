@@ -0,0 +1,45 @@
+-- Plain substring search (string.find with plain = true).
+-- usage: lua bench/find.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+-- a 16 MB log-like subject, with the line searched for at its end
+local words = {"INFO", "DEBUG", "request", "served", "user", "session",
+               "timeout", "ok", "cache", "miss"}
+local lines, n, j = {}, 0, 1
+while n < 16 * 1024 * 1024 do
+    local w = {}
+    for i = 1, 8 do
+        j = (j * 16807) % 2147483647
+        w[i] = words[j % #words + 1]
+    end
+    local l = "1970-01-01 " .. table.concat(w, " ")
+    lines[#lines + 1] = l
+    n = n + #l + 1
+end
+lines[#lines + 1] = "ERROR: see disk usage"
+local subject = table.concat(lines, "\n")
+lines = nil
+
+local function find(needle, reps)
+    for _ = 1, reps do
+        assert(subject:find(needle, 1, true))
+    end
+end
+
+-- many searches in short strings, where setting up a search matters
+local short = {}
+for i = 1, 1000 do short[i] = "key=" .. i .. "; path=/usr/local/lib" end
+local function findshort(reps)
+    for _ = 1, reps do
+        for i = 1, #short do short[i]:find("path=", 1, true) end
+    end
+end
+
+
+bench("rare first byte 'ERROR: see' x 10", find, "ERROR: see", 10)
+bench("common first byte 'see disk usage' x 10", find, "see disk usage", 10)
+bench("space first byte ' disk usage' x 10", find, " disk usage", 10)
+bench("one byte 'R' x 10", find, "R", 10)
+bench("short subjects x 10^6", findshort, 1000)
@@ -0,0 +1,59 @@
+-- Collector pauses with and without a time budget per step.
+-- usage: lua bench/gcbudget.lua [budget in us]
+-- Run each budget in its own process, as the heap left by one run slows
+-- the allocator down for the next. Pauses come from the collector's
+-- histogram: timing Lua code from Lua mostly sees the scheduler.
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local us = tonumber(arg[1]) or 0
+local name = "no budget"
+if us > 0 then
+    if not pcall(collectgarbage, "setbudgetus", us) then
+        print("setbudgetus not available")
+        return
+    end
+    name = us .. " us budget"
+end
+
+-- 300000 small live tables in chunks of 1000 (traversing one table is a
+-- single unit of work that no budget can split); the collector runs with
+-- a large step multiplier, so each step has a lot of work to do
+local old = {}
+for i = 1, 300 do
+    local chunk = {}
+    for j = 1, 1000 do
+        chunk[j] = {i, j}
+    end
+    old[i] = chunk
+end
+collectgarbage("setstepmul", 20000)
+
+local function churn(n)
+    for r = 1, n do
+        local t = {r}
+        if r % 100 == 0 then old[r % 300 + 1][r % 1000 + 1] = t end
+    end
+end
+
+
+bench(name .. ", 2000000 temporaries", churn, 2000000)
+
+-- the collector's own histogram of its pauses: bucket i counts those
+-- shorter than 2^i us
+if pcall(collectgarbage, "pausehist", -1) then
+    collectgarbage()
+    collectgarbage("pausehist", -1)
+    churn(2000000)
+    local longest, over256, over1024 = 0, 0, 0
+    for i = 0, 31 do
+        local n = collectgarbage("pausehist", i)
+        if n > 0 then longest = 2 ^ i end
+        if i > 8 then over256 = over256 + n end
+        if i > 10 then over1024 = over1024 + n end
+    end
+    print(string.format("%-40s %8.1f ms", name .. ", longest pause under", longest / 1000))
+    print(string.format("%-40s %8d", name .. ", pauses over 256 us", over256))
+    print(string.format("%-40s %8d", name .. ", pauses over 1 ms", over1024))
+end
@@ -0,0 +1,53 @@
+-- Incremental and generational collection of a heap with many old objects.
+-- usage: lua bench/gcgen.lua [incremental | generational]
+-- Run each mode in its own process: the heap left by one mode slows the
+-- allocator down for the next.
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local mode = arg[1] or "incremental"
+if mode ~= "incremental" and not pcall(collectgarbage, mode) then
+    print(mode .. " mode not available")
+    return
+end
+
+-- 300000 long-lived tables, then 3000000 short-lived ones; one in a
+-- thousand of the new ones replaces an old one
+local old = {}
+for i = 1, 300000 do
+    old[i] = {i, tostring(i)}
+end
+
+local function churn(n)
+    local sum = 0
+    for r = 1, n do
+        local t = {r}
+        sum = sum + #t
+        if r % 1000 == 0 then old[r % 300000 + 1] = t end
+    end
+end
+
+-- the same, timing every 100 iterations: the slowest ones hold a pause
+local function worstpause(n)
+    local sum, worst, clock = 0, 0, os.clock
+    for b = 0, n / 100 - 1 do
+        local c = clock()
+        for r = b * 100 + 1, b * 100 + 100 do
+            local t = {r}
+            sum = sum + #t
+            if r % 1000 == 0 then old[r % 300000 + 1] = t end
+        end
+        worst = math.max(worst, clock() - c)
+    end
+    return worst
+end
+
+
+bench(mode .. ", 3000000 temporaries", churn, 3000000)
+local worst = math.huge
+for _ = 1, 5 do
+    collectgarbage()
+    worst = math.min(worst, worstpause(3000000))
+end
+print(string.format("%-40s %8.1f ms", mode .. ", longest pause", worst * 1000))
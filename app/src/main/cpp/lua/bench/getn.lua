@@ -0,0 +1,35 @@
+-- The length operator and appends at the end of a sequence.
+-- usage: lua bench/getn.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local function append(n)
+    local t = {}
+    for i = 1, n do t[#t + 1] = i end
+end
+
+local function insert(n)
+    local t = {}
+    for i = 1, n do table.insert(t, i) end
+end
+
+local seq = {}
+for i = 1, 1000000 do seq[i] = i end
+
+local function length(n)
+    local s = 0
+    for _ = 1, n do s = s + #seq end
+end
+
+-- pops everything, then pushes it back for the next run
+local function pop(n)
+    for _ = 1, n do seq[#seq] = nil end
+    for i = 1, n do seq[i] = i end
+end
+
+
+bench("t[#t+1] = v x 1000000", append, 1000000)
+bench("table.insert(t, v) x 1000000", insert, 1000000)
+bench("#t of 10^6 elements x 1000000", length, 1000000)
+bench("t[#t] = nil x 1000000 (+ refill)", pop, 1000000)
@@ -0,0 +1,64 @@
+-- Integer-valued numbers: array indexing, loops and int/float arithmetic.
+-- usage: lua bench/integer.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local function fill(n)
+    local t = {}
+    for i = 1, n do t[i] = i end
+    local s = 0
+    for i = 1, n do s = s + t[i] + t[n - i + 1] + t[(i * 7) % n + 1] end
+    return s
+end
+
+local function sieve(n)
+    local composite = {}
+    for i = 1, n do composite[i] = false end
+    local count = 0
+    for i = 2, n do
+        if not composite[i] then
+            count = count + 1
+            for j = i * i, n, i do composite[j] = true end
+        end
+    end
+    return count
+end
+
+local function append(n)
+    local t = {}
+    for i = 1, n do t[#t + 1] = i end
+    return #t
+end
+
+local function mixed(t)
+    local s = 0.5
+    for i = 1, #t do s = s + t[i] * 0.25 end
+    return s
+end
+
+local function intarith(n)
+    local a, b = 0, 1
+    for i = 1, n do
+        a = (a + i * 3 - b) % 1000003
+        if a < b then b = b + 1 end
+    end
+    return a + b
+end
+
+local function floatarith(n)
+    local x = 0.5
+    for i = 1, n do x = x * 1.000001 + 0.25 end
+    return x
+end
+
+local floats = {}
+for i = 1, 3000000 do floats[i] = i + 0.5 end
+
+
+bench("array fill + 3 reads, 3*10^6", fill, 3000000)
+bench("sieve of Eratosthenes, 2*10^6", sieve, 2000000)
+bench("t[#t + 1] = i, 3*10^6", append, 3000000)
+bench("float sum over int index, 3*10^6", mixed, floats)
+bench("int + - * % < loop, 10^7", intarith, 10000000)
+bench("float * + loop, 10^7", floatarith, 10000000)
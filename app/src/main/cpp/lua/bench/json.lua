@@ -0,0 +1,146 @@
+-- JSON: the json module against a small codec written in plain Lua.
+-- usage: lua bench/json.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+-- the plain Lua codec: enough JSON for the documents below
+local lua = {}
+do
+    local escapes = {['"'] = '\\"', ['\\'] = '\\\\', ['\b'] = '\\b',
+                     ['\f'] = '\\f', ['\n'] = '\\n', ['\r'] = '\\r',
+                     ['\t'] = '\\t'}
+    local function escape(c)
+        return escapes[c] or string.format("\\u%04x", c:byte())
+    end
+
+    local function encode(v, out)
+        local t = type(v)
+        if t == "table" then
+            if #v > 0 or next(v) == nil then
+                out[#out + 1] = "["
+                for i = 1, #v do
+                    if i > 1 then out[#out + 1] = "," end
+                    encode(v[i], out)
+                end
+                out[#out + 1] = "]"
+            else
+                local first = true
+                out[#out + 1] = "{"
+                for k, x in pairs(v) do
+                    if not first then out[#out + 1] = "," end
+                    first = false
+                    encode(tostring(k), out)
+                    out[#out + 1] = ":"
+                    encode(x, out)
+                end
+                out[#out + 1] = "}"
+            end
+        elseif t == "string" then
+            out[#out + 1] = '"' .. v:gsub('[%c"\\]', escape) .. '"'
+        else
+            out[#out + 1] = tostring(v)
+        end
+    end
+
+    function lua.encode(v)
+        local out = {}
+        encode(v, out)
+        return table.concat(out)
+    end
+
+    local decode
+    local function skip(s, i) return s:find("[^ \t\r\n]", i) end
+
+    local unescapes = {b = "\b", f = "\f", n = "\n", r = "\r", t = "\t"}
+    local function decodestring(s, i)
+        local parts, j = {}, i + 1
+        while true do
+            local k = s:find('["\\]', j)
+            parts[#parts + 1] = s:sub(j, k - 1)
+            if s:sub(k, k) == '"' then return table.concat(parts), k + 1 end
+            local c = s:sub(k + 1, k + 1)
+            if c == "u" then
+                parts[#parts + 1] = string.char(tonumber(s:sub(k + 2, k + 5), 16))
+                j = k + 6
+            else
+                parts[#parts + 1] = unescapes[c] or c
+                j = k + 2
+            end
+        end
+    end
+
+    function decode(s, i)
+        i = skip(s, i)
+        local c = s:sub(i, i)
+        if c == "{" then
+            local t = {}
+            i = skip(s, i + 1)
+            if s:sub(i, i) == "}" then return t, i + 1 end
+            while true do
+                local k
+                k, i = decodestring(s, skip(s, i))
+                i = skip(s, i) + 1  -- ':'
+                t[k], i = decode(s, i)
+                i = skip(s, i)
+                if s:sub(i, i) == "}" then return t, i + 1 end
+                i = i + 1  -- ','
+            end
+        elseif c == "[" then
+            local t, n = {}, 0
+            i = skip(s, i + 1)
+            if s:sub(i, i) == "]" then return t, i + 1 end
+            while true do
+                n = n + 1
+                t[n], i = decode(s, i)
+                i = skip(s, i)
+                if s:sub(i, i) == "]" then return t, i + 1 end
+                i = i + 1  -- ','
+            end
+        elseif c == '"' then
+            return decodestring(s, i)
+        elseif c == "t" then return true, i + 4
+        elseif c == "f" then return false, i + 5
+        elseif c == "n" then return nil, i + 4
+        else
+            local j = s:find("[^%d%.eE+-]", i) or #s + 1
+            return tonumber(s:sub(i, j - 1)), j
+        end
+    end
+
+    function lua.decode(s)
+        return (decode(s, 1))
+    end
+end
+
+
+-- 10^4 records and a 200 x 300 matrix of floats
+local records, matrix = {}, {}
+for i = 1, 10000 do
+    records[i] = {id = i, name = "user" .. i, email = "user" .. i .. "@example.com",
+                  active = i % 3 == 0, score = i * 1.5, tags = {"a", "b\tc"}}
+end
+for i = 1, 200 do
+    local row = {}
+    for j = 1, 300 do row[j] = (i * j) / 7 end
+    matrix[i] = row
+end
+
+local function run(codec, name)
+    local r = codec.encode(records)
+    local m = codec.encode(matrix)
+    bench(string.format("%s encode records (%.2f MB)", name, #r / 2^20),
+          codec.encode, records)
+    bench(name .. " decode records", codec.decode, r)
+    bench(string.format("%s encode matrix (%.2f MB)", name, #m / 2^20),
+          codec.encode, matrix)
+    bench(name .. " decode matrix", codec.decode, m)
+end
+
+
+run(lua, "lua")
+if json then
+    local s = json.encode(records)
+    assert(lua.encode(lua.decode(s)) and #json.decode(s) == #records)
+    run(json, "json")
+end
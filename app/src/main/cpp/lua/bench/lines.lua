@@ -0,0 +1,66 @@
+-- Reading a file line by line: read("*l"), the line iterators and batches.
+-- Short lines average 40 bytes, long ones 400.
+-- usage: lua bench/lines.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+-- `n' lines of up to `w' bytes (about n * w / 2 in all)
+local function newfile(n, w)
+    local path = os.tmpname()
+    local f    = assert(io.open(path, "wb"))
+    local pad  = string.rep("abcdefghij", w / 10)
+    local x    = 1
+    for i = 1, n do
+        x = (x * 1103515245 + 12345) % 2147483648
+        f:write(i, " ", pad:sub(1, x % (w - 10)), "\n")
+    end
+    f:close()
+    return path
+end
+
+local path
+local function readl()
+    local f = assert(io.open(path, "rb"))
+    while f:read("*l") do end
+    f:close()
+end
+
+local function fgetslines()
+    local f = assert(io.open(path, "rb"))
+    for _ in f:lines() do end
+    f:close()
+end
+
+local function iolines(...)
+    for _ in io.lines(path, ...) do end
+end
+
+local function batched(n)
+    local f = assert(io.open(path, "rb"))
+    for t in f:lines("*l", {batch = n}) do
+        for i = 1, #t do local l = t[i] end
+    end
+    f:close()
+end
+
+local function run(name)
+    local f = assert(io.open(path, "rb"))
+    local chunked = pcall(f.read, f, "*L")  -- the newer readers are there
+    f:close()
+    bench(name .. " f:read('*l')", readl)
+    bench(name .. " f:lines()", fgetslines)
+    bench(name .. " io.lines(path)", iolines)
+    if chunked then
+        bench(name .. " io.lines(path, '*L')", iolines, "*L")
+        bench(name .. " f:lines('*l', {batch = 16})", batched, 16)
+        bench(name .. " f:lines('*l', {batch = 256})", batched, 256)
+    end
+    os.remove(path)
+end
+
+
+path = newfile(1000000, 80)
+run("short:")
+path = newfile(200000, 800)
+run("long:")
@@ -0,0 +1,53 @@
+-- Creating, comparing and indexing with long strings.
+-- usage: lua bench/longstr.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local big = string.rep("0123456789abcdef", 65536)  -- 1 MB
+
+-- distinct 4 KB slices of a large string
+local function slices(n)
+    local t = {}
+    for i = 1, n do
+        local k = (i * 37) % (#big - 4096)
+        t[i] = big:sub(k + 1, k + 4096)
+    end
+end
+
+-- concatenation results of about 80 bytes
+local function concat(n)
+    local t = {}
+    for i = 1, n do
+        t[i] = "item " .. i .. " with some longer payload text that goes on"
+    end
+end
+
+-- equality of two long strings built separately (no longer the same object)
+local function equal(n)
+    local a = big:sub(1, 100) .. "!"
+    local b = big:sub(1, 100) .. "!"
+    local c = 0
+    for _ = 1, n do
+        if a == b then c = c + 1 end
+    end
+end
+
+-- long strings as table keys, looked up with equal but separate strings
+local function keys(n)
+    local t, k = {}, {}
+    for i = 1, 1000 do
+        t[string.rep("key", 20) .. i] = i
+        k[i] = string.rep("key", 20) .. i
+    end
+    local s = 0
+    for i = 1, n do
+        s = s + t[k[i % 1000 + 1]]
+    end
+end
+
+
+bench("4 KB slices x 20000", slices, 20000)
+bench("80-byte concatenations x 200000", concat, 200000)
+bench("long string == x 1000000", equal, 1000000)
+bench("long string keys, lookups x 1000000", keys, 1000000)
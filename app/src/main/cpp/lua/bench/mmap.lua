@@ -0,0 +1,98 @@
+-- Random access to a file: seek and read, a string in memory, and io.mmap.
+-- usage: lua bench/mmap.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+-- an 8 MB file, and 2*10^5 random offsets into it
+local SIZE = 8 * 1024 * 1024
+local path = os.tmpname()
+do
+    local f = assert(io.open(path, "wb"))
+    local t = {}
+    for i = 1, 256 do t[i] = string.char(i - 1) end
+    local block = table.concat(t):rep(64)  -- 16 KB
+    for _ = 1, SIZE / #block do f:write(block) end
+    f:write("needle")
+    f:close()
+end
+local offs = {}
+local x = 1
+for i = 1, 200000 do
+    x = (x * 1103515245 + 12345) % 2147483648
+    offs[i] = x % (SIZE - 16)
+end
+
+local function seekread()
+    local f = assert(io.open(path, "rb"))
+    for i = 1, #offs do
+        f:seek("set", offs[i])
+        local s = f:read(16)
+    end
+    f:close()
+end
+
+local function strsub(s)
+    for i = 1, #offs do local p = offs[i] local v = s:sub(p + 1, p + 16) end
+end
+
+local function strbyte(s)
+    local byte = string.byte
+    for i = 1, #offs do
+        local a, b, c, d = byte(s, offs[i] + 1, offs[i] + 4)
+        local v = a + b * 256 + c * 65536 + d * 16777216
+    end
+end
+
+local function readall()
+    local f = assert(io.open(path, "rb"))
+    local s = f:read("*a")
+    f:close()
+    return s
+end
+
+local function strfind(s)
+    return s:find("needle", 1, true)
+end
+
+local function mapsub(m)
+    for i = 1, #offs do local p = offs[i] local v = m:sub(p + 1, p + 16) end
+end
+
+local function mapuint(m)
+    for i = 1, #offs do local v = m:uint(offs[i] + 1, 4) end
+end
+
+-- the cost of the call alone, on bytes that stay in cache
+local function mapcall(m)
+    for _ = 1, 1000000 do local v = m:uint(17, 4) end
+end
+
+local function mapopen()
+    local m = io.mmap(path)
+    m:close()
+end
+
+local function mapfind(m)
+    return m:find("needle", 1, true)
+end
+
+
+local s = readall()
+bench("f:seek + f:read(16), 2*10^5", seekread)
+bench("read('*a'), 8 MB", readall)
+bench("s:sub, 2*10^5", strsub, s)
+bench("string.byte x 4, 2*10^5", strbyte, s)
+bench("s:find plain, 8 MB", strfind, s)
+s = nil
+if io.mmap and pcall(io.mmap, path) then
+    local m = io.mmap(path)
+    bench("io.mmap + close", mapopen)
+    bench("m:sub, 2*10^5", mapsub, m)
+    bench("m:uint(p, 4), 2*10^5", mapuint, m)
+    bench("m:find plain, 8 MB", mapfind, m)
+    bench("m:uint(17, 4), 10^6", mapcall, m)
+    m:close()
+end
+
+os.remove(path)
@@ -0,0 +1,101 @@
+-- Number to string and string to number conversions.
+-- usage: lua bench/numconv.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local N = 1000000
+
+local function tostr_int(n)
+    for i = 1, n do local s = tostring(i) end
+end
+
+local function tostr_frac(n)
+    for i = 1, n do local s = tostring(i / 7) end
+end
+
+local function tostr_short(n)
+    for i = 1, n do local s = tostring(i * 1e-5) end
+end
+
+local function format_d(n)
+    local format = string.format
+    for i = 1, n do local s = format("%d", i) end
+end
+
+local function format_g(n)
+    local format = string.format
+    for i = 1, n do local s = format("%.3f", i / 7) end
+end
+
+local function csv(n)
+    for i = 1, n / 4 do
+        local s = i .. "," .. i * 3 .. "," .. i + 0.5 .. "," .. -i
+    end
+end
+
+local ints, decs = {}, {}
+for i = 1, 1000 do
+    ints[i] = tostring(i * 12345)
+    decs[i] = string.format("%.3f", i * 1.2345)
+end
+
+local function tonum(t, n)
+    for i = 1, n / #t do
+        for j = 1, #t do local x = tonumber(t[j]) end
+    end
+end
+
+-- arithmetic on numeric strings converts them on every use
+local function coerce(n)
+    local s = 0
+    for i = 1, n / #decs do
+        for j = 1, #decs do s = s + decs[j] end
+    end
+    return s
+end
+
+
+-- with LUA_NUMBER_SHORTEST numbers must read back as the same double
+-- from no more digits than the numeral they were read from
+if tostring(0.1 + 0.2) == "0.30000000000000004" then
+    local function ndigits(s)
+        local d = s:match("^[^e]*"):gsub("%.", ""):gsub("^0+", "")
+        return #(d:gsub("0+$", ""))
+    end
+    for _, s in ipairs{"0.07655", "0.08532", "0.000649", "0.1", "0.3",
+                       "1e+23", "5e-324", "2.2250738585072014e-308",
+                       "1.7976931348623157e+308", "0.3333333333333333",
+                       "9007199254740993", "123.456", "1e-05"} do
+        local t = tostring(tonumber(s))
+        assert(t == s or tonumber(t) == tonumber(s) and
+               ndigits(t) <= ndigits(s), s .. " gives " .. t)
+    end
+    math.randomseed(38)
+    for d = 1, 15 do
+        for _ = 1, 20000 do
+            local m = { math.random(1, 9) }
+            for i = 2, d do m[i] = math.random(0, 9) end
+            local s = table.concat(m) .. "e" .. math.random(-300, 290)
+            local x = tonumber(s)
+            local t = tostring(x)
+            assert(tonumber(t) == x and ndigits(t) <= d, s .. " gives " .. t)
+        end
+    end
+    for _ = 1, 200000 do
+        local x = math.random() * 10 ^ math.random(-300, 300)
+        assert(tonumber(tostring(x)) == x, x)
+    end
+    print("shortest round trip ok")
+end
+
+
+bench("tostring(i), 10^6", tostr_int, N)
+bench("tostring(i / 7), 10^6", tostr_frac, N)
+bench("tostring(i * 1e-5), 10^6", tostr_short, N)
+bench("string.format('%d'), 10^6", format_d, N)
+bench("string.format('%.3f'), 10^6", format_g, N)
+bench("CSV line via .., 2.5*10^5", csv, N)
+bench("tonumber('12345678'), 10^6", tonum, ints, N)
+bench("tonumber('123.457'), 10^6", tonum, decs, N)
+bench("x + '123.457', 10^6", coerce, N)
@@ -0,0 +1,66 @@
+-- Inserting and looking up keys in the hash part of a table.
+-- usage: lua bench/openhash.lua
+-- Build once as is and once with LUA_USE_OPENHASH to compare layouts.
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local function makekeys(kind, n)
+    local keys = {}
+    for i = 1, n do
+        if kind == "string" then
+            keys[i] = "k" .. i
+        elseif kind == "number" then
+            keys[i] = i * 3 + 0.5  -- not integers: hash part only
+        else
+            keys[i] = {}
+        end
+    end
+    return keys
+end
+
+local function insert(keys)
+    local t = {}
+    for i = 1, #keys do t[keys[i]] = i end
+    return t
+end
+
+-- 10^6 insertions in all, into tables of #keys
+local function insertall(keys)
+    for _ = 1, 1000000 / #keys do insert(keys) end
+end
+
+-- the keys to look up, 10^6 of them in a pseudo-random order
+local function shuffled(keys)
+    local seq, n, j = {}, #keys, 1
+    for i = 1, 1000000 do
+        j = (j * 16807) % 2147483647
+        seq[i] = keys[j % n + 1]
+    end
+    return seq
+end
+
+local function lookup(t, seq)
+    local s = 0
+    for i = 1, #seq do s = s + t[seq[i]] end
+end
+
+-- misses: keys that are not in the table
+local function miss(t, seq)
+    local c = 0
+    for i = 1, #seq do
+        if t[seq[i]] == nil then c = c + 1 end
+    end
+end
+
+
+for _, kind in ipairs{"string", "number", "table"} do
+    for _, n in ipairs{1000, 100000} do
+        local keys = makekeys(kind, n)
+        local t = insert(keys)
+        local label = kind .. " keys, " .. n
+        bench(label .. ", 10^6 inserts", insertall, keys)
+        bench(label .. ", 10^6 lookups", lookup, t, shuffled(keys))
+        bench(label .. ", 10^6 misses", miss, t, shuffled(makekeys(kind, 1000)))
+    end
+end
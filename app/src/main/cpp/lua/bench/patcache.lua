@@ -0,0 +1,63 @@
+-- Lua patterns: long scans and many short matches with the same pattern.
+-- usage: lua bench/patcache.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+-- a 280 KB text of words, with the word searched for near its end
+local parts = {}
+for i = 1, 20000 do parts[i] = "word" .. i .. "_abc" end
+local text = table.concat(parts, " ")
+parts = nil
+
+local function find(pat, reps)
+    for _ = 1, reps do string.find(text, pat) end
+end
+
+local function gsub(pat, repl, reps)
+    for _ = 1, reps do string.gsub(text, pat, repl) end
+end
+
+local function gmatch(pat, reps)
+    for _ = 1, reps do
+        for _ in string.gmatch(text, pat) do end
+    end
+end
+
+-- short subjects, as in parsing lines or keys one by one
+local lines = {}
+for i = 1, 1000 do lines[i] = "key" .. i .. " = " .. i * 7 end
+local function matchlines(reps)
+    for _ = 1, reps do
+        for i = 1, #lines do string.match(lines[i], "^(%w+)%s*=%s*(%d+)$") end
+    end
+end
+
+
+bench("find 'word19999_(%a*)' x 200", find, "word19999_(%a*)", 200)
+bench("find '[xyz]q' (no match) x 200", find, "[xyz]q", 200)
+bench("gsub '%s+' x 20", gsub, "%s+", " ", 20)
+bench("gmatch '%a+' x 20", gmatch, "%a+", 20)
+bench("match key = value, 10^5 lines", matchlines, 100)
+
+-- more distinct patterns than the cache holds, used in turn
+local pats = {}
+for i = 1, 48 do pats[i] = "^key" .. i .. " = (%d+)$" end
+local function cycle(reps)
+    for _ = 1, reps do
+        for i = 1, #lines do string.match(lines[i], pats[i % 48 + 1]) end
+    end
+end
+bench("match, 48 patterns in turn, 10^5 lines", cycle, 100)
+
+-- the same on 1 KB subjects, which are long enough to be compiled
+local long = {}
+for i = 1, 1000 do long[i] = string.rep("x", 1000) .. "key" .. i .. " = 7" end
+local lpats = {}
+for i = 1, 48 do lpats[i] = "key" .. i .. " = (%d+)$" end
+local function cyclelong(reps)
+    for _ = 1, reps do
+        for i = 1, #long do string.match(long[i], lpats[i % 48 + 1]) end
+    end
+end
+bench("match, 48 patterns in turn, 1 KB x 10^4", cyclelong, 10)
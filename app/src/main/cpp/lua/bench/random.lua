@@ -0,0 +1,49 @@
+-- math.random: floats, ranges, and filling a table.
+-- usage: lua bench/random.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local random = math.random
+
+local function pi(n)
+    local inside = 0
+    for _ = 1, n do
+        local x, y = random(), random()
+        if x * x + y * y <= 1 then inside = inside + 1 end
+    end
+    return 4 * inside / n
+end
+
+local function dice(n)
+    local s = 0
+    for _ = 1, n do s = s + random(1, 6) end
+    return s
+end
+
+local function fill(t, n)
+    for i = 1, n do t[i] = random(1, 100) end
+    return t
+end
+
+local function randomfill(t, n)
+    return math.randomfill(t, n, 1, 100)
+end
+
+local function shuffle(t)
+    for i = #t, 2, -1 do
+        local j = random(i)
+        t[i], t[j] = t[j], t[i]
+    end
+end
+
+
+local t, deck = {}, {}
+for i = 1, 1000000 do deck[i] = i end
+bench("pi, 2*10^6 points", pi, 2000000)
+bench("random(1, 6), 4*10^6", dice, 4000000)
+bench("t[i] = random(1, 100), 4*10^6", fill, t, 4000000)
+if math.randomfill then
+    bench("randomfill(t, 4*10^6, 1, 100)", randomfill, t, 4000000)
+end
+bench("shuffle 10^6", shuffle, deck)
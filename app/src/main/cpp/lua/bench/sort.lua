@@ -0,0 +1,68 @@
+-- table.sort on common input shapes, with and without a comparator.
+-- usage: lua bench/sort.lua
+
+local N = 200000
+
+local function random(n)
+    local t, j = {}, 1
+    for i = 1, n do
+        j = (j * 16807) % 2147483647
+        t[i] = j
+    end
+    return t
+end
+
+local shapes = {
+    random   = random,
+    sorted   = function(n)
+        local t = {}
+        for i = 1, n do t[i] = i end
+        return t
+    end,
+    reversed = function(n)
+        local t = {}
+        for i = 1, n do t[i] = n - i end
+        return t
+    end,
+    equal    = function(n)
+        local t = {}
+        for i = 1, n do t[i] = 7 end
+        return t
+    end,
+    sawtooth = function(n)
+        local t = {}
+        for i = 1, n do t[i] = i % 1000 end
+        return t
+    end,
+}
+
+local function lt(a, b) return a < b end
+
+-- sort a fresh copy each time (the copy is not timed)
+local function sortcopy(src, cmp)
+    local t = {}
+    for i = 1, #src do t[i] = src[i] end
+    local c = os.clock()
+    table.sort(t, cmp)
+    return os.clock() - c
+end
+
+local function run(name, src, cmp)
+    local best = math.huge
+    for _ = 1, 3 do
+        collectgarbage()
+        best = math.min(best, sortcopy(src, cmp))
+    end
+    print(string.format("%-40s %8.1f ms", name, best * 1000))
+end
+
+
+for _, shape in ipairs{"random", "sorted", "reversed", "equal", "sawtooth"} do
+    local src = shapes[shape](N)
+    run(shape .. " numbers", src)
+    run(shape .. " numbers, comparator", src, lt)
+end
+local strings = random(N)
+for i = 1, N do strings[i] = "s" .. strings[i] end
+run("random strings", strings)
+run("random strings, comparator", strings, lt)
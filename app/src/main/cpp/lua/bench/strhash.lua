@@ -0,0 +1,58 @@
+-- String hashing and string table growth.
+-- usage: lua bench/strhash.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+-- 1 KB strings that differ only in bytes the old sampling hash skipped
+-- (it read one byte in 33 from the end), so all of them used to collide
+local function colliding(n)
+    local head, tail = string.rep("x", 1000), string.rep("y", 16)
+    local t = {}
+    for i = 1, n do
+        t[i] = head .. string.format("%08d", i) .. tail
+    end
+end
+
+-- 1 KB strings that differ everywhere: pays for hashing the full length
+local function distinct(n)
+    local t = {}
+    for i = 1, n do
+        t[i] = string.rep(string.format("%08d", i), 128)
+    end
+end
+
+-- many short strings: the string table doubles 15 times along the way
+local function short(n)
+    local t = {}
+    for i = 1, n do
+        t[i] = "k" .. i
+    end
+end
+
+-- longest run of 1000 new strings, which includes any rehash of the
+-- string table (the collector is stopped so that its steps do not count)
+local function worstbatch(n)
+    local t, worst = {}, 0
+    collectgarbage("stop")
+    for b = 0, n / 1000 - 1 do
+        local c = os.clock()
+        for i = b * 1000 + 1, b * 1000 + 1000 do
+            t[i] = "s" .. i
+        end
+        worst = math.max(worst, os.clock() - c)
+    end
+    collectgarbage("restart")
+    return worst
+end
+
+
+bench("1 KB keys, old-hash collisions x 2000", colliding, 2000)
+bench("1 KB keys, distinct x 20000", distinct, 20000)
+bench("short strings x 1000000", short, 1000000)
+local worst = math.huge
+for _ = 1, 5 do
+    collectgarbage()
+    worst = math.min(worst, worstbatch(1000000))
+end
+print(string.format("%-40s %8.1f ms", "worst batch of 1000 new strings", worst * 1000))
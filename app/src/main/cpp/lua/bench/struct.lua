@@ -0,0 +1,76 @@
+-- Decoding binary records: string.byte arithmetic against struct.unpack.
+-- usage: lua bench/struct.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local N = 100000
+local char, byte = string.char, string.byte
+
+-- N records of "<I2 i4 I4 B" (11 bytes), built without struct
+local ints
+do
+    local t = {}
+    for i = 1, N do
+        local a, b, c, d = i % 65536, (i * 7) % 2147483648, i * 13, i % 256
+        t[i] = char(a % 256, math.floor(a / 256),
+                    b % 256, math.floor(b / 256) % 256,
+                    math.floor(b / 65536) % 256, math.floor(b / 16777216),
+                    c % 256, math.floor(c / 256) % 256,
+                    math.floor(c / 65536) % 256, math.floor(c / 16777216), d)
+    end
+    ints = table.concat(t)
+end
+
+local function perbyte(s)
+    local pos = 1
+    for _ = 1, N do
+        local a = byte(s, pos) + byte(s, pos + 1) * 256
+        local b = byte(s, pos + 2) + byte(s, pos + 3) * 256 +
+                  byte(s, pos + 4) * 65536 + byte(s, pos + 5) * 16777216
+        local c = byte(s, pos + 6) + byte(s, pos + 7) * 256 +
+                  byte(s, pos + 8) * 65536 + byte(s, pos + 9) * 16777216
+        local d = byte(s, pos + 10)
+        pos = pos + 11
+    end
+end
+
+local function perrecord(s)
+    local pos = 1
+    for _ = 1, N do
+        local a1, a2, b1, b2, b3, b4, c1, c2, c3, c4, d = byte(s, pos, pos + 10)
+        local a = a1 + a2 * 256
+        local b = b1 + b2 * 256 + b3 * 65536 + b4 * 16777216
+        local c = c1 + c2 * 256 + c3 * 65536 + c4 * 16777216
+        pos = pos + 11
+    end
+end
+
+local function unpack(s, fmt)
+    local pos = 1
+    local up  = struct.unpack
+    for _ = 1, N do
+        local a, b, c, d
+        a, b, c, d, pos = up(fmt, s, pos)
+    end
+end
+
+local function pack(fmt)
+    local t  = {}
+    local pk = struct.pack
+    for i = 1, N do t[i] = pk(fmt, i % 65536, i * 7, i * 13, i % 256) end
+    return table.concat(t)
+end
+
+
+bench("11-byte records, string.byte per byte", perbyte, ints)
+bench("11-byte records, string.byte per rec.", perrecord, ints)
+if struct then
+    assert(pack("<I2 i4 I4 B") == ints)
+    bench("11-byte records, struct.unpack", unpack, ints, "<I2 i4 I4 B")
+    bench("11-byte records, struct.pack", pack, "<I2 i4 I4 B")
+    local t = {}
+    for i = 1, N do t[i] = struct.pack("<I4 d s1", i, i / 3, "name" .. i) end
+    bench("int, double, string, struct.unpack", unpack, table.concat(t),
+          "<I4 d s1")
+end
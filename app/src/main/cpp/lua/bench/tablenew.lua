@@ -0,0 +1,61 @@
+-- Building tables presized with table.new or reused with table.clear.
+-- usage: lua bench/tablenew.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+-- rounds of 1000 appends and 3 named fields, the table then dropped
+local function plain(rounds)
+    for _ = 1, rounds do
+        local t = {}
+        for i = 1, 1000 do t[#t + 1] = i end
+        t.a, t.b, t.c = 1, 2, 3
+    end
+end
+
+local function presized(rounds)
+    for _ = 1, rounds do
+        local t = table.new(1000, 4)
+        for i = 1, 1000 do t[#t + 1] = i end
+        t.a, t.b, t.c = 1, 2, 3
+    end
+end
+
+local function reused(rounds)
+    local t = {}
+    for _ = 1, rounds do
+        table.clear(t)
+        for i = 1, 1000 do t[#t + 1] = i end
+        t.a, t.b, t.c = 1, 2, 3
+    end
+end
+
+-- small records with the usual constructor or presized
+local function records(n)
+    local t = {}
+    for i = 1, n do
+        local r = {}
+        r.x, r.y, r.z, r.w = i, i, i, i
+        t[i] = r
+    end
+end
+
+local function newrecords(n)
+    local t = table.new(n, 0)
+    for i = 1, n do
+        local r = table.new(0, 4)
+        r.x, r.y, r.z, r.w = i, i, i, i
+        t[i] = r
+    end
+end
+
+
+bench("{} + 1000 appends x 2000", plain, 2000)
+if table.new then
+    bench("table.new + 1000 appends x 2000", presized, 2000)
+    bench("table.clear + 1000 appends x 2000", reused, 2000)
+end
+bench("{} records of 4 fields x 200000", records, 200000)
+if table.new then
+    bench("table.new records x 200000", newrecords, 200000)
+end
@@ -0,0 +1,50 @@
+-- Calls: vararg functions that ignore `...', tail calls and plain calls.
+-- usage: lua bench/tailcall.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+local function ignore(a, ...) return a end
+local function pass(a, ...) return select("#", ...) end
+
+local function varargs(f, n)
+    for i = 1, n do f(i, 1, 2) end
+end
+
+local obj = {}
+function obj:handler(...) return self end
+
+local function methods(n)
+    for _ = 1, n do obj:handler(1, 2) end
+end
+
+-- a loop of tail calls, in functions with few and with many registers
+local function small(n)
+    if n == 0 then return 0 end
+    return small(n - 1)
+end
+
+local function wide(n)
+    local a, b, c, d, e, f, g, h, i, j = 1, 2, 3, 4, 5, 6, 7, 8, 9, 10
+    if n == 0 then return a end
+    return wide(n - 1)
+end
+
+local function tails(f, n)
+    for _ = 1, n / 1000 do f(1000) end
+end
+
+local function plain(n)
+    local function add(a, b) return a + b end
+    local s = 0
+    for i = 1, n do s = add(s, i) end
+    return s
+end
+
+
+bench("f(i, 1, 2), `...' unused, 10^6", varargs, ignore, 1000000)
+bench("obj:handler(1, 2), 10^6", methods, 1000000)
+bench("f(i, 1, 2), select('#', ...), 10^6", varargs, pass, 1000000)
+bench("tail calls, 4 registers, 10^7", tails, small, 10000000)
+bench("tail calls, 14 registers, 10^7", tails, wide, 10000000)
+bench("plain calls, 10^7", plain, 10000000)
@@ -0,0 +1,55 @@
+-- Creating closures: captures below many open upvalues, and common shapes.
+-- usage: lua bench/upval.lua
+
+local bench = dofile(arg[0]:match("^(.-)[^/\\]*$") .. "bench.lua")
+
+
+-- `nopen' locals captured, then 20 closures over a local below them all
+local function wide(nopen)
+    local src = {"local n = ...\nlocal s = 0\nfor r = 1, n do\n    local low = r\n"}
+    for i = 1, nopen do
+        src[#src + 1] = string.format(
+            "    local a%d = %d\n    local f%d = function() return a%d end\n",
+            i, i, i, i)
+    end
+    src[#src + 1] = "    for i = 1, 20 do s = s + (function() return low end)() end\n"
+    src[#src + 1] = "end\nreturn s\n"
+    return assert(loadstring(table.concat(src)))
+end
+
+
+local function callbacks(n)
+    local function each(t, f) for i = 1, #t do f(t[i]) end end
+    local t = {}
+    for i = 1, 100 do t[i] = i end
+    local s = 0
+    for _ = 1, n do
+        local acc, cnt = 0, 0
+        each(t, function(v) acc = acc + v end)
+        each(t, function(v) cnt = cnt + 1 end)
+        s = s + acc + cnt
+    end
+    return s
+end
+
+local function iterators(n)
+    local function range(k)
+        local i = 0
+        return function()
+            i = i + 1
+            if i <= k then return i end
+        end
+    end
+    local s = 0
+    for _ = 1, n do
+        for i in range(5) do s = s + i end
+    end
+    return s
+end
+
+
+bench("20 captures below 2 open, 5*10^4", wide(2), 50000)
+bench("20 captures below 10 open, 5*10^4", wide(10), 50000)
+bench("20 captures below 50 open, 5*10^4", wide(50), 50000)
+bench("callbacks, 2 closures per call, 10^4", callbacks, 10000)
+bench("iterators, 2*10^5", iterators, 200000)
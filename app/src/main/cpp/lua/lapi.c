@@ -371,6 +371,8 @@ LUA_API lua_Number lua_tonumber(lua_State *L, int idx) {
 LUA_API lua_Integer lua_tointeger(lua_State *L, int idx) {
     TValue       n;
     const TValue *o = index2adr(L, idx);
+    if (ttisint(o))
+        return ivalue(o);
     if (tonumber(o, &n)) {
         lua_Integer res;
         lua_Number  num = nvalue(o);
@@ -523,7 +525,12 @@ LUA_API void lua_pushnumber(lua_State *L, lua_Number n) {
  */
 LUA_API void lua_pushinteger(lua_State *L, lua_Integer n) {
     lua_lock(L);
-    setnvalue(L->top, cast_num(n));
+    if (cast(lua_Integer, cast_int(n)) == n) {
+        setivalue(L->top, cast_int(n));
+    }
+    else {
+        setnvalue(L->top, cast_num(n));
+    }
     api_incr_top(L);
     lua_unlock(L);
 }
@@ -895,6 +902,34 @@ LUA_API int lua_setfenv(lua_State *L, int idx) {
     return res;
 }
 
+/**
+ * 删除给定索引处的 table 中的所有元素（不触发元方法），但保留已分配的数组和哈希空间，
+ * 以便重复使用这个 table 时不再需要重新分配和 rehash
+ */
+LUA_API void lua_cleartable(lua_State *L, int idx) {
+    StkId t;
+    lua_lock(L);
+    t = index2adr(L, idx);
+    api_check(L, ttistable(t));
+    luaH_clear(hvalue(t));
+    lua_unlock(L);
+}
+
+/**
+ * 如果给定索引处的 table 的 t[1..n] 全是数字（不含 NaN）或全是字符串，并且都在数组部分中，
+ * 就直接用它们的原生 < 关系就地排序并返回 1 ；否则不改动 table 并返回 0 。 不会触发元方法。
+ */
+LUA_API int lua_rawsort(lua_State *L, int idx, int n) {
+    StkId t;
+    int   res;
+    lua_lock(L);
+    t = index2adr(L, idx);
+    api_check(L, ttistable(t));
+    res = luaH_sort(hvalue(t), n);
+    lua_unlock(L);
+    return res;
+}
+
 
 /*
 ** `load' and `call' functions (run Lua code)
@@ -1059,6 +1094,16 @@ LUA_API int lua_status(lua_State *L) {
  * LUA_GCSTEP: 发起一步增量垃圾收集。 步数由 data 控制（越大的值意味着越多步）， 而其具体含义（具体数字表示了多少）并未标准化。 如果你想控制这个步数，必须实验性的测试 data 的值。 如果这一步结束了一个垃圾收集周期，返回返回 1 。
  * LUA_GCSETPAUSE: 把 data/100 设置为 garbage-collector pause 的新值（参见 §2.10）。 函数返回以前的值。
  * LUA_GCSETSTEPMUL: 把 arg/100 设置成 step multiplier （参见 §2.10）。 函数返回以前的值。
+ * LUA_GCGEN: 切换到分代模式（会先做一次完整的垃圾收集）。 如果之前已是分代模式返回 1 。
+ * LUA_GCINC: 切换到增量模式。 如果之前是分代模式返回 1 。
+ * LUA_GCSETMAJORINC: 把 data/100 设置为分代模式下触发完整收集的内存增长比例。 函数返回以前的值。
+ * LUA_GCSETBUDGETUS: 把 data 设置为每个增量步骤最多花费的微秒数（0 表示不限制）。 函数返回以前的值。
+ * LUA_GCPAUSEHIST: 返回停顿直方图第 data 个桶的计数，该桶统计时长小于 2^data 微秒的停顿
+ *                  （最后一个桶统计其余所有停顿）。 data 为负数时清空直方图并从此开始记录；
+ *                  在此之前只有设置了时间预算时才会记录（计时要读时钟）。
+ * LUA_GCBGSWEEP: data 非零时由后台线程释放清扫出的对象内存（分配器必须是线程安全的），
+ *                为零时关闭。 返回之前是否开启；不支持时返回 -1
+ *                （要在 luaconf.h 中定义 LUA_USE_BGSWEEP 才支持）。
  */
 LUA_API int lua_gc(lua_State *L, int what, int data) {
     int          res = 0;
@@ -1112,6 +1157,29 @@ LUA_API int lua_gc(lua_State *L, int what, int data) {
             g->gcstepmul = data;
             break;
         }
+        case LUA_GCGEN:
+        case LUA_GCINC: {
+            res = luaC_changemode(L, what == LUA_GCGEN);
+            break;
+        }
+        case LUA_GCSETMAJORINC: {
+            res = g->gcmajorinc;
+            g->gcmajorinc = data;
+            break;
+        }
+        case LUA_GCSETBUDGETUS: {
+            res = cast_int(g->gcbudget);
+            g->gcbudget = (data > 0) ? cast(lu_mem, data) : 0;
+            break;
+        }
+        case LUA_GCPAUSEHIST: {
+            res = luaC_pausecount(L, data);
+            break;
+        }
+        case LUA_GCBGSWEEP: {
+            res = luaC_bgsweep(L, data);
+            break;
+        }
         default:
             res = -1;  /* invalid option */
     }
@@ -1202,14 +1270,59 @@ LUA_API lua_Alloc lua_getallocf(lua_State *L, void **ud) {
 
 /**
  * 把指定状态机的分配器函数换成带上指针 ud 的 f
+ * （会先关闭后台清扫，以免旧分配器的内存交给新分配器释放）
  */
 LUA_API void lua_setallocf(lua_State *L, lua_Alloc f, void *ud) {
     lua_lock(L);
+    luaC_bgsweep(L, 0);
     G(L)->ud       = ud;
     G(L)->frealloc = f;
     lua_unlock(L);
 }
 
+/**
+ * 设置状态机的 C 调用嵌套上限（同时限制语法嵌套层数），默认为 LUAI_MAXCCALLS。
+ * 最多调到 2 * LUAI_MAXCCALLS （1 MB 的 C 栈能承受的深度）。 limit 为 0 时只查询。
+ * 返回以前的上限； limit 不大于当前的嵌套深度或超出上述范围时返回 0 ，上限不变
+ */
+LUA_API int lua_setcstacklimit(lua_State *L, int limit) {
+    global_State *g = G(L);
+    int          old;
+    lua_lock(L);
+    old = g->maxccalls;
+    if (limit != 0) {
+        if (limit <= L->nCcalls || limit > MAXCCALLSLIMIT)
+            old = 0;  /* out of range */
+        else
+            g->maxccalls = limit;
+    }
+    lua_unlock(L);
+    return old;
+}
+
+/**
+ * 设置状态机中每个线程的调用嵌套上限（ CallInfo 的个数），默认为 LUAI_MAXCALLS。
+ * limit 为 0 时只查询。 返回以前的上限； limit 不大于 L 当前的调用深度或过大时返回 0 ，上限不变。
+ * 调低后，其他线程在下一次被恢复（或被垃圾回收遍历）时收回多出的 CallInfo，
+ * 此后超过上限的调用以 "stack overflow" 出错；调用深度已超过上限的线程在下一次调用时出错
+ */
+LUA_API int lua_setcalllimit(lua_State *L, int limit) {
+    global_State *g = G(L);
+    int          old;
+    lua_lock(L);
+    old = g->maxcalls;
+    if (limit != 0) {
+        if (limit <= cast_int(L->ci - L->base_ci) + 1 || limit > MAXCALLSLIMIT)
+            old = 0;  /* out of range */
+        else {
+            g->maxcalls = limit;
+            luaD_limitCI(L);
+        }
+    }
+    lua_unlock(L);
+    return old;
+}
+
 /**
  *  函数按照指定的大小分配一块内存，将对应的userdata放到栈内
  */
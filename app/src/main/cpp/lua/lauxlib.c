@@ -9,6 +9,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 /* This file uses only the official API of Lua.
@@ -387,8 +388,8 @@ LUALIB_API const char *luaL_findtable(lua_State *L, int idx,
 */
 
 
-#define bufflen(B)    ((B)->p - (B)->buffer)
-#define bufffree(B)    ((size_t)(LUAL_BUFFERSIZE - bufflen(B)))
+#define bufflen(B)    ((size_t) ((B)->p - (B)->b))
+#define bufffree(B)    ((B)->size - bufflen(B))
 
 #define LIMIT    (LUA_MINSTACK/2)
 
@@ -424,16 +425,116 @@ static void adjuststack(luaL_Buffer *B) {
 }
 
 
+/*
+** The heap block of a buffer in heap mode. It lives in a userdata so
+** that it is released if an error interrupts the buffer.
+*/
+typedef struct BuffBox {
+    char   *data;
+    size_t size;
+} BuffBox;
+
+#define BUFFBOX    "_BUFFBOX*"
+
+
+static void boxresize(lua_State *L, BuffBox *box, size_t newsize) {
+    void      *ud;
+    lua_Alloc allocf = lua_getallocf(L, &ud);
+    char      *temp  = (char *) allocf(ud, box->data, box->size, newsize);
+    if (temp == NULL && newsize > 0)  /* keep the old block for `boxgc' */
+        luaL_error(L, "not enough memory");
+    box->data = temp;
+    box->size = newsize;
+}
+
+
+static int boxgc(lua_State *L) {
+    boxresize(L, (BuffBox *) lua_touserdata(L, 1), 0);
+    return 0;
+}
+
+
+/*
+** Make room for `n' more bytes in a heap-mode buffer. The first call
+** creates its box at `idx' (-1, or -2 while a value to add is on top)
+** and moves the contents of `buffer' into it.
+*/
+static char *growbuffer(luaL_Buffer *B, size_t n, int idx) {
+    lua_State *L      = B->L;
+    size_t    len     = bufflen(B);
+    size_t    newsize = B->size * 2;  /* double the size */
+    BuffBox   *box;
+    if (n > ~(size_t) 0 - len)
+        luaL_error(L, "buffer too large");
+    if (newsize < len + n)  /* not big enough? */
+        newsize = len + n;
+    if (B->box == NULL) {  /* no box yet? */
+        box = (BuffBox *) lua_newuserdata(L, sizeof(BuffBox));
+        box->data = NULL;
+        box->size = 0;
+        if (luaL_newmetatable(L, BUFFBOX)) {
+            lua_pushcfunction(L, boxgc);
+            lua_setfield(L, -2, "__gc");
+        }
+        lua_setmetatable(L, -2);
+        if (idx == -2)
+            lua_insert(L, -2);  /* keep the value on top */
+        boxresize(L, box, newsize);
+        memcpy(box->data, B->buffer, len);
+        B->box = box;
+        B->lvl = 1;  /* the box */
+    }
+    else {
+        box = (BuffBox *) B->box;
+        boxresize(L, box, newsize);
+    }
+    B->b    = box->data;
+    B->p    = B->b + len;
+    B->size = newsize;
+    return B->p;
+}
+
+
 LUALIB_API char *luaL_prepbuffer(luaL_Buffer *B) {
+    if (B->heap) {
+        if (bufffree(B) < LUAL_BUFFERSIZE)
+            growbuffer(B, LUAL_BUFFERSIZE, -1);
+        return B->p;
+    }
     if (emptybuffer(B))
         adjuststack(B);
     return B->buffer;
 }
 
 
+/*
+** Space for at least `sz' bytes, to be committed with `luaL_addsize';
+** without heap mode `sz' cannot be larger than LUAL_BUFFERSIZE.
+*/
+LUALIB_API char *luaL_prepbuffsize(luaL_Buffer *B, size_t sz) {
+    if (sz <= bufffree(B))
+        return B->p;
+    if (B->heap)
+        return growbuffer(B, sz, -1);
+    if (sz > LUAL_BUFFERSIZE)
+        luaL_error(B->L, "buffer too small");
+    return luaL_prepbuffer(B);
+}
+
+
 LUALIB_API void luaL_addlstring(luaL_Buffer *B, const char *s, size_t l) {
-    while (l--)
-        luaL_addchar(B, *s++);
+    if (B->heap && l > bufffree(B))
+        growbuffer(B, l, -1);
+    while (l > 0) {
+        size_t n = bufffree(B);
+        if (n == 0)
+            n = (luaL_prepbuffer(B), bufffree(B));
+        if (n > l) n = l;
+        memcpy(B->p, s, n);
+        B->p += n;
+        s += n;
+        l -= n;
+    }
 }
 
 
@@ -443,8 +544,21 @@ LUALIB_API void luaL_addstring(luaL_Buffer *B, const char *s) {
 
 
 LUALIB_API void luaL_pushresult(luaL_Buffer *B) {
-    emptybuffer(B);
-    lua_concat(B->L, B->lvl);
+    lua_State *L = B->L;
+    if (B->heap) {
+        lua_pushlstring(L, B->b, bufflen(B));
+        if (B->box != NULL) {  /* release the box now */
+            boxresize(L, (BuffBox *) B->box, 0);
+            lua_remove(L, -2);
+            B->box = NULL;
+        }
+        B->b    = B->p = B->buffer;
+        B->size = LUAL_BUFFERSIZE;
+    }
+    else {
+        emptybuffer(B);
+        lua_concat(L, B->lvl);
+    }
     B->lvl = 1;
 }
 
@@ -453,6 +567,8 @@ LUALIB_API void luaL_addvalue(luaL_Buffer *B) {
     lua_State  *L = B->L;
     size_t     vl;
     const char *s = lua_tolstring(L, -1, &vl);
+    if (B->heap && vl > bufffree(B))
+        growbuffer(B, vl, -2);
     if (vl <= bufffree(B)) {  /* fit into buffer? */
         memcpy(B->p, s, vl);  /* put it there */
         B->p += vl;
@@ -468,9 +584,18 @@ LUALIB_API void luaL_addvalue(luaL_Buffer *B) {
 
 
 LUALIB_API void luaL_buffinit(lua_State *L, luaL_Buffer *B) {
-    B->L   = L;
-    B->p   = B->buffer;
-    B->lvl = 0;
+    B->L    = L;
+    B->p    = B->b = B->buffer;
+    B->size = LUAL_BUFFERSIZE;
+    B->heap = 0;
+    B->box  = NULL;
+    B->lvl  = 0;
+}
+
+
+LUALIB_API void luaL_buffinitheap(lua_State *L, luaL_Buffer *B) {
+    luaL_buffinit(L, B);
+    B->heap = 1;
 }
 
 /* }====================================================== */
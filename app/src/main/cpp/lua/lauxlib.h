@@ -142,17 +142,34 @@ LUALIB_API const char *(luaL_findtable)(lua_State *L, int idx,
 
 
 
+/*
+** A buffer flushes each full `buffer' to the stack, as a string. In
+** heap mode (`luaL_buffinitheap') it instead grows one block, kept in a
+** userdata on the stack, and makes a string only in `luaL_pushresult'.
+** Once that userdata exists (the buffer grew, or `luaL_prepbuffsize'
+** asked for more than LUAL_BUFFERSIZE) the buffer reaches it through
+** `box', so the stack above it may change between buffer operations;
+** it must be on top again for `luaL_pushresult'.
+*/
 typedef struct luaL_Buffer {
     char      *p;
     /* current position in buffer */
     int       lvl;
     /* number of strings in the stack (level) */
     lua_State *L;
+    char      *b;
+    /* start of the buffer: `buffer', or the heap block */
+    size_t    size;
+    /* size of `b' */
+    int       heap;
+    /* grow `b' instead of flushing it? */
+    void      *box;
+    /* userdata holding `b' in heap mode, or NULL */
     char      buffer[LUAL_BUFFERSIZE];
 }               luaL_Buffer;
 
 #define luaL_addchar(B, c) \
-  ((void)((B)->p < ((B)->buffer+LUAL_BUFFERSIZE) || luaL_prepbuffer(B)), \
+  ((void)((B)->p < ((B)->b+(B)->size) || luaL_prepbuffer(B)), \
    (*(B)->p++ = (char)(c)))
 
 /* compatibility only */
@@ -162,8 +179,12 @@ typedef struct luaL_Buffer {
 
 LUALIB_API void (luaL_buffinit)(lua_State *L, luaL_Buffer *B);
 
+LUALIB_API void (luaL_buffinitheap)(lua_State *L, luaL_Buffer *B);
+
 LUALIB_API char *(luaL_prepbuffer)(luaL_Buffer *B);
 
+LUALIB_API char *(luaL_prepbuffsize)(luaL_Buffer *B, size_t sz);
+
 LUALIB_API void (luaL_addlstring)(luaL_Buffer *B, const char *s, size_t l);
 
 LUALIB_API void (luaL_addstring)(luaL_Buffer *B, const char *s);
@@ -189,9 +189,13 @@ static int luaB_gcinfo(lua_State *L) {
 
 static int luaB_collectgarbage(lua_State *L) {
     static const char *const opts[] = {"stop", "restart", "collect",
-                                       "count", "step", "setpause", "setstepmul", NULL};
+                                       "count", "step", "setpause", "setstepmul",
+                                       "generational", "incremental", "setmajorinc",
+                                       "setbudgetus", "pausehist", "bgsweep", NULL};
     static const int optsnum[] = {LUA_GCSTOP, LUA_GCRESTART, LUA_GCCOLLECT,
-                                  LUA_GCCOUNT, LUA_GCSTEP, LUA_GCSETPAUSE, LUA_GCSETSTEPMUL};
+                                  LUA_GCCOUNT, LUA_GCSTEP, LUA_GCSETPAUSE, LUA_GCSETSTEPMUL,
+                                  LUA_GCGEN, LUA_GCINC, LUA_GCSETMAJORINC,
+                                  LUA_GCSETBUDGETUS, LUA_GCPAUSEHIST, LUA_GCBGSWEEP};
     int              o         = luaL_checkoption(L, 1, "collect", opts);
     int              ex        = luaL_optint(L, 2, 0);
     int              res       = lua_gc(L, optsnum[o], ex);
@@ -205,6 +209,11 @@ static int luaB_collectgarbage(lua_State *L) {
             lua_pushboolean(L, res);
             return 1;
         }
+        case LUA_GCGEN:
+        case LUA_GCINC: {  /* return previous mode */
+            lua_pushstring(L, res ? "generational" : "incremental");
+            return 1;
+        }
         default: {
             lua_pushnumber(L, res);
             return 1;
@@ -0,0 +1,151 @@
+/*
+** $Id: lbitlib.c $
+** Bit operations library (the `bit' module of LuaBitOp)
+** See Copyright Notice in lua.h
+*/
+
+
+#include <stdint.h>
+
+#define lbitlib_c
+#define LUA_LIB
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+/*
+** Operations work over 32 bits: arguments are taken modulo 2^32 and
+** results are signed 32-bit numbers, as in LuaBitOp.
+*/
+typedef uint32_t UBits;
+typedef int32_t  SBits;
+
+
+static UBits barg(lua_State *L, int idx) {
+    lua_Number n = luaL_checknumber(L, idx);
+#if defined(LUA_NUMBER_DOUBLE)
+    union {
+        lua_Number n;
+        uint64_t   b;
+    } bn;
+    bn.n = n + 6755399441055744.0;  /* 2^52 + 2^51: low bits are n rounded */
+    return (UBits) bn.b;
+#else
+    return (UBits) (SBits) n;
+#endif
+}
+
+
+#define bret(L, b)    (lua_pushinteger(L, (SBits) (b)), 1)
+
+
+static int bit_tobit(lua_State *L) {
+    return bret(L, barg(L, 1));
+}
+
+static int bit_bnot(lua_State *L) {
+    return bret(L, ~barg(L, 1));
+}
+
+static int bit_band(lua_State *L) {
+    int   i, n = lua_gettop(L);
+    UBits b    = barg(L, 1);
+    for (i = 2; i <= n; i++) b &= barg(L, i);
+    return bret(L, b);
+}
+
+static int bit_bor(lua_State *L) {
+    int   i, n = lua_gettop(L);
+    UBits b    = barg(L, 1);
+    for (i = 2; i <= n; i++) b |= barg(L, i);
+    return bret(L, b);
+}
+
+static int bit_bxor(lua_State *L) {
+    int   i, n = lua_gettop(L);
+    UBits b    = barg(L, 1);
+    for (i = 2; i <= n; i++) b ^= barg(L, i);
+    return bret(L, b);
+}
+
+static int bit_lshift(lua_State *L) {
+    UBits b = barg(L, 1), n = barg(L, 2) & 31;
+    return bret(L, b << n);
+}
+
+static int bit_rshift(lua_State *L) {
+    UBits b = barg(L, 1), n = barg(L, 2) & 31;
+    return bret(L, b >> n);
+}
+
+static int bit_arshift(lua_State *L) {
+    UBits b = barg(L, 1), n = barg(L, 2) & 31;
+    if (n != 0 && (b & 0x80000000u))  /* C leaves >> of negatives open */
+        return bret(L, (b >> n) | ~(0xFFFFFFFFu >> n));
+    return bret(L, b >> n);
+}
+
+static int bit_rol(lua_State *L) {
+    UBits b = barg(L, 1), n = barg(L, 2) & 31;
+    return bret(L, n == 0 ? b : (b << n) | (b >> (32 - n)));
+}
+
+static int bit_ror(lua_State *L) {
+    UBits b = barg(L, 1), n = barg(L, 2) & 31;
+    return bret(L, n == 0 ? b : (b >> n) | (b << (32 - n)));
+}
+
+static int bit_bswap(lua_State *L) {
+    UBits b = barg(L, 1);
+    b = (b >> 24) | ((b >> 8) & 0xFF00u) | ((b & 0xFF00u) << 8) | (b << 24);
+    return bret(L, b);
+}
+
+static int bit_tohex(lua_State *L) {
+    UBits      b      = barg(L, 1);
+    SBits      n      = lua_isnone(L, 2) ? 8 : (SBits) barg(L, 2);
+    const char *hexdigits = "0123456789abcdef";
+    char       buf[8];
+    int        i;
+    if (n < 0) {  /* negative count: upper case */
+        n         = -n;
+        hexdigits = "0123456789ABCDEF";
+    }
+    if (n > 8) n = 8;
+    for (i = (int) n; --i >= 0;) {
+        buf[i] = hexdigits[b & 15];
+        b >>= 4;
+    }
+    lua_pushlstring(L, buf, (size_t) n);
+    return 1;
+}
+
+
+static const luaL_Reg bitlib[] = {
+        {"arshift", bit_arshift},
+        {"band",    bit_band},
+        {"bnot",    bit_bnot},
+        {"bor",     bit_bor},
+        {"bswap",   bit_bswap},
+        {"bxor",    bit_bxor},
+        {"lshift",  bit_lshift},
+        {"rol",     bit_rol},
+        {"ror",     bit_ror},
+        {"rshift",  bit_rshift},
+        {"tobit",   bit_tobit},
+        {"tohex",   bit_tohex},
+        {NULL, NULL}
+};
+
+
+/*
+** Open bit library
+*/
+LUALIB_API int luaopen_bit(lua_State *L) {
+    luaL_register(L, LUA_BITLIBNAME, bitlib);
+    return 1;
+}
+
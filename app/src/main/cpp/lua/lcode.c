@@ -250,7 +250,7 @@ int luaK_stringK(FuncState *fs, TString *s) {
 
 int luaK_numberK(FuncState *fs, lua_Number r) {
     TValue o;
-    setnvalue(&o, r);
+    luaO_setnumber(&o, r);
     return addk(fs, &o, &o);
 }
 
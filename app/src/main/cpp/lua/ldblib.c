@@ -23,6 +23,18 @@ static int db_getregistry(lua_State *L) {
 }
 
 
+static int db_setcstacklimit(lua_State *L) {
+    lua_pushinteger(L, lua_setcstacklimit(L, luaL_optint(L, 1, 0)));
+    return 1;
+}
+
+
+static int db_setcalllimit(lua_State *L) {
+    lua_pushinteger(L, lua_setcalllimit(L, luaL_optint(L, 1, 0)));
+    return 1;
+}
+
+
 static int db_getmetatable(lua_State *L) {
     luaL_checkany(L, 1);
     if (!lua_getmetatable(L, 1)) {
@@ -374,20 +386,22 @@ static int db_errorfb(lua_State *L) {
 
 
 static const luaL_Reg dblib[] = {
-        {"debug",        db_debug},
-        {"getfenv",      db_getfenv},
-        {"gethook",      db_gethook},
-        {"getinfo",      db_getinfo},
-        {"getlocal",     db_getlocal},
-        {"getregistry",  db_getregistry},
-        {"getmetatable", db_getmetatable},
-        {"getupvalue",   db_getupvalue},
-        {"setfenv",      db_setfenv},
-        {"sethook",      db_sethook},
-        {"setlocal",     db_setlocal},
-        {"setmetatable", db_setmetatable},
-        {"setupvalue",   db_setupvalue},
-        {"traceback",    db_errorfb},
+        {"debug",          db_debug},
+        {"getfenv",        db_getfenv},
+        {"gethook",        db_gethook},
+        {"getinfo",        db_getinfo},
+        {"getlocal",       db_getlocal},
+        {"getregistry",    db_getregistry},
+        {"getmetatable",   db_getmetatable},
+        {"getupvalue",     db_getupvalue},
+        {"setcalllimit",   db_setcalllimit},
+        {"setcstacklimit", db_setcstacklimit},
+        {"setfenv",        db_setfenv},
+        {"sethook",        db_sethook},
+        {"setlocal",       db_setlocal},
+        {"setmetatable",   db_setmetatable},
+        {"setupvalue",     db_setupvalue},
+        {"traceback",      db_errorfb},
         {NULL, NULL}
 };
 
@@ -64,10 +64,12 @@ void luaD_seterrorobj(lua_State *L, int errcode, StkId oldtop) {
 
 static void restore_stack_limit(lua_State *L) {
     lua_assert(L->stack_last - L->stack == L->stacksize - EXTRA_STACK - 1);
-    if (L->size_ci > LUAI_MAXCALLS) {  /* there was an overflow? */
+    if (L->ciovf) {  /* there was an overflow? */
         int inuse = cast_int(L->ci - L->base_ci);
-        if (inuse + 1 < LUAI_MAXCALLS)  /* can `undo' overflow? */
-            luaD_reallocCI(L, LUAI_MAXCALLS);
+        if (inuse + 1 < G(L)->maxcalls) {  /* can `undo' overflow? */
+            luaD_reallocCI(L, G(L)->maxcalls);
+            L->ciovf = 0;
+        }
     }
 }
 
@@ -132,14 +134,23 @@ static void correctstack(lua_State *L, TValue *oldstack) {
 }
 
 
+/*
+** The map of open upvalues must cover the stack; it keeps its own size,
+** so it grows before the stack and shrinks after it: if either fails,
+** the map is just bigger than needed.
+*/
 void luaD_reallocstack(lua_State *L, int newsize) {
     TValue *oldstack = L->stack;
     int    realsize  = newsize + 1 + EXTRA_STACK;
     lua_assert(L->stack_last - L->stack == L->stacksize - EXTRA_STACK - 1);
+    if (L->upvalmap != NULL && realsize > L->sizeupvalmap)
+        luaF_resizemap(L, realsize);
     luaM_reallocvector(L, L->stack, L->stacksize, realsize, TValue);
     L->stacksize  = realsize;
     L->stack_last = L->stack + newsize;
     correctstack(L, oldstack);
+    if (L->upvalmap != NULL && realsize < L->sizeupvalmap)
+        luaF_resizemap(L, realsize);
 }
 
 
@@ -160,13 +171,35 @@ void luaD_growstack(lua_State *L, int n) {
 }
 
 
+/*
+** A thread may have more `CallInfo's than a limit that was lowered after
+** it got them; keep only the limit, or those in use if they are more, so
+** that its next call past the limit fails. Left alone while an overflow
+** is handled, as the handler may be using the extra ones.
+*/
+void luaD_limitCI(lua_State *L) {
+    int inuse = cast_int(L->ci - L->base_ci) + 1;
+    int limit = G(L)->maxcalls;
+    if (!L->ciovf && L->size_ci > limit)
+        luaD_reallocCI(L, (inuse < limit) ? limit : inuse);
+}
+
+
+/*
+** `CallInfo's grow geometrically up to exactly the limit; past it they
+** get EXTRA_CI more, for the error handler, and the call fails. Only
+** filling those too is an error in error handling.
+*/
 static CallInfo *growCI(lua_State *L) {
-    if (L->size_ci > LUAI_MAXCALLS)  /* overflow while handling overflow? */
+    int limit = G(L)->maxcalls;
+    if (L->ciovf)  /* overflow while handling overflow? */
         luaD_throw(L, LUA_ERRERR);
+    else if (L->size_ci < limit)
+        luaD_reallocCI(L, (L->size_ci <= limit / 2) ? 2 * L->size_ci : limit);
     else {
-        luaD_reallocCI(L, 2 * L->size_ci);
-        if (L->size_ci > LUAI_MAXCALLS)
-            luaG_runerror(L, "stack overflow");
+        L->ciovf = 1;
+        luaD_reallocCI(L, L->size_ci + EXTRA_CI);
+        luaG_runerror(L, "stack overflow");
     }
     return ++L->ci;
 }
@@ -322,6 +355,46 @@ int luaD_precall(lua_State *L, StkId func, int nresults) {
 }
 
 
+/*
+** Tail call of a Lua function without varargs: it takes over the frame
+** of the caller at once, with no new `CallInfo', moving down only the
+** function and its arguments. Returns 0, doing nothing, for any other
+** call, which `luaD_precall' prepares.
+*/
+int luaD_pretailcall(lua_State *L, StkId func) {
+    CallInfo  *ci = L->ci;
+    Proto     *p;
+    StkId     st, base;
+    int       narg, i;
+    ptrdiff_t funcr;
+    if (!ttisfunction(func) || clvalue(func)->c.isC ||
+        (L->hookmask & LUA_MASKCALL))  /* call hooks need a new frame */
+        return 0;
+    p = clvalue(func)->l.p;
+    if (p->is_vararg)
+        return 0;
+    funcr = savestack(L, func);
+    luaD_checkstack(L, p->maxstacksize);
+    func = restorestack(L, funcr);
+    narg = cast_int(L->top - func) - 1;
+    if (narg > p->numparams)
+        narg = p->numparams;  /* extra arguments are dropped */
+    if (L->openupval) luaF_close(L, ci->base);
+    for (i = 0; i <= narg; i++)  /* move function and arguments down */
+        setobjs2s(L, ci->func + i, func + i);
+    base    = ci->func + 1;
+    L->base = ci->base = base;
+    ci->top = base + p->maxstacksize;
+    lua_assert(ci->top <= L->stack_last);
+    for (st = base + narg; st < ci->top; st++)
+        setnilvalue(st);
+    L->top     = ci->top;
+    L->savedpc = p->code;  /* starting point */
+    ci->tailcalls++;  /* one more call lost */
+    return 1;
+}
+
+
 static StkId callrethooks(lua_State *L, StkId firstResult) {
     ptrdiff_t fr = savestack(L, firstResult);  /* next call may change stack */
     luaD_callhook(L, LUA_HOOKRET, -1);
@@ -361,10 +434,11 @@ int luaD_poscall(lua_State *L, StkId firstResult) {
 ** function position.
 */
 void luaD_call(lua_State *L, StkId func, int nResults) {
-    if (++L->nCcalls >= LUAI_MAXCCALLS) {
-        if (L->nCcalls == LUAI_MAXCCALLS)
+    int limit = G(L)->maxccalls;
+    if (++L->nCcalls >= limit) {
+        if (L->nCcalls == limit)
             luaG_runerror(L, "C stack overflow");
-        else if (L->nCcalls >= (LUAI_MAXCCALLS + (LUAI_MAXCCALLS >> 3)))
+        else if (L->nCcalls >= (limit + (limit >> 3)))
             luaD_throw(L, LUA_ERRERR);  /* error while handing stack error */
     }
     if (luaD_precall(L, func, nResults) == PCRLUA)  /* is a Lua function? */
@@ -376,7 +450,9 @@ void luaD_call(lua_State *L, StkId func, int nResults) {
 
 static void resume(lua_State *L, void *ud) {
     StkId    firstArg = cast(StkId, ud);
-    CallInfo *ci      = L->ci;
+    CallInfo *ci;
+    luaD_limitCI(L);  /* the limit may have been lowered while suspended */
+    ci = L->ci;
     if (L->status == 0) {  /* start coroutine? */
         lua_assert(ci == L->base_ci && firstArg > L->base);
         if (luaD_precall(L, firstArg - 1, LUA_MULTRET) != PCRLUA)
@@ -413,7 +489,14 @@ LUA_API int lua_resume(lua_State *L, int nargs) {
     lua_lock(L);
     if (L->status != LUA_YIELD && (L->status != 0 || L->ci != L->base_ci))
         return resume_error(L, "cannot resume non-suspended coroutine");
-    if (L->nCcalls >= LUAI_MAXCCALLS)
+    if (L->park != NULL) {  /* waiting for its owner? */
+        L->top -= nargs;  /* leave its stack as it was */
+        setsvalue2s(L, L->top, luaS_newliteral(L, "cannot resume parked coroutine"));
+        incr_top(L);
+        lua_unlock(L);
+        return LUA_ERRRUN;
+    }
+    if (L->nCcalls >= G(L)->maxccalls)
         return resume_error(L, "C stack overflow");
     luai_userstateresume(L, nargs);
     lua_assert(L->errfunc == 0);
@@ -446,6 +529,29 @@ LUA_API int lua_yield(lua_State *L, int nresults) {
 }
 
 
+/* can the running function `lua_yield' without an error? */
+LUA_API int lua_isyieldable(lua_State *L) {
+    return L->nCcalls <= L->baseCcalls;
+}
+
+
+/*
+** A coroutine that yields to wait for an event that only one owner can
+** report is parked under a `key' of that owner: `lua_resume' refuses it
+** until the owner clears the key (with NULL) to resume it.
+*/
+LUA_API void lua_setpark(lua_State *L, void *key) {
+    lua_lock(L);
+    L->park = key;
+    lua_unlock(L);
+}
+
+
+LUA_API void *lua_getpark(lua_State *L) {
+    return L->park;
+}
+
+
 int luaD_pcall(lua_State *L, Pfunc func, void *u,
                ptrdiff_t old_top, ptrdiff_t ef) {
     int            status;
@@ -43,6 +43,8 @@ LUAI_FUNC void luaD_callhook(lua_State *L, int event, int line);
 
 LUAI_FUNC int luaD_precall(lua_State *L, StkId func, int nresults);
 
+LUAI_FUNC int luaD_pretailcall(lua_State *L, StkId func);
+
 LUAI_FUNC void luaD_call(lua_State *L, StkId func, int nResults);
 
 LUAI_FUNC int luaD_pcall(lua_State *L, Pfunc func, void *u,
@@ -52,6 +54,8 @@ LUAI_FUNC int luaD_poscall(lua_State *L, StkId firstResult);
 
 LUAI_FUNC void luaD_reallocCI(lua_State *L, int newsize);
 
+LUAI_FUNC void luaD_limitCI(lua_State *L);
+
 LUAI_FUNC void luaD_reallocstack(lua_State *L, int newsize);
 
 LUAI_FUNC void luaD_growstack(lua_State *L, int n);
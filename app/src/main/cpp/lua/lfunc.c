@@ -48,26 +48,97 @@ UpVal *luaF_newupval(lua_State *L) {
 }
 
 
+/* words of `upvalbits' and bytes of the whole block for `n' slots */
+#define mapwords(n)    (((n) + 31) >> 5)
+#define mapbytes(n)    (cast(size_t, n) * sizeof(UpVal *) + \
+                        cast(size_t, mapwords(n)) * sizeof(lu_int32))
+
+
+/*
+** Give the map of open upvalues (and its bits) room for `size' slots, or
+** free it when `size' is 0. The block is replaced as a whole, so a failed
+** allocation leaves the old one as it was.
+*/
+void luaF_resizemap(lua_State *L, int size) {
+    int      oldsize = L->sizeupvalmap;
+    int      n       = (size < oldsize) ? size : oldsize;
+    UpVal    **map   = NULL;
+    lu_int32 *bits   = NULL;
+    int      i;
+    if (size > 0) {
+        map  = cast(UpVal **, luaM_malloc(L, mapbytes(size)));
+        bits = cast(lu_int32 *, map + size);
+        for (i = 0; i < n; i++) map[i] = L->upvalmap[i];
+        for (; i < size; i++) map[i] = NULL;
+        for (i = 0; i < mapwords(n); i++) bits[i] = L->upvalbits[i];
+        for (; i < mapwords(size); i++) bits[i] = 0;
+    }
+    if (L->upvalmap != NULL)
+        luaM_freemem(L, L->upvalmap, mapbytes(oldsize));
+    L->upvalmap     = map;
+    L->upvalbits    = bits;
+    L->sizeupvalmap = size;
+}
+
+
+#define slotindex(L, level)    cast_int((level) - (L)->stack)
+#define bitmask32(i)           (cast(lu_int32, 1) << ((i) & 31))
+
+
+/* the open upvalue at `level' is going away */
+void luaF_unmapupval(lua_State *L, StkId level) {
+    int i = slotindex(L, level);
+    L->upvalmap[i] = NULL;
+    L->upvalbits[i >> 5] &= ~bitmask32(i);
+}
+
+
+/*
+** The nearest open upvalue above `level' (there must be one). It belongs
+** to the running function, as the frames above it have closed theirs, so
+** this reads at most a few words of `upvalbits', however deep the stack.
+*/
+static UpVal *nextabove(lua_State *L, StkId level) {
+    int      i = slotindex(L, level) + 1;
+    int      w = i >> 5;
+    lu_int32 b = L->upvalbits[w] & ~(bitmask32(i) - 1);  /* slots >= i */
+    while (b == 0)
+        b = L->upvalbits[++w];
+    return L->upvalmap[(w << 5) + luaO_log2(b & (~b + 1))];  /* lowest bit */
+}
+
+
+/*
+** `L->upvalmap' finds an open upvalue in one step. The `openupval' list
+** stays sorted (from the top of the stack down) for `luaF_close'; a new
+** upvalue usually goes at its head, otherwise right after the nearest
+** open upvalue above it, which `upvalbits' finds.
+*/
 UpVal *luaF_findupval(lua_State *L, StkId level) {
     global_State *g   = G(L);
     GCObject     **pp = &L->openupval;
-    UpVal        *p;
     UpVal        *uv;
-    while (*pp != NULL && (p = ngcotouv(*pp))->v >= level) {
-        lua_assert(p->v != &p->u.value);
-        if (p->v == level) {  /* found a corresponding upvalue? */
-            if (isdead(g, obj2gco(p)))  /* is it dead? */
-                changewhite(obj2gco(p));  /* ressurect it */
-            return p;
-        }
-        pp = &p->next;
+    int          i;
+    if (L->upvalmap == NULL)
+        luaF_resizemap(L, L->stacksize);
+    uv = upvalslot(L, level);
+    if (uv != NULL) {  /* found a corresponding upvalue? */
+        lua_assert(uv->v == level);
+        if (isdead(g, obj2gco(uv)))  /* is it dead? */
+            changewhite(obj2gco(uv));  /* ressurect it */
+        return uv;
     }
+    if (*pp != NULL && ngcotouv(*pp)->v > level)  /* not above all others? */
+        pp = &nextabove(L, level)->next;
     uv                       = luaM_new(L, UpVal);  /* not found: create a new one */
     uv->tt     = LUA_TUPVAL;
     uv->marked = luaC_white(g);
     uv->v      = level;  /* current value lives in the stack */
     uv->next   = *pp;  /* chain it in the proper position */
     *pp = obj2gco(uv);
+    i = slotindex(L, level);
+    L->upvalmap[i] = uv;
+    L->upvalbits[i >> 5] |= bitmask32(i);
     uv->u.l.prev           = &g->uvhead;  /* double link it in `uvhead' list */
     uv->u.l.next           = g->uvhead.u.l.next;
     uv->u.l.next->u.l.prev = uv;
@@ -98,6 +169,7 @@ void luaF_close(lua_State *L, StkId level) {
         GCObject *o = obj2gco(uv);
         lua_assert(!isblack(o) && uv->v != &uv->u.value);
         L->openupval = uv->next;  /* remove from `open' list */
+        luaF_unmapupval(L, uv->v);
         if (isdead(g, o))
             luaF_freeupval(L, uv);  /* free upvalue */
         else {
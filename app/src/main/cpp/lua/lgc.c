@@ -5,12 +5,17 @@
 */
 
 #include <string.h>
+#include <time.h>
 
 #define lgc_c
 #define LUA_CORE
 
 #include "lua.h"
 
+#if defined(LUA_USE_BGSWEEP)
+#include <pthread.h>
+#endif
+
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
@@ -25,7 +30,7 @@
 #define GCFINALIZECOST    100
 
 
-#define maskmarks    cast_byte(~(bitmask(BLACKBIT)|WHITEBITS))
+#define maskmarks    cast_byte(~(bit2mask(BLACKBIT, OLDBIT)|WHITEBITS))
 
 #define makewhite(g, x)    \
    ((x)->gch.marked = cast_byte(((x)->gch.marked & maskmarks) | luaC_white(g)))
@@ -127,6 +132,8 @@ size_t luaC_separateudata(lua_State *L, int all) {
     GCObject     **p     = &g->mainthread->next;
     GCObject     *curr;
     while ((curr = *p) != NULL) {
+        if (isold(curr) && !all)
+            break;  /* old udata (after the young ones) are never white */
         if (!(iswhite(curr) || all) || isfinalized(gco2u(curr)))
             p = &curr->gch.next;  /* don't bother with them */
         else if (fasttm(L, gco2u(curr)->metatable, TM_GC) == NULL) {
@@ -233,9 +240,12 @@ static void traverseclosure(global_State *g, Closure *cl) {
 static void checkstacksizes(lua_State *L, StkId max) {
     int ci_used = cast_int(L->ci - L->base_ci);  /* number of `ci' in use */
     int s_used  = cast_int(max - L->stack);  /* part of stack in use */
-    if (L->size_ci > LUAI_MAXCALLS)  /* handling overflow? */
+    int ci_min  = (L == G(L)->mainthread) ? MAIN_CI_SIZE : 2 * BASIC_CI_SIZE;
+    if (L->ciovf)  /* handling overflow? */
         return;  /* do not touch the stacks */
-    if (4 * ci_used < L->size_ci && 2 * BASIC_CI_SIZE < L->size_ci)
+    if (L->size_ci > G(L)->maxcalls)  /* limit lowered? */
+        luaD_limitCI(L);
+    else if (4 * ci_used < L->size_ci && ci_min < L->size_ci)
         luaD_reallocCI(L, L->size_ci / 2);  /* still big enough... */
     condhardstacktests(luaD_reallocCI(L, ci_used + 1));
     if (4 * s_used < L->stacksize &&
@@ -388,7 +398,8 @@ static void freeobj(lua_State *L, GCObject *o) {
             break;
         }
         case LUA_TSTRING: {
-            G(L)->strt.nuse--;
+            if (!luaS_islong(rawgco2ts(o)))  /* interned? */
+                G(L)->strt.nuse--;
             luaM_freemem(L, o, sizestring(gco2ts(o)));
             break;
         }
@@ -402,19 +413,53 @@ static void freeobj(lua_State *L, GCObject *o) {
 }
 
 
-#define sweepwholelist(L, p)    sweeplist(L,p,MAX_LUMEM)
+#define sweepwholelist(L, p)    sweeplist(L,p,MAX_LUMEM,0)
+
+/* the sweep of a young list ends at its end or at its first old object */
+#define sweepdone(g, p)  (*(p) == NULL || \
+                          ((g)->gckind == KGC_GEN && isold(*(p))))
+
+
+static GCObject **sweeplist(lua_State *L, GCObject **p, lu_mem count,
+                            int young);
 
 
-static GCObject **sweeplist(lua_State *L, GCObject **p, lu_mem count) {
+static void sweepopenupval(lua_State *L, lua_State *th) {
+    int      deadmask = otherwhite(G(L));
+    GCObject *o;
+    for (o = th->openupval; o != NULL; o = o->gch.next)
+        if (!((o->gch.marked ^ WHITEBITS) & deadmask))  /* dead? */
+            luaF_unmapupval(th, gco2uv(o)->v);  /* it is going */
+    sweepwholelist(L, &th->openupval);
+}
+
+
+/*
+** In generational mode survivors keep their marks instead of turning
+** white, and they become old. `young' lists (`rootgc' and the udata
+** after the main thread) keep all young objects before the old ones, so
+** their sweep stops at the first old object, returning a pointer to it
+** (see `sweepdone'). Other lists are swept whole: strings may survive
+** there as old, as they refer to nothing; open upvalues never become
+** old, as they move to the young part of `rootgc' when closed.
+*/
+static GCObject **sweeplist(lua_State *L, GCObject **p, lu_mem count,
+                            int young) {
     GCObject     *curr;
     global_State *g       = G(L);
     int          deadmask = otherwhite(g);
+    int          gen      = (g->gckind == KGC_GEN);
     while ((curr = *p) != NULL && count-- > 0) {
+        if (gen && young && isold(curr))
+            break;  /* rest of the list is old */
         if (curr->gch.tt == LUA_TTHREAD)  /* sweep open upvalues of each thread */
-            sweepwholelist(L, &gco2th(curr)->openupval);
+            sweepopenupval(L, gco2th(curr));
         if ((curr->gch.marked ^ WHITEBITS) & deadmask) {  /* not dead? */
             lua_assert(!isdead(g, curr) || testbit(curr->gch.marked, FIXEDBIT));
-            makewhite(g, curr);  /* make it white (for next cycle) */
+            if (!gen)
+                makewhite(g, curr);  /* make it white (for next cycle) */
+            else if (!iswhite(curr) && curr->gch.tt != LUA_TUPVAL)
+                l_setbit(curr->gch.marked, OLDBIT);  /* survivor is now old */
             p = &curr->gch.next;
         }
         else {  /* must erase `curr' */
@@ -429,6 +474,44 @@ static GCObject **sweeplist(lua_State *L, GCObject **p, lu_mem count) {
 }
 
 
+/*
+** Old threads are not reached by the sweep of a minor collection, but
+** they all stay in `grayagain' (with the weak tables) between collections
+** in generational mode, so their open upvalues are swept from there.
+*/
+static void sweepoldthreads(lua_State *L) {
+    GCObject *o = G(L)->grayagain;
+    while (o != NULL) {
+        if (o->gch.tt == LUA_TTHREAD) {
+            if (isold(o))
+                sweepopenupval(L, gco2th(o));
+            o = gco2th(o)->gclist;
+        }
+        else
+            o = gco2h(o)->gclist;
+    }
+}
+
+
+/*
+** Sweep bucket `i' of the string table. In generational mode it keeps its
+** young bit only while it holds strings that are not old: the survivors
+** of a minor collection all become old, but strings created during the
+** (incremental) sweep of a major one stay young.
+*/
+static void sweepstrbucket(lua_State *L, int i) {
+    stringtable *tb = &G(L)->strt;
+    GCObject    *o;
+    sweepwholelist(L, luaS_bucket(tb, i));
+    if (G(L)->gckind == KGC_GEN) {
+        o = *luaS_bucket(tb, i);
+        while (o != NULL && isold(o))
+            o = o->gch.next;
+        luaS_setyoung(tb, i, o != NULL);
+    }
+}
+
+
 static void checkSizes(lua_State *L) {
     global_State *g = G(L);
     /* check size of string hash */
@@ -484,10 +567,12 @@ void luaC_callGCTM(lua_State *L) {
 void luaC_freeall(lua_State *L) {
     global_State *g = G(L);
     int          i;
+    luaC_bgsweep(L, 0);  /* wait for pending frees */
+    g->gckind       = KGC_NORMAL;  /* old objects must go too */
     g->currentwhite = WHITEBITS | bitmask(SFIXEDBIT);  /* mask to collect all elements */
     sweepwholelist(L, &g->rootgc);
-    for (i = 0; i < g->strt.size; i++)  /* free all string lists */
-        sweepwholelist(L, &g->strt.hash[i]);
+    for (i = 0; i < luaS_nbuckets(&g->strt); i++)  /* free all string lists */
+        sweepwholelist(L, luaS_bucket(&g->strt, i));
 }
 
 
@@ -498,12 +583,19 @@ static void markmt(global_State *g) {
 }
 
 
-/* mark root set */
+/*
+** mark root set. In generational mode `gray' and `grayagain' survive
+** between collections: they hold objects caught by write barriers and
+** the threads and weak tables that must be traversed in every cycle.
+*/
 static void markroot(lua_State *L) {
     global_State *g = G(L);
-    g->gray      = NULL;
-    g->grayagain = NULL;
+    if (g->gckind != KGC_GEN) {
+        g->gray      = NULL;
+        g->grayagain = NULL;
+    }
     g->weak      = NULL;
+    g->gcremark  = 0;
     markobject(g, g->mainthread);
     /* make global table be traversed before main stack */
     markvalue(g, gt(g->mainthread));
@@ -522,6 +614,23 @@ static void remarkupvals(global_State *g) {
 }
 
 
+/*
+** Old objects are not traversed by minor collections, so the threads
+** (whose stacks have no write barrier) and the weak tables (which must be
+** cleared) left gray by this cycle are kept in `grayagain' to be
+** traversed again by the next one.
+*/
+static void keepgrays(global_State *g) {
+    GCObject *w = g->weak;
+    if (w != NULL) {
+        while (gco2h(w)->gclist != NULL) w = gco2h(w)->gclist;
+        gco2h(w)->gclist = g->grayagain;
+        g->grayagain     = g->weak;
+        g->weak          = NULL;
+    }
+}
+
+
 static void atomic(lua_State *L) {
     global_State *g = G(L);
     size_t       udsize;  /* total size of userdata to be finalized */
@@ -544,6 +653,12 @@ static void atomic(lua_State *L) {
     marktmu(g);  /* mark `preserved' userdata */
     udsize += propagateall(g);  /* remark, to propagate `preserveness' */
     cleartable(g->weak);  /* remove collected objects from weak tables */
+    if (g->gcgen) {  /* (back to) generational mode? */
+        if (g->gckind != KGC_GEN)  /* end of a major collection? */
+            luaS_allyoung(&g->strt);  /* its survivors must all become old */
+        g->gckind = KGC_GEN;
+        keepgrays(g);
+    }
     /* flip current white */
     g->currentwhite = cast_byte(otherwhite(g));
     g->sweepstrgc   = 0;
@@ -553,6 +668,182 @@ static void atomic(lua_State *L) {
 }
 
 
+/*
+** {======================================================
+** Background sweeping: while a sweep step runs, the allocator is replaced
+** by `deferalloc', which queues the blocks being freed instead of freeing
+** them; a helper thread gives them back to the real allocator. All the
+** bookkeeping (unlinking, `totalbytes') stays in the collector, so the
+** helper never touches the state. The real allocator must be thread safe.
+** =======================================================
+*/
+
+#if defined(LUA_USE_BGSWEEP)
+
+typedef struct SweepBatch {
+    struct SweepBatch *next;
+    int               n;
+    /* number of blocks in use */
+    void              *block[LUAI_SWEEPBATCH];
+    size_t            size[LUAI_SWEEPBATCH];
+} SweepBatch;
+
+
+typedef struct Sweeper {
+    lua_Alloc       frealloc;
+    /* the real allocator */
+    void            *ud;
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    SweepBatch      *current;
+    /* batch being filled by the collector */
+    SweepBatch      *queue;
+    /* full batches waiting for the helper */
+    SweepBatch      *pool;
+    /* empty batches */
+    int             stop;
+} Sweeper;
+
+
+static void *sweepthread(void *ud) {
+    Sweeper *sw = (Sweeper *) ud;
+    pthread_mutex_lock(&sw->lock);
+    for (;;) {
+        SweepBatch *b = sw->queue;
+        int        i;
+        if (b == NULL) {
+            if (sw->stop) break;
+            pthread_cond_wait(&sw->cond, &sw->lock);
+            continue;
+        }
+        sw->queue = b->next;
+        pthread_mutex_unlock(&sw->lock);
+        for (i = 0; i < b->n; i++)
+            (*sw->frealloc)(sw->ud, b->block[i], b->size[i], 0);
+        b->n = 0;
+        pthread_mutex_lock(&sw->lock);
+        b->next  = sw->pool;
+        sw->pool = b;
+    }
+    pthread_mutex_unlock(&sw->lock);
+    return NULL;
+}
+
+
+/* hand the current batch (if any) to the helper */
+static void flushbatch(Sweeper *sw) {
+    SweepBatch *b = sw->current;
+    if (b != NULL && b->n > 0) {
+        pthread_mutex_lock(&sw->lock);
+        b->next   = sw->queue;
+        sw->queue = b;
+        pthread_cond_signal(&sw->cond);
+        pthread_mutex_unlock(&sw->lock);
+        sw->current = NULL;
+    }
+}
+
+
+static void *deferalloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+    Sweeper    *sw = (Sweeper *) ud;
+    SweepBatch *b  = sw->current;
+    if (nsize != 0 || ptr == NULL)
+        return (*sw->frealloc)(sw->ud, ptr, osize, nsize);
+    if (b == NULL || b->n == LUAI_SWEEPBATCH) {
+        flushbatch(sw);
+        pthread_mutex_lock(&sw->lock);
+        b = sw->pool;
+        if (b != NULL) sw->pool = b->next;
+        pthread_mutex_unlock(&sw->lock);
+        if (b == NULL) {
+            b = (SweepBatch *) (*sw->frealloc)(sw->ud, NULL, 0, sizeof(SweepBatch));
+            if (b == NULL) {  /* cannot defer; free it here */
+                (*sw->frealloc)(sw->ud, ptr, osize, 0);
+                return NULL;
+            }
+        }
+        b->n        = 0;
+        sw->current = b;
+    }
+    b->block[b->n]  = ptr;
+    b->size[b->n++] = osize;
+    return NULL;
+}
+
+
+/* run sweep step `s' with the deferring allocator (if enabled) */
+#define deferfrees(g, s) { \
+    Sweeper *sw_ = (g)->sweeper; \
+    if (sw_ != NULL) { (g)->frealloc = deferalloc; (g)->ud = sw_; } \
+    s; \
+    if (sw_ != NULL) { (g)->frealloc = sw_->frealloc; (g)->ud = sw_->ud; } }
+
+#define endsweep(g) { if ((g)->sweeper) flushbatch((g)->sweeper); }
+
+
+static void freebatches(Sweeper *sw, SweepBatch *b) {
+    while (b != NULL) {
+        SweepBatch *next = b->next;
+        (*sw->frealloc)(sw->ud, b, sizeof(SweepBatch), 0);
+        b = next;
+    }
+}
+
+
+int luaC_bgsweep(lua_State *L, int on) {
+    global_State *g   = G(L);
+    Sweeper      *sw  = g->sweeper;
+    int          prev = (sw != NULL);
+    if (on && !prev) {
+        sw = (Sweeper *) (*g->frealloc)(g->ud, NULL, 0, sizeof(Sweeper));
+        if (sw == NULL) return prev;
+        sw->frealloc = g->frealloc;
+        sw->ud       = g->ud;
+        sw->current  = sw->queue = sw->pool = NULL;
+        sw->stop     = 0;
+        pthread_mutex_init(&sw->lock, NULL);
+        pthread_cond_init(&sw->cond, NULL);
+        if (pthread_create(&sw->thread, NULL, sweepthread, sw) != 0) {
+            pthread_cond_destroy(&sw->cond);
+            pthread_mutex_destroy(&sw->lock);
+            (*g->frealloc)(g->ud, sw, sizeof(Sweeper), 0);
+            return prev;
+        }
+        g->sweeper = sw;
+    }
+    else if (!on && prev) {
+        flushbatch(sw);
+        pthread_mutex_lock(&sw->lock);
+        sw->stop = 1;
+        pthread_cond_signal(&sw->cond);
+        pthread_mutex_unlock(&sw->lock);
+        pthread_join(sw->thread, NULL);  /* helper drains the queue first */
+        pthread_cond_destroy(&sw->cond);
+        pthread_mutex_destroy(&sw->lock);
+        freebatches(sw, sw->pool);
+        (*g->frealloc)(g->ud, sw, sizeof(Sweeper), 0);
+        g->sweeper = NULL;
+    }
+    return prev;
+}
+
+#else
+
+#define deferfrees(g, s)    { s; }
+#define endsweep(g)    ((void) 0)
+
+int luaC_bgsweep(lua_State *L, int on) {
+    UNUSED(L);
+    UNUSED(on);
+    return -1;  /* not supported */
+}
+
+#endif
+
+/* }====================================================== */
+
+
 static l_mem singlestep(lua_State *L) {
     global_State *g = G(L);
     /*lua_checkmemory(L);*/
@@ -564,6 +855,15 @@ static l_mem singlestep(lua_State *L) {
         case GCSpropagate: {
             if (g->gray)
                 return propagatemark(g);
+            else if (g->grayagain && !g->gcremark &&
+                     g->gckind == KGC_NORMAL) {
+                /* traverse objects caught by barriers incrementally, so
+                   that the atomic step only redoes what changed since */
+                g->gray      = g->grayagain;
+                g->grayagain = NULL;
+                g->gcremark  = 1;
+                return 0;
+            }
             else {  /* no more `gray' objects */
                 atomic(L);  /* finish mark phase */
                 return 0;
@@ -571,8 +871,12 @@ static l_mem singlestep(lua_State *L) {
         }
         case GCSsweepstring: {
             lu_mem old = g->totalbytes;
-            sweepwholelist(L, &g->strt.hash[g->sweepstrgc++]);
-            if (g->sweepstrgc >= g->strt.size)  /* nothing more to sweep? */
+            if (g->gckind == KGC_GEN)  /* skip buckets with old strings only */
+                g->sweepstrgc = luaS_nextyoung(&g->strt, g->sweepstrgc);
+            if (g->sweepstrgc < luaS_nbuckets(&g->strt))
+                deferfrees(g, sweepstrbucket(L, g->sweepstrgc));
+            g->sweepstrgc++;
+            if (g->sweepstrgc >= luaS_nbuckets(&g->strt))  /* nothing more to sweep? */
                 g->gcstate = GCSsweep;  /* end sweep-string phase */
             lua_assert(old >= g->totalbytes);
             g->estimate -= old - g->totalbytes;
@@ -580,8 +884,13 @@ static l_mem singlestep(lua_State *L) {
         }
         case GCSsweep: {
             lu_mem old = g->totalbytes;
-            g->sweepgc = sweeplist(L, g->sweepgc, GCSWEEPMAX);
-            if (*g->sweepgc == NULL) {  /* nothing more to sweep? */
+            deferfrees(g, g->sweepgc = sweeplist(L, g->sweepgc, GCSWEEPMAX, 1));
+            if (sweepdone(g, g->sweepgc)) {  /* nothing more to sweep? */
+                if (g->gckind == KGC_GEN) {  /* young udata were skipped */
+                    deferfrees(g, sweeplist(L, &g->mainthread->next, MAX_LUMEM, 1));
+                    deferfrees(g, sweepoldthreads(L));
+                }
+                endsweep(g);
                 checkSizes(L);
                 g->gcstate = GCSfinalize;  /* end sweep phase */
             }
@@ -609,9 +918,107 @@ static l_mem singlestep(lua_State *L) {
 }
 
 
+/*
+** restart the collection with a sweep that turns every object white (and
+** young), so that the next mark phase traverses the whole heap
+*/
+static void sweepall(global_State *g) {
+    g->gckind     = KGC_NORMAL;
+    g->sweepstrgc = 0;
+    g->sweepgc    = &g->rootgc;
+    g->gray       = NULL;
+    g->grayagain  = NULL;
+    g->weak       = NULL;
+    g->gcstate    = GCSsweepstring;
+}
+
+
+/*
+** A minor collection runs a whole cycle at once; as old objects are
+** neither traversed nor swept it only costs as much as the young ones.
+** When the heap has grown too much since the last major collection,
+** start a major one, which is done incrementally in normal mode and
+** switches back to generational mode in its atomic step.
+*/
+static void generationalcollection(lua_State *L) {
+    global_State *g = G(L);
+    lua_assert(g->gckind == KGC_GEN && g->gcstate == GCSpause);
+    do {
+        singlestep(L);
+    } while (g->gcstate != GCSpause);
+    if (g->totalbytes > (g->gcmajorbase / 100) * g->gcmajorinc) {
+        sweepall(g);
+        g->GCthreshold = g->totalbytes;  /* start it right away */
+    }
+    else
+        setthreshold(g);
+}
+
+
+/*
+** monotonic clock in microseconds, used to bound and measure GC pauses
+*/
+static lu_mem gettimeus(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return cast(lu_mem, ts.tv_sec) * 1000000 + cast(lu_mem, ts.tv_nsec / 1000);
+#else
+    return cast(lu_mem, (double) clock() * 1000000 / CLOCKS_PER_SEC);
+#endif
+}
+
+
+/*
+** count a pause of `gettimeus() - start' microseconds in the histogram;
+** bucket i holds pauses shorter than 2^i us (the last one all others)
+*/
+static void recordpause(global_State *g, lu_mem start) {
+    lu_mem us = gettimeus() - start;
+    int    i  = 0;
+    while (us > 0 && i < LUA_GCHISTSIZE - 1) {
+        us >>= 1;
+        i++;
+    }
+    g->gcpausehist[i]++;
+}
+
+
+int luaC_pausecount(lua_State *L, int i) {
+    global_State *g = G(L);
+    if (i < 0) {  /* reset histogram and keep it from now on */
+        for (i = 0; i < LUA_GCHISTSIZE; i++)
+            g->gcpausehist[i] = 0;
+        g->gctimed = 1;
+        return 0;
+    }
+    else if (i >= LUA_GCHISTSIZE)
+        return 0;
+    else if (g->gcpausehist[i] > cast(lu_mem, MAX_INT))
+        return MAX_INT;
+    else
+        return cast_int(g->gcpausehist[i]);
+}
+
+
+/*
+** The clock is read only when a time budget is set or the pause
+** histogram was asked for, as steps run in the allocation path.
+*/
+#define istimed(g)    ((g)->gcbudget > 0 || (g)->gctimed)
+
+
 void luaC_step(lua_State *L) {
-    global_State *g  = G(L);
-    l_mem        lim = (GCSTEPSIZE / 100) * g->gcstepmul;
+    global_State *g         = G(L);
+    l_mem        lim        = (GCSTEPSIZE / 100) * g->gcstepmul;
+    int          timed      = istimed(g);
+    lu_mem       start      = timed ? gettimeus() : 0;
+    int          outoftime = 0;
+    if (g->gckind == KGC_GEN && g->gcstate == GCSpause) {
+        generationalcollection(L);
+        if (timed) recordpause(g, start);
+        return;
+    }
     if (lim == 0)
         lim = (MAX_LUMEM - 1) / 2;  /* no limit */
     g->gcdept += g->totalbytes - g->GCthreshold;
@@ -619,32 +1026,39 @@ void luaC_step(lua_State *L) {
         lim -= singlestep(L);
         if (g->gcstate == GCSpause)
             break;
+        if (timed && g->gcbudget > 0 && gettimeus() - start >= g->gcbudget) {
+            /* out of time: keep the unfinished work as debt */
+            if (lim > 0 && g->gcstepmul > 0)
+                g->gcdept += (lim / g->gcstepmul) * 100;
+            outoftime = 1;
+            break;
+        }
     } while (lim > 0);
+    if (timed) recordpause(g, start);
     if (g->gcstate != GCSpause) {
-        if (g->gcdept < GCSTEPSIZE)
+        if (outoftime || g->gcdept < GCSTEPSIZE)  /* next step not due yet? */
             g->GCthreshold = g->totalbytes + GCSTEPSIZE;  /* - lim/g->gcstepmul;*/
         else {
             g->gcdept -= GCSTEPSIZE;
             g->GCthreshold = g->totalbytes;
         }
     }
+    else if (g->gcgen && g->gckind == KGC_NORMAL)
+        g->GCthreshold = g->totalbytes;  /* objects are white again: mark now */
     else {
         setthreshold(g);
+        g->gcmajorbase = g->estimate;
     }
 }
 
 
 void luaC_fullgc(lua_State *L) {
-    global_State *g = G(L);
-    if (g->gcstate <= GCSpropagate) {
+    global_State *g     = G(L);
+    int          timed  = istimed(g);
+    lu_mem       start  = timed ? gettimeus() : 0;
+    if (g->gcstate <= GCSpropagate || g->gckind == KGC_GEN) {
         /* reset sweep marks to sweep all elements (returning them to white) */
-        g->sweepstrgc = 0;
-        g->sweepgc    = &g->rootgc;
-        /* reset other collector lists */
-        g->gray       = NULL;
-        g->grayagain  = NULL;
-        g->weak       = NULL;
-        g->gcstate    = GCSsweepstring;
+        sweepall(g);
     }
     lua_assert(g->gcstate != GCSpause && g->gcstate != GCSpropagate);
     /* finish any pending sweep phase */
@@ -657,16 +1071,42 @@ void luaC_fullgc(lua_State *L) {
         singlestep(L);
     }
     setthreshold(g);
+    g->gcmajorbase = g->estimate;
+    if (timed) recordpause(g, start);
+}
+
+
+/*
+** Select generational (`gen' true) or incremental mode; returns whether
+** generational mode was selected before. Entering generational mode does
+** a full collection so that all live objects start as old.
+*/
+int luaC_changemode(lua_State *L, int gen) {
+    global_State *g   = G(L);
+    int          prev = g->gcgen;
+    if (gen && !prev) {
+        g->gcgen = 1;
+        luaC_fullgc(L);
+    }
+    else if (!gen && prev) {
+        g->gcgen = 0;
+        if (g->gckind == KGC_GEN) {  /* make old objects white again */
+            sweepall(g);
+            g->GCthreshold = g->totalbytes;
+        }
+    }
+    return prev;
 }
 
 
 void luaC_barrierf(lua_State *L, GCObject *o, GCObject *v) {
     global_State *g = G(L);
     lua_assert(isblack(o) && iswhite(v) && !isdead(g, v) && !isdead(g, o));
-    lua_assert(g->gcstate != GCSfinalize && g->gcstate != GCSpause);
+    lua_assert(g->gckind == KGC_GEN ||
+               (g->gcstate != GCSfinalize && g->gcstate != GCSpause));
     lua_assert(ttype(&o->gch) != LUA_TTABLE);
-    /* must keep invariant? */
-    if (g->gcstate == GCSpropagate)
+    /* must keep invariant? (always, as old objects stay black) */
+    if (g->gcstate == GCSpropagate || g->gckind == KGC_GEN)
         reallymarkobject(g, v);  /* restore invariant */
     else  /* don't mind */
         makewhite(g, o);  /* mark as white just to avoid other barriers */
@@ -677,7 +1117,8 @@ void luaC_barrierback(lua_State *L, Table *t) {
     global_State *g = G(L);
     GCObject     *o = obj2gco(t);
     lua_assert(isblack(o) && !isdead(g, o));
-    lua_assert(g->gcstate != GCSfinalize && g->gcstate != GCSpause);
+    lua_assert(g->gckind == KGC_GEN ||
+               (g->gcstate != GCSfinalize && g->gcstate != GCSpause));
     black2gray(o);  /* make table gray (again) */
     t->gclist    = g->grayagain;
     g->grayagain = o;
@@ -699,7 +1140,7 @@ void luaC_linkupval(lua_State *L, UpVal *uv) {
     o->gch.next = g->rootgc;  /* link upvalue into `rootgc' list */
     g->rootgc   = o;
     if (isgray(o)) {
-        if (g->gcstate == GCSpropagate) {
+        if (g->gcstate == GCSpropagate || g->gckind == KGC_GEN) {
             gray2black(o);  /* closed upvalues need barrier */
             luaC_barrier(L, uv, uv->v);
         }
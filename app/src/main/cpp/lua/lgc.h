@@ -21,6 +21,15 @@
 #define GCSfinalize	4
 
 
+/*
+** Kinds of collection (`gckind'). In generational mode survivors of a
+** collection become old and are neither traversed nor swept by minor
+** collections.
+*/
+#define KGC_NORMAL	0
+#define KGC_GEN		1
+
+
 /*
 ** some userful bit tricks
 */
@@ -48,6 +57,7 @@
 ** bit 4 - for tables: has weak values
 ** bit 5 - object is fixed (should not be collected)
 ** bit 6 - object is "super" fixed (only the main thread)
+** bit 7 - object is old (generational mode)
 */
 
 
@@ -59,12 +69,14 @@
 #define VALUEWEAKBIT	4
 #define FIXEDBIT	5
 #define SFIXEDBIT	6
+#define OLDBIT		7
 #define WHITEBITS	bit2mask(WHITE0BIT, WHITE1BIT)
 
 
 #define iswhite(x)      test2bits((x)->gch.marked, WHITE0BIT, WHITE1BIT)
 #define isblack(x)      testbit((x)->gch.marked, BLACKBIT)
 #define isgray(x)	(!isblack(x) && !iswhite(x))
+#define isold(x)	testbit((x)->gch.marked, OLDBIT)
 
 #define otherwhite(g)	(g->currentwhite ^ WHITEBITS)
 #define isdead(g,v)	((v)->gch.marked & otherwhite(g) & WHITEBITS)
@@ -101,6 +113,9 @@ LUAI_FUNC void luaC_callGCTM (lua_State *L);
 LUAI_FUNC void luaC_freeall (lua_State *L);
 LUAI_FUNC void luaC_step (lua_State *L);
 LUAI_FUNC void luaC_fullgc (lua_State *L);
+LUAI_FUNC int luaC_changemode (lua_State *L, int gen);
+LUAI_FUNC int luaC_pausecount (lua_State *L, int i);
+LUAI_FUNC int luaC_bgsweep (lua_State *L, int on);
 LUAI_FUNC void luaC_link (lua_State *L, GCObject *o, lu_byte tt);
 LUAI_FUNC void luaC_linkupval (lua_State *L, UpVal *uv);
 LUAI_FUNC void luaC_barrierf (lua_State *L, GCObject *o, GCObject *v);
@@ -22,6 +22,9 @@ static const luaL_Reg lualibs[] = {
   {LUA_OSLIBNAME, luaopen_os},
   {LUA_STRLIBNAME, luaopen_string},
   {LUA_MATHLIBNAME, luaopen_math},
+  {LUA_BITLIBNAME, luaopen_bit},
+  {LUA_STRUCTLIBNAME, luaopen_struct},
+  {LUA_JSONLIBNAME, luaopen_json},
   {LUA_DBLIBNAME, luaopen_debug},
   {NULL, NULL}
 };
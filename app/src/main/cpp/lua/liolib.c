@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define liolib_c
 #define LUA_LIB
@@ -17,10 +18,30 @@
 #include "lauxlib.h"
 #include "lualib.h"
 
+#if defined(LUA_USE_MMAP)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(LUA_USE_ASYNCIO)
+#include <pthread.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
 
 #define IO_INPUT    1
 #define IO_OUTPUT    2
 
+/*
+** size of the blocks read by chunked line iterators; each byte is read
+** twice (by `memchr' and by the copy into the line), so the block should
+** stay in the L1 cache
+*/
+#define IO_LINECHUNK    (16 * 1024)
+
 
 static const char *const fnames[] = {"input", "output"};
 
@@ -225,36 +246,103 @@ static int io_output(lua_State *L) {
 }
 
 
+/*
+** Block buffer of a chunked line iterator: it `fread's IO_LINECHUNK
+** bytes at a time and splits them with `memchr'. The buffer is private
+** to the iterator, so reads ahead of the lines it has returned.
+*/
+typedef struct LineReader {
+    size_t pos;
+    /* first byte not returned yet */
+    size_t len;
+    /* bytes in `buf' */
+    int    eof;
+    char   buf[IO_LINECHUNK];
+} LineReader;
+
+
 static int io_readline(lua_State *L);
+static int io_readchunk(lua_State *L);
 
 
-static void aux_lines(lua_State *L, int idx, int toclose) {
+/* line format of `lines': 1 to keep the newline ("*L"), 0 otherwise */
+static int linefmt(lua_State *L, int arg) {
+    const char *fmt = luaL_optstring(L, arg, "*l");
+    if (strcmp(fmt, "*l") == 0) return 0;
+    else if (strcmp(fmt, "*L") == 0) return 1;
+    else return luaL_argerror(L, arg, "invalid format");
+}
+
+
+/* lines per call asked by the options table at `arg' (0 for single lines) */
+static int linebatch(lua_State *L, int arg) {
+    int batch;
+    if (lua_isnoneornil(L, arg)) return 0;
+    luaL_checktype(L, arg, LUA_TTABLE);
+    lua_getfield(L, arg, "batch");
+    batch = (int) lua_tointeger(L, -1);
+    luaL_argcheck(L, lua_isnil(L, -1) || batch > 0, arg, "invalid batch size");
+    lua_pop(L, 1);
+    return batch;
+}
+
+
+static void aux_lines(lua_State *L, int idx, int toclose, int keepnl) {
     lua_pushvalue(L, idx);
     lua_pushboolean(L, toclose);  /* close/not close file when finished */
-    lua_pushcclosure(L, io_readline, 2);
+    lua_pushboolean(L, keepnl);
+    lua_pushcclosure(L, io_readline, 3);
 }
 
 
+static void aux_chunklines(lua_State *L, int idx, int toclose, int keepnl,
+                           int batch) {
+    LineReader *r = (LineReader *) lua_newuserdata(L, sizeof(LineReader));
+    r->pos = r->len = 0;
+    r->eof = 0;
+    lua_pushvalue(L, idx);
+    lua_pushboolean(L, toclose);  /* close/not close file when finished */
+    lua_pushboolean(L, keepnl);
+    lua_pushinteger(L, batch);
+    lua_pushvalue(L, -5);  /* block buffer */
+    lua_pushcclosure(L, io_readchunk, 5);
+    lua_remove(L, -2);  /* remove buffer (now an upvalue) */
+}
+
+
+/*
+** With an options table the iterator is chunked; it then reads ahead,
+** and other reads on the same file see the data after its last block.
+*/
 static int f_lines(lua_State *L) {
+    int keepnl;
     tofile(L);  /* check that it's a valid file handle */
-    aux_lines(L, 1, 0);
+    keepnl = linefmt(L, 2);
+    if (lua_isnoneornil(L, 3))
+        aux_lines(L, 1, 0, keepnl);
+    else
+        aux_chunklines(L, 1, 0, keepnl, linebatch(L, 3));
     return 1;
 }
 
 
 static int io_lines(lua_State *L) {
-    if (lua_isnoneornil(L, 1)) {  /* no arguments? */
+    if (lua_isnoneornil(L, 1)) {  /* no file name? */
         /* will iterate over default input */
+        if (lua_isnone(L, 1)) lua_pushnil(L);
         lua_rawgeti(L, LUA_ENVIRONINDEX, IO_INPUT);
+        lua_replace(L, 1);
         return f_lines(L);
     }
-    else {
+    else {  /* the file is only seen by the iterator, so read it in chunks */
         const char *filename = luaL_checkstring(L, 1);
+        int        keepnl    = linefmt(L, 2);
+        int        batch     = linebatch(L, 3);
         FILE       **pf      = newfile(L);
         *pf = fopen(filename, "r");
         if (*pf == NULL)
             fileerror(L, 1, filename);
-        aux_lines(L, lua_gettop(L), 1);
+        aux_chunklines(L, lua_gettop(L), 1, keepnl, batch);
         return 1;
     }
 }
@@ -288,7 +376,7 @@ static int test_eof(lua_State *L, FILE *f) {
 }
 
 
-static int read_line(lua_State *L, FILE *f) {
+static int read_line(lua_State *L, FILE *f, int keepnl) {
     luaL_Buffer b;
     luaL_buffinit(L, &b);
     for (; ;) {
@@ -302,7 +390,7 @@ static int read_line(lua_State *L, FILE *f) {
         if (l == 0 || p[l - 1] != '\n')
             luaL_addsize(&b, l);
         else {
-            luaL_addsize(&b, l - 1);  /* do not include `eol' */
+            luaL_addsize(&b, keepnl ? l : l - 1);  /* `eol' only if asked */
             luaL_pushresult(&b);  /* close buffer */
             return 1;  /* read at least an `eol' */
         }
@@ -314,15 +402,19 @@ static int read_chars(lua_State *L, FILE *f, size_t n) {
     size_t      rlen;  /* how much to read */
     size_t      nr;  /* number of chars actually read */
     luaL_Buffer b;
-    luaL_buffinit(L, &b);
+    luaL_buffinitheap(L, &b);
     rlen = LUAL_BUFFERSIZE;  /* try to read that much each time */
     do {
-        char *p = luaL_prepbuffer(&b);
+        char *p;
         if (rlen > n) rlen = n;  /* cannot read more than asked */
+        p  = luaL_prepbuffsize(&b, rlen);
         nr = fread(p, sizeof(char), rlen, f);
         luaL_addsize(&b, nr);
         n -= nr;  /* still have to read `n' chars */
-    } while (n > 0 && nr == rlen);  /* until end of count or eof */
+        if (nr < rlen) break;  /* eof */
+        if (rlen < n / 2)
+            rlen *= 2;  /* grow the reads with the buffer */
+    } while (n > 0);  /* until end of count */
     luaL_pushresult(&b);  /* close buffer */
     return (n == 0 || lua_objlen(L, -1) > 0);
 }
@@ -334,7 +426,7 @@ static int g_read(lua_State *L, FILE *f, int first) {
     int n;
     clearerr(f);
     if (nargs == 0) {  /* no arguments? */
-        success = read_line(L, f);
+        success = read_line(L, f, 0);
         n       = first + 1;  /* to return 1 result */
     }
     else {  /* ensure stack space for all results and for auxlib's buffer */
@@ -353,7 +445,10 @@ static int g_read(lua_State *L, FILE *f, int first) {
                         success = read_number(L, f);
                         break;
                     case 'l':  /* line */
-                        success = read_line(L, f);
+                        success = read_line(L, f, 0);
+                        break;
+                    case 'L':  /* line with its `eol' */
+                        success = read_line(L, f, 1);
                         break;
                     case 'a':  /* file */
                         read_chars(L, f, ~((size_t) 0));  /* read MAX_SIZE_T chars */
@@ -385,23 +480,88 @@ static int f_read(lua_State *L) {
 }
 
 
+/* end of a `lines' iteration */
+static int aux_lineseof(lua_State *L) {
+    if (lua_toboolean(L, lua_upvalueindex(2))) {  /* generator created file? */
+        lua_settop(L, 0);
+        lua_pushvalue(L, lua_upvalueindex(1));
+        aux_close(L);  /* close it */
+    }
+    return 0;
+}
+
+
 static int io_readline(lua_State *L) {
     FILE *f = *(FILE **) lua_touserdata(L, lua_upvalueindex(1));
     int  sucess;
     if (f == NULL)  /* file is already closed? */
         luaL_error(L, "file is already closed");
-    sucess = read_line(L, f);
+    sucess = read_line(L, f, lua_toboolean(L, lua_upvalueindex(3)));
     if (ferror(f))
         return luaL_error(L, "%s", strerror(errno));
     if (sucess) return 1;
-    else {  /* EOF */
-        if (lua_toboolean(L, lua_upvalueindex(2))) {  /* generator created file? */
-            lua_settop(L, 0);
-            lua_pushvalue(L, lua_upvalueindex(1));
-            aux_close(L);  /* close it */
+    else return aux_lineseof(L);  /* EOF */
+}
+
+
+/* pushes the next line from the block buffer; returns 0 at the end */
+static int chunk_line(lua_State *L, FILE *f, LineReader *r, int keepnl) {
+    luaL_Buffer b;
+    int         spilled = 0;  /* is the start of the line in `b'? */
+    for (; ;) {
+        const char *s     = r->buf + r->pos;
+        size_t     avail  = r->len - r->pos;
+        const char *eol   = (const char *) memchr(s, '\n', avail);
+        if (eol != NULL || (r->eof && (avail > 0 || spilled))) {
+            size_t l = (eol != NULL) ? (size_t) (eol - s) : avail;
+            r->pos += (eol != NULL) ? l + 1 : l;
+            if (eol != NULL && keepnl) l++;
+            if (!spilled)
+                lua_pushlstring(L, s, l);
+            else {
+                luaL_addlstring(&b, s, l);
+                luaL_pushresult(&b);
+            }
+            return 1;
+        }
+        if (r->eof) return 0;
+        if (avail == sizeof(r->buf)) {  /* line longer than the buffer? */
+            if (!spilled) {
+                luaL_buffinit(L, &b);
+                spilled = 1;
+            }
+            luaL_addlstring(&b, s, avail);
+            avail = 0;
         }
-        return 0;
+        else if (avail > 0)
+            memmove(r->buf, s, avail);  /* keep the partial line */
+        r->pos = 0;
+        r->len = avail + fread(r->buf + avail, 1, sizeof(r->buf) - avail, f);
+        if (r->len < sizeof(r->buf))
+            r->eof = 1;  /* end of file (or error) */
+    }
+}
+
+
+static int io_readchunk(lua_State *L) {
+    FILE       *f     = *(FILE **) lua_touserdata(L, lua_upvalueindex(1));
+    int        keepnl = lua_toboolean(L, lua_upvalueindex(3));
+    int        batch  = (int) lua_tointeger(L, lua_upvalueindex(4));
+    LineReader *r     = (LineReader *) lua_touserdata(L, lua_upvalueindex(5));
+    int        n      = 0;
+    if (f == NULL)  /* file is already closed? */
+        luaL_error(L, "file is already closed");
+    if (batch == 0)
+        n = chunk_line(L, f, r, keepnl);
+    else {  /* a table with up to `batch' lines */
+        lua_createtable(L, (batch < 1024) ? batch : 1024, 0);
+        while (n < batch && chunk_line(L, f, r, keepnl))
+            lua_rawseti(L, -2, ++n);
     }
+    if (ferror(f))
+        return luaL_error(L, "%s", strerror(errno));
+    if (n > 0) return 1;
+    else return aux_lineseof(L);  /* EOF */
 }
 
 /* }====================================================== */
@@ -411,12 +571,15 @@ static int g_write(lua_State *L, FILE *f, int arg) {
     int nargs  = lua_gettop(L) - 1;
     int status = 1;
     for (; nargs--; arg++) {
+#if !defined(LUA_NUMBER_SHORTEST)
         if (lua_type(L, arg) == LUA_TNUMBER) {
             /* optimization: could be done exactly as for strings */
             status = status &&
                      fprintf(f, LUA_NUMBER_FMT, lua_tonumber(L, arg)) > 0;
         }
-        else {
+        else
+#endif
+        {  /* strings (and numbers, when written in shortest form) */
             size_t     l;
             const char *s = luaL_checklstring(L, arg, &l);
             status = status && (fwrite(s, sizeof(char), l, f) == l);
@@ -473,11 +636,660 @@ static int f_flush(lua_State *L) {
 }
 
 
+/*
+** {======================================================
+** MMAP
+** A mapped file is a userdata over the bytes of the file: its accessors
+** read them in place, with no `seek' or `read' (only the strings they
+** return are copies). The mapping always has a '\0' after the last
+** byte, so the pattern matcher can run over it as over a string. It is
+** unmapped by `close' or by the collector.
+** =======================================================
+*/
+
+typedef struct MMap {
+    char   *data;
+    /* first byte, or NULL when closed */
+    size_t len;
+    /* size of the file */
+    size_t maplen;
+    /* bytes mapped (more than `len') */
+    int    writable;
+} MMap;
+
+
+/*
+** The mapping at index 1. Its methods keep the metatable as their upvalue,
+** so the check needs no lookup of LUA_MMAPHANDLE in the registry.
+*/
+static MMap *checkmmap(lua_State *L) {
+    MMap *m = (MMap *) lua_touserdata(L, 1);
+    if (m == NULL || !lua_getmetatable(L, 1) ||
+        !lua_rawequal(L, -1, lua_upvalueindex(1)))
+        luaL_typerror(L, 1, LUA_MMAPHANDLE);
+    lua_pop(L, 1);  /* metatable */
+    return m;
+}
+
+
+static MMap *tommap(lua_State *L) {
+    MMap *m = checkmmap(L);
+    if (m->data == NULL)
+        luaL_error(L, "attempt to use a closed mapping");
+    return m;
+}
+
+
+static void unmap(MMap *m) {
+#if defined(LUA_USE_MMAP)
+    munmap(m->data, m->maplen);
+#endif
+    m->data = NULL;
+}
+
+
+static int io_mmap(lua_State *L) {
+    const char *filename = luaL_checkstring(L, 1);
+    const char *mode     = luaL_optstring(L, 2, "r");
+    MMap       *m;
+    luaL_argcheck(L, strcmp(mode, "r") == 0 || strcmp(mode, "r+") == 0, 2,
+                  "invalid mode");
+    m = (MMap *) lua_newuserdata(L, sizeof(MMap));
+    m->data     = NULL;  /* mapping is currently `closed' */
+    m->len      = m->maplen = 0;
+    m->writable = (mode[1] == '+');
+    luaL_getmetatable(L, LUA_MMAPHANDLE);
+    lua_setmetatable(L, -2);
+#if defined(LUA_USE_MMAP)
+    {
+        int         prot = PROT_READ | (m->writable ? PROT_WRITE : 0);
+        size_t      page = (size_t) sysconf(_SC_PAGESIZE);
+        struct stat st;
+        void        *base;
+        int         en;
+        int         fd   = open(filename, m->writable ? O_RDWR : O_RDONLY);
+        if (fd < 0)
+            return pushresult(L, 0, filename);
+        if (fstat(fd, &st) != 0) goto fail;
+        if ((unsigned long long) st.st_size >= (size_t) -1 - page) {
+            errno = EFBIG;
+            goto fail;
+        }
+        m->len    = (size_t) st.st_size;
+        m->maplen = (m->len / page + 1) * page;  /* at least one more byte */
+        /* reserve the range (zeros), then map the file over its start */
+        base = mmap(NULL, m->maplen, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) goto fail;
+        if (m->len > 0 &&
+            mmap(base, m->len, prot, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            en = errno;
+            munmap(base, m->maplen);
+            errno = en;
+            goto fail;
+        }
+        close(fd);
+        m->data = (char *) base;
+        return 1;
+    fail:
+        en = errno;
+        close(fd);
+        errno = en;
+        return pushresult(L, 0, filename);
+    }
+#else
+    (void) filename;
+    return luaL_error(L, LUA_QL("mmap") " not supported");
+#endif
+}
+
+
+static ptrdiff_t mmap_posrelat(ptrdiff_t pos, size_t len) {
+    /* relative position: negative means back from end */
+    if (pos < 0) pos += (ptrdiff_t) len + 1;
+    return (pos >= 0) ? pos : 0;
+}
+
+
+/* the `n' bytes at the position given by argument `arg' */
+static const unsigned char *mmap_at(lua_State *L, MMap *m, int arg, size_t n) {
+    lua_Integer i = luaL_checkinteger(L, arg);
+    luaL_argcheck(L, i >= 1 && (size_t) (i - 1) <= m->len &&
+                     n <= m->len - (size_t) (i - 1), arg, "out of bounds");
+    return (const unsigned char *) m->data + (i - 1);
+}
+
+
+/* 1 for little endian ("<"), 0 for big endian (">"); "=" is native */
+static int mmap_order(lua_State *L, int arg) {
+    static const int one = 1;
+    const char *o = luaL_optstring(L, arg, "=");
+    switch (o[0]) {
+        case '<':
+            return 1;
+        case '>':
+            return 0;
+        case '=':
+            return *(const char *) &one;
+        default:
+            return luaL_argerror(L, arg, "invalid byte order");
+    }
+}
+
+
+static unsigned long long mmap_getbytes(const unsigned char *p, size_t n,
+                                        int little) {
+    unsigned long long v = 0;
+    size_t             i;
+    for (i = 0; i < n; i++)
+        v = (v << 8) | p[little ? n - 1 - i : i];
+    return v;
+}
+
+
+static int mmap_len(lua_State *L) {
+    lua_pushinteger(L, (lua_Integer) tommap(L)->len);
+    return 1;
+}
+
+
+static int mmap_sub(lua_State *L) {
+    MMap      *m    = tommap(L);
+    ptrdiff_t start = mmap_posrelat(luaL_checkinteger(L, 2), m->len);
+    ptrdiff_t end   = mmap_posrelat(luaL_optinteger(L, 3, -1), m->len);
+    if (start < 1) start = 1;
+    if (end > (ptrdiff_t) m->len) end = (ptrdiff_t) m->len;
+    if (start <= end)
+        lua_pushlstring(L, m->data + start - 1, end - start + 1);
+    else
+        lua_pushliteral(L, "");
+    return 1;
+}
+
+
+static int mmap_byte(lua_State *L) {
+    MMap      *m    = tommap(L);
+    ptrdiff_t posi  = mmap_posrelat(luaL_optinteger(L, 2, 1), m->len);
+    ptrdiff_t pose  = mmap_posrelat(luaL_optinteger(L, 3, posi), m->len);
+    int       n, i;
+    if (posi <= 0) posi = 1;
+    if ((size_t) pose > m->len) pose = m->len;
+    if (posi > pose) return 0;  /* empty interval; return no values */
+    n = (int) (pose - posi + 1);
+    if (posi + n <= pose)  /* overflow? */
+        luaL_error(L, "mapping slice too long");
+    luaL_checkstack(L, n, "mapping slice too long");
+    for (i = 0; i < n; i++)
+        lua_pushinteger(L, (unsigned char) m->data[posi + i - 1]);
+    return n;
+}
+
+
+static int mmap_find(lua_State *L) {
+    MMap *m = tommap(L);
+    return luaI_strfind(L, m->data, m->len, 1);
+}
+
+
+static int mmap_match(lua_State *L) {
+    MMap *m = tommap(L);
+    return luaI_strfind(L, m->data, m->len, 0);
+}
+
+
+static int mmap_int(lua_State *L, int issigned) {
+    MMap               *m    = tommap(L);
+    int                n     = luaL_checkint(L, 3);
+    const unsigned char *p;
+    unsigned long long v;
+    luaL_argcheck(L, 1 <= n && n <= 8, 3, "size out of range");
+    p = mmap_at(L, m, 2, (size_t) n);
+    v = mmap_getbytes(p, (size_t) n, mmap_order(L, 4));
+    if (issigned && n < 8 && (v >> (n * 8 - 1)) != 0)
+        v |= ~0ull << (n * 8);  /* sign extension */
+    if (issigned)
+        lua_pushnumber(L, (lua_Number) (long long) v);
+    else
+        lua_pushnumber(L, (lua_Number) v);
+    return 1;
+}
+
+
+static int mmap_sint(lua_State *L) {
+    return mmap_int(L, 1);
+}
+
+
+static int mmap_uint(lua_State *L) {
+    return mmap_int(L, 0);
+}
+
+
+static int mmap_float(lua_State *L) {
+    MMap         *m = tommap(L);
+    unsigned int u  = (unsigned int) mmap_getbytes(mmap_at(L, m, 2, 4), 4,
+                                                   mmap_order(L, 3));
+    float        f;
+    memcpy(&f, &u, sizeof(f));
+    lua_pushnumber(L, (lua_Number) f);
+    return 1;
+}
+
+
+static int mmap_double(lua_State *L) {
+    MMap               *m = tommap(L);
+    unsigned long long u  = mmap_getbytes(mmap_at(L, m, 2, 8), 8,
+                                          mmap_order(L, 3));
+    double             d;
+    memcpy(&d, &u, sizeof(d));
+    lua_pushnumber(L, (lua_Number) d);
+    return 1;
+}
+
+
+static int mmap_write(lua_State *L) {
+    MMap       *m = tommap(L);
+    size_t     l;
+    const char *s = luaL_checklstring(L, 3, &l);
+    if (!m->writable)
+        luaL_error(L, "mapping is read-only");
+    memcpy((char *) mmap_at(L, m, 2, l), s, l);
+    lua_settop(L, 1);
+    return 1;
+}
+
+
+static int mmap_close(lua_State *L) {
+    unmap(tommap(L));
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+
+static int mmap_gc(lua_State *L) {
+    MMap *m = checkmmap(L);
+    if (m->data != NULL)  /* ignore closed mappings */
+        unmap(m);
+    return 0;
+}
+
+
+/*
+** the mapped bytes, for readers of LUA_BUFFERFIELD such as `struct';
+** `tommap' checks the metatable against the upvalue, so the function
+** gives nothing when called on another userdata
+*/
+static int mmap_buffer(lua_State *L) {
+    MMap *m = tommap(L);
+    lua_pushlightuserdata(L, m->data);
+    lua_pushinteger(L, (lua_Integer) m->len);
+    return 2;
+}
+
+
+static int mmap_tostring(lua_State *L) {
+    MMap *m = checkmmap(L);
+    if (m->data == NULL)
+        lua_pushliteral(L, "mmap (closed)");
+    else
+        lua_pushfstring(L, "mmap (%p)", m->data);
+    return 1;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** ASYNC
+** `io.async' hands reads and writes to a pool of worker threads. A
+** coroutine that submits one is suspended; `io.async.run', the
+** completion loop, resumes it with the results once a worker is done.
+** So a single state can keep many operations in flight. Where the
+** caller cannot yield (the main thread, or across a C call) the
+** operation blocks as usual.
+** =======================================================
+*/
+
+/* resume `co'; its errors are raised in `L' */
+static void async_resume(lua_State *L, lua_State *co, int narg) {
+    int status = lua_resume(co, narg);
+    if (status != 0 && status != LUA_YIELD) {
+        lua_xmove(co, L, 1);  /* error message */
+        lua_error(L);
+    }
+    if (status == 0)
+        lua_settop(co, 0);  /* discard the results of the body */
+}
+
+
+static int async_spawn(lua_State *L) {
+    int       n = lua_gettop(L);
+    lua_State *co;
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+    co = lua_newthread(L);
+    lua_insert(L, 1);
+    lua_xmove(L, co, n);  /* body and arguments */
+    async_resume(L, co, n - 1);
+    return 1;
+}
+
+
+#if defined(LUA_USE_ASYNCIO)
+
+typedef struct AsyncOp {
+    struct AsyncOp *next;
+    lua_State      *co;
+    /* suspended coroutine (NULL for a blocking call) */
+    int            ref;
+    /* anchors `co' in the registry */
+    int            sref;
+    /* anchors the string to write in the registry */
+    int            write;
+    int            fd;
+    /* a `dup' of the file's descriptor, owned by the operation */
+    off_t          offset;
+    char           *buf;
+    /* read buffer, or the (anchored) string to write */
+    size_t         len;
+    size_t         done;
+    /* bytes transferred */
+    int            err;
+    /* `errno' of a failed transfer, or 0 */
+} AsyncOp;
+
+
+typedef struct Async {
+    pthread_mutex_t lock;
+    pthread_cond_t  work;
+    /* signalled when `queue' gets an operation, or on shutdown */
+    pthread_cond_t  done;
+    /* signalled when `finished' gets an operation */
+    AsyncOp         *queue;
+    AsyncOp         *last;
+    /* tail of `queue' */
+    AsyncOp         *finished;
+    int             pending;
+    /* operations submitted and not yet resumed (main side only) */
+    int             nthreads;
+    int             quit;
+    pthread_t       threads[LUA_ASYNCTHREADS];
+} Async;
+
+
+/* the transfer itself; runs on a worker without the Lua state */
+static void async_perform(AsyncOp *op) {
+    while (op->done < op->len) {
+        ssize_t r = op->write
+                    ? pwrite(op->fd, op->buf + op->done, op->len - op->done,
+                             op->offset + (off_t) op->done)
+                    : pread(op->fd, op->buf + op->done, op->len - op->done,
+                            op->offset + (off_t) op->done);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) {
+            op->err = errno;
+            return;
+        }
+        if (r == 0) return;  /* end of file */
+        op->done += (size_t) r;
+    }
+}
+
+
+static void *async_worker(void *ud) {
+    Async *a = (Async *) ud;
+    pthread_mutex_lock(&a->lock);
+    for (;;) {
+        AsyncOp *op;
+        while (a->queue == NULL && !a->quit)
+            pthread_cond_wait(&a->work, &a->lock);
+        if (a->queue == NULL) break;  /* shutdown, and nothing left to do */
+        op = a->queue;
+        a->queue = op->next;
+        pthread_mutex_unlock(&a->lock);
+        async_perform(op);
+        close(op->fd);
+        pthread_mutex_lock(&a->lock);
+        op->next    = a->finished;
+        a->finished = op;
+        pthread_cond_signal(&a->done);
+    }
+    pthread_mutex_unlock(&a->lock);
+    return NULL;
+}
+
+
+static Async *toasync(lua_State *L) {
+    return (Async *) lua_touserdata(L, lua_upvalueindex(1));
+}
+
+
+/* push the results of a finished operation on `L' and release it */
+static int async_push(lua_State *L, AsyncOp *op) {
+    int n;
+    if (op->err != 0) {
+        errno = op->err;
+        n = pushresult(L, 0, NULL);
+    }
+    else if (op->write)
+        n = pushresult(L, 1, NULL);
+    else {
+        if (op->done > 0 || op->len == 0)
+            lua_pushlstring(L, op->buf, op->done);
+        else
+            lua_pushnil(L);  /* end of file */
+        n = 1;
+    }
+    if (!op->write) free(op->buf);
+    return n;
+}
+
+
+/* make sure there are workers for `n' operations; 0 if there are none */
+static int async_start(Async *a, int n) {
+    pthread_mutex_lock(&a->lock);
+    while (a->nthreads < LUA_ASYNCTHREADS && a->nthreads < n) {
+        if (pthread_create(&a->threads[a->nthreads], NULL, async_worker, a) != 0)
+            break;
+        a->nthreads++;
+    }
+    pthread_mutex_unlock(&a->lock);
+    return a->nthreads > 0;
+}
+
+
+/*
+** A suspended caller is parked under its operation, so that only
+** `io.async.run' resumes it. The operation has its own descriptor and
+** anchors the string it writes, as the caller's file may be closed and
+** its stack frame gone before a worker gets to it.
+*/
+static int async_submit(lua_State *L, int write) {
+    Async      *a  = toasync(L);
+    FILE       *f  = tofile(L);
+    lua_Number off = luaL_checknumber(L, 2);
+    const char *s  = NULL;
+    size_t     len;
+    AsyncOp    *op;
+    AsyncOp    sync;
+    luaL_argcheck(L, off >= 0, 2, "negative offset");
+    if (write)
+        s = luaL_checklstring(L, 3, &len);
+    else {
+        lua_Number n = luaL_checknumber(L, 3);
+        luaL_argcheck(L, n >= 0, 3, "negative size");
+        len = (size_t) n;
+    }
+    if (!lua_isyieldable(L))  /* cannot suspend the caller; just block */
+        op = &sync;
+    else if (!async_start(a, a->pending + 1))
+        return luaL_error(L, "cannot create " LUA_QL("io.async") " thread");
+    else if ((op = (AsyncOp *) malloc(sizeof(AsyncOp))) == NULL)
+        return luaL_error(L, "not enough memory");
+    op->write  = write;
+    op->offset = (off_t) off;
+    op->len    = len;
+    op->done   = 0;
+    op->err    = 0;
+    op->co     = NULL;
+    op->next   = NULL;
+    op->buf    = write ? (char *) s : (char *) malloc(len > 0 ? len : 1);
+    if (op->buf == NULL) {
+        if (op != &sync) free(op);
+        return luaL_error(L, "not enough memory");
+    }
+    fflush(f);  /* buffered output must reach the file first */
+    if (op == &sync) {
+        op->fd = fileno(f);
+        async_perform(op);
+        return async_push(L, op);
+    }
+    if ((op->fd = dup(fileno(f))) < 0) {
+        int en = errno;
+        if (!write) free(op->buf);
+        free(op);
+        errno = en;
+        return pushresult(L, 0, NULL);
+    }
+    if (write) {
+        lua_pushvalue(L, 3);
+        op->sref = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+    lua_pushthread(L);
+    op->co  = L;
+    op->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    lua_setpark(L, op);
+    a->pending++;
+    pthread_mutex_lock(&a->lock);
+    if (a->queue == NULL)
+        a->queue = op;
+    else
+        a->last->next = op;
+    a->last = op;
+    pthread_cond_signal(&a->work);
+    pthread_mutex_unlock(&a->lock);
+    return lua_yield(L, 0);  /* `io.async.run' resumes with the results */
+}
+
+
+static int async_read(lua_State *L) {
+    return async_submit(L, 0);
+}
+
+
+static int async_write(lua_State *L) {
+    return async_submit(L, 1);
+}
+
+
+static int async_run(lua_State *L) {
+    Async *a = toasync(L);
+    while (a->pending > 0) {
+        AsyncOp   *op;
+        lua_State *co;
+        int       n;
+        pthread_mutex_lock(&a->lock);
+        while (a->finished == NULL)
+            pthread_cond_wait(&a->done, &a->lock);
+        op = a->finished;
+        a->finished = op->next;
+        pthread_mutex_unlock(&a->lock);
+        a->pending--;
+        co = op->co;
+        lua_rawgeti(L, LUA_REGISTRYINDEX, op->ref);  /* keep `co' alive */
+        luaL_unref(L, LUA_REGISTRYINDEX, op->ref);
+        if (op->write)
+            luaL_unref(L, LUA_REGISTRYINDEX, op->sref);
+        if (lua_status(co) != LUA_YIELD || lua_getpark(co) != op) {
+            if (!op->write) free(op->buf);  /* no one waits for it */
+            free(op);
+            lua_pop(L, 1);
+            continue;
+        }
+        lua_setpark(co, NULL);
+        n = async_push(co, op);
+        free(op);
+        async_resume(L, co, n);
+        lua_pop(L, 1);
+    }
+    return 0;
+}
+
+
+static int async_pending(lua_State *L) {
+    lua_pushinteger(L, toasync(L)->pending);
+    return 1;
+}
+
+
+static int async_gc(lua_State *L) {
+    Async *a = (Async *) lua_touserdata(L, 1);
+    int   i;
+    pthread_mutex_lock(&a->lock);
+    a->quit = 1;  /* workers finish the queue and leave */
+    pthread_cond_broadcast(&a->work);
+    pthread_mutex_unlock(&a->lock);
+    for (i = 0; i < a->nthreads; i++)
+        pthread_join(a->threads[i], NULL);
+    while (a->finished != NULL) {  /* no one will resume these */
+        AsyncOp *op = a->finished;
+        a->finished = op->next;
+        if (!op->write) free(op->buf);
+        free(op);
+    }
+    pthread_cond_destroy(&a->done);
+    pthread_cond_destroy(&a->work);
+    pthread_mutex_destroy(&a->lock);
+    return 0;
+}
+
+
+static void newasync(lua_State *L) {
+    Async *a = (Async *) lua_newuserdata(L, sizeof(Async));
+    memset(a, 0, sizeof(Async));
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->work, NULL);
+    pthread_cond_init(&a->done, NULL);
+    lua_createtable(L, 0, 1);
+    lua_pushcfunction(L, async_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_setmetatable(L, -2);
+}
+
+#else
+
+static int async_read(lua_State *L) {
+    return luaL_error(L, LUA_QL("io.async") " not supported");
+}
+
+
+#define async_write     async_read
+
+
+static int async_run(lua_State *L) {
+    (void) L;
+    return 0;
+}
+
+
+static int async_pending(lua_State *L) {
+    lua_pushinteger(L, 0);
+    return 1;
+}
+
+
+#define newasync(L)     lua_pushnil(L)
+
+#endif
+
+/* }====================================================== */
+
+
 static const luaL_Reg iolib[] = {
         {"close",   io_close},
         {"flush",   io_flush},
         {"input",   io_input},
         {"lines",   io_lines},
+        {"mmap",    io_mmap},
         {"open",    io_open},
         {"output",  io_output},
         {"popen",   io_popen},
@@ -503,7 +1315,47 @@ static const luaL_Reg flib[] = {
 };
 
 
+static const luaL_Reg mlib[] = {
+        {"byte",       mmap_byte},
+        {"close",      mmap_close},
+        {"double",     mmap_double},
+        {"find",       mmap_find},
+        {"float",      mmap_float},
+        {"int",        mmap_sint},
+        {"len",        mmap_len},
+        {"match",      mmap_match},
+        {"sub",        mmap_sub},
+        {"uint",       mmap_uint},
+        {"write",      mmap_write},
+        {"__buffer",   mmap_buffer},
+        {"__gc",       mmap_gc},
+        {"__len",      mmap_len},
+        {"__tostring", mmap_tostring},
+        {NULL, NULL}
+};
+
+
+static const luaL_Reg alib[] = {
+        {"pending", async_pending},
+        {"read",    async_read},
+        {"run",     async_run},
+        {"spawn",   async_spawn},
+        {"write",   async_write},
+        {NULL, NULL}
+};
+
+
 static void createmeta(lua_State *L) {
+    luaL_newmetatable(L, LUA_MMAPHANDLE);  /* create metatable for mappings */
+    lua_pushvalue(L, -1);  /* push metatable */
+    lua_setfield(L, -2, "__index");  /* metatable.__index = metatable */
+    lua_pushvalue(L, -1);  /* shared by the methods */
+    luaI_openlib(L, NULL, mlib, 1);  /* mapping methods */
+    luaL_findtable(L, LUA_REGISTRYINDEX, LUA_BUFFERREADERS, 1);
+    lua_getfield(L, -2, LUA_BUFFERFIELD);  /* trust `mmap_buffer' */
+    lua_pushboolean(L, 1);
+    lua_rawset(L, -3);
+    lua_pop(L, 2);  /* reader list and metatable */
     luaL_newmetatable(L, LUA_FILEHANDLE);  /* create metatable for file handles */
     lua_pushvalue(L, -1);  /* push metatable */
     lua_setfield(L, -2, "__index");  /* metatable.__index = metatable */
@@ -547,6 +1399,10 @@ LUALIB_API int luaopen_io(lua_State *L) {
     newfenv(L, io_pclose);  /* create environment for 'popen' */
     lua_setfenv(L, -2);  /* set fenv for 'popen' */
     lua_pop(L, 1);  /* pop 'popen' */
+    lua_newtable(L);  /* create 'io.async' */
+    newasync(L);  /* shared by its functions */
+    luaI_openlib(L, NULL, alib, 1);
+    lua_setfield(L, -2, "async");
     return 1;
 }
 
@@ -0,0 +1,645 @@
+/*
+** $Id: ljsonlib.c $
+** JSON encoding and decoding (the `json' module)
+** See Copyright Notice in lua.h
+*/
+
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ljsonlib_c
+#define LUA_LIB
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+/*
+** JSON objects and arrays are tables, strings, numbers and booleans are
+** themselves, and null is `json.null' (a light userdata, so it can be
+** stored in a table). When encoding, a table whose keys are exactly
+** 1..n is an array and any other table an object, with numeric keys
+** written as strings; an empty table is an object. Numbers are written
+** as `tostring' writes them: define LUA_NUMBER_SHORTEST (luaconf.h) so
+** that they read back exactly.
+*/
+
+
+/* macro to `unsign' a character */
+#define uchar(c)        ((unsigned char)(c))
+
+#define JSON_MAXDEPTH   1000  /* nesting limit (it also stops cycles) */
+
+#define isdigitc(c)     ((unsigned) ((c) - '0') < 10)
+#define isspacec(c)     ((c) == ' ' || (c) == '\n' || (c) == '\r' || (c) == '\t')
+
+
+/*
+** {======================================================
+** Decoding
+** =======================================================
+*/
+
+typedef struct DecodeState {
+    lua_State  *L;
+    const char *s;
+    /* start of the document (a Lua string, so `*e' is '\0') */
+    const char *p;
+    /* current position */
+    const char *e;
+    /* end of the document */
+    int        *sizes;
+    /* element count of each array and object, in the order they open */
+    int        nsizes;
+    int        maxsizes;
+    int        next;
+    /* entry of `sizes' for the next array or object */
+} DecodeState;
+
+
+static int decode_error(DecodeState *d, const char *msg) {
+    return luaL_error(d->L, "%s at position %d", msg, (int) (d->p - d->s) + 1);
+}
+
+
+/* new entry of `sizes', which lives in the userdata at stack index 2 */
+static int newsize(DecodeState *d) {
+    if (d->nsizes == d->maxsizes) {
+        int newmax = (d->maxsizes == 0) ? 64 : 2 * d->maxsizes;
+        int *ns    = (int *) lua_newuserdata(d->L, newmax * sizeof(int));
+        if (d->nsizes > 0)
+            memcpy(ns, d->sizes, d->nsizes * sizeof(int));
+        lua_replace(d->L, 2);
+        d->sizes    = ns;
+        d->maxsizes = newmax;
+    }
+    d->sizes[d->nsizes] = 0;
+    return d->nsizes++;
+}
+
+
+/*
+** One pass over the document that counts the elements of every array
+** and object, so that each table is created with its final size and
+** filling it never rehashes. The counts are only hints: the parser
+** reports malformed documents.
+*/
+static void prescan(DecodeState *d) {
+    int        open[JSON_MAXDEPTH];  /* entries of the open containers */
+    int        depth = 0;
+    const char *p    = d->s;
+    for (; p < d->e; p++) {
+        int c = uchar(*p);
+        if (isspacec(c))
+            continue;
+        if (depth > 0 && d->sizes[open[depth - 1]] == 0 && c != ']' && c != '}')
+            d->sizes[open[depth - 1]] = 1;  /* first element */
+        switch (c) {
+            case '"': {
+                for (p++; p < d->e && *p != '"'; p++) {
+                    if (*p == '\\') p++;  /* skip escaped character */
+                }
+                break;
+            }
+            case '[':
+            case '{': {
+                if (depth == JSON_MAXDEPTH)
+                    return;  /* the parser will complain */
+                open[depth++] = newsize(d);
+                break;
+            }
+            case ']':
+            case '}': {
+                if (depth > 0) depth--;
+                break;
+            }
+            case ',': {
+                if (depth > 0) d->sizes[open[depth - 1]]++;
+                break;
+            }
+        }
+    }
+}
+
+
+static int nextsize(DecodeState *d) {
+    return (d->next < d->nsizes) ? d->sizes[d->next++] : 0;
+}
+
+
+static void skipspace(DecodeState *d) {
+    const char *p = d->p;
+    while (isspacec(*p)) p++;
+    d->p = p;
+}
+
+
+static int gethex(const char *p) {
+    int v = 0, i;
+    for (i = 0; i < 4; i++) {
+        int c = uchar(p[i]);
+        if (isdigitc(c)) c -= '0';
+        else if ('a' <= (c | 0x20) && (c | 0x20) <= 'f') c = (c | 0x20) - 'a' + 10;
+        else return -1;
+        v = v * 16 + c;
+    }
+    return v;
+}
+
+
+static void addutf8(luaL_Buffer *b, unsigned long x) {
+    char buff[4];
+    int  n;
+    if (x < 0x80) {
+        buff[0] = (char) x;
+        n = 1;
+    }
+    else if (x < 0x800) {
+        buff[0] = (char) (0xC0 | (x >> 6));
+        buff[1] = (char) (0x80 | (x & 0x3F));
+        n = 2;
+    }
+    else if (x < 0x10000) {
+        buff[0] = (char) (0xE0 | (x >> 12));
+        buff[1] = (char) (0x80 | ((x >> 6) & 0x3F));
+        buff[2] = (char) (0x80 | (x & 0x3F));
+        n = 3;
+    }
+    else {
+        buff[0] = (char) (0xF0 | (x >> 18));
+        buff[1] = (char) (0x80 | ((x >> 12) & 0x3F));
+        buff[2] = (char) (0x80 | ((x >> 6) & 0x3F));
+        buff[3] = (char) (0x80 | (x & 0x3F));
+        n = 4;
+    }
+    luaL_addlstring(b, buff, n);
+}
+
+
+/* `d->p' at a `\u'; adds the character (or surrogate pair) it escapes */
+static const char *unicodeescape(DecodeState *d, luaL_Buffer *b) {
+    const char *p = d->p;
+    long       x  = gethex(p + 2);
+    if (x < 0)
+        decode_error(d, "invalid unicode escape");
+    p += 6;
+    if (0xD800 <= x && x <= 0xDBFF && p[0] == '\\' && p[1] == 'u') {
+        long lo = gethex(p + 2);
+        if (0xDC00 <= lo && lo <= 0xDFFF) {  /* surrogate pair? */
+            x = 0x10000 + ((x - 0xD800) << 10) + (lo - 0xDC00);
+            p += 6;
+        }
+    }
+    if (0xD800 <= x && x <= 0xDFFF)  /* unpaired surrogate? */
+        decode_error(d, "invalid unicode escape");
+    addutf8(b, (unsigned long) x);
+    return p;
+}
+
+
+/* string with escapes, from `p' (the first escape) on */
+static void decode_escaped(DecodeState *d, const char *start, const char *p) {
+    luaL_Buffer b;
+    luaL_buffinit(d->L, &b);
+    luaL_addlstring(&b, start, p - start);
+    for (;;) {
+        const char *q = p;
+        while (*q != '"' && *q != '\\' && uchar(*q) >= 0x20) q++;
+        luaL_addlstring(&b, p, q - p);
+        p = q;
+        if (*p == '"')
+            break;
+        d->p = p;
+        if (*p != '\\')
+            decode_error(d, (p == d->e) ? "unfinished string" :
+                            "control character in string");
+        switch (p[1]) {
+            case '"':  luaL_addchar(&b, '"'); break;
+            case '\\': luaL_addchar(&b, '\\'); break;
+            case '/':  luaL_addchar(&b, '/'); break;
+            case 'b':  luaL_addchar(&b, '\b'); break;
+            case 'f':  luaL_addchar(&b, '\f'); break;
+            case 'n':  luaL_addchar(&b, '\n'); break;
+            case 'r':  luaL_addchar(&b, '\r'); break;
+            case 't':  luaL_addchar(&b, '\t'); break;
+            case 'u':  p = unicodeescape(d, &b); continue;
+            default:   decode_error(d, "invalid escape in string");
+        }
+        p += 2;
+    }
+    luaL_pushresult(&b);
+    d->p = p + 1;  /* skip closing quote */
+}
+
+
+static void decode_string(DecodeState *d) {
+    const char *start = d->p + 1;
+    const char *p     = start;
+    while (*p != '"' && *p != '\\' && uchar(*p) >= 0x20) p++;
+    if (*p == '"') {  /* no escapes: the common case */
+        lua_pushlstring(d->L, start, p - start);
+        d->p = p + 1;
+    }
+    else
+        decode_escaped(d, start, p);
+}
+
+
+static void decode_number(DecodeState *d) {
+    const char *start = d->p;
+    const char *p     = start;
+    int        isint  = 1;
+    if (*p == '-') p++;
+    if (*p == '0') p++;
+    else if (isdigitc(*p)) {
+        while (isdigitc(*p)) p++;
+    }
+    else
+        decode_error(d, "invalid value");
+    if (*p == '.') {
+        p++;
+        isint = 0;
+        if (!isdigitc(*p)) goto invalid;
+        while (isdigitc(*p)) p++;
+    }
+    if (*p == 'e' || *p == 'E') {
+        p++;
+        isint = 0;
+        if (*p == '+' || *p == '-') p++;
+        if (!isdigitc(*p)) goto invalid;
+        while (isdigitc(*p)) p++;
+    }
+    if (isint && p - start <= 18) {  /* exact in a `long long' */
+        const char *q = start + (*start == '-');
+        long long  v  = 0;
+        for (; q < p; q++)
+            v = v * 10 + (*q - '0');
+        if (*start == '-') v = -v;
+        if (v == 0 && *start == '-')
+            lua_pushnumber(d->L, -0.0);
+        else if (INT_MIN <= v && v <= INT_MAX)
+            lua_pushinteger(d->L, (lua_Integer) (int) v);
+        else
+            lua_pushnumber(d->L, (lua_Number) v);
+    }
+    else
+        lua_pushnumber(d->L, (lua_Number) lua_str2number(start, NULL));
+    d->p = p;
+    return;
+invalid:
+    d->p = p;
+    decode_error(d, "invalid number");
+}
+
+
+static void decode_literal(DecodeState *d, const char *lit, size_t l) {
+    if (strncmp(d->p, lit, l) != 0)
+        decode_error(d, "invalid value");
+    d->p += l;
+}
+
+
+static void decode_value(DecodeState *d, int depth);
+
+
+static void decode_array(DecodeState *d, int depth) {
+    lua_State *L = d->L;
+    int       i  = 0;
+    lua_createtable(L, nextsize(d), 0);
+    d->p++;  /* skip '[' */
+    skipspace(d);
+    if (*d->p == ']') {
+        d->p++;
+        return;
+    }
+    for (;;) {
+        decode_value(d, depth);
+        lua_rawseti(L, -2, ++i);
+        skipspace(d);
+        if (*d->p == ',')
+            d->p++;
+        else if (*d->p == ']') {
+            d->p++;
+            return;
+        }
+        else
+            decode_error(d, "expected " LUA_QL(",") " or " LUA_QL("]"));
+    }
+}
+
+
+static void decode_object(DecodeState *d, int depth) {
+    lua_State *L = d->L;
+    lua_createtable(L, 0, nextsize(d));
+    d->p++;  /* skip '{' */
+    skipspace(d);
+    if (*d->p == '}') {
+        d->p++;
+        return;
+    }
+    for (;;) {
+        skipspace(d);
+        if (*d->p != '"')
+            decode_error(d, "expected string key");
+        decode_string(d);
+        skipspace(d);
+        if (*d->p != ':')
+            decode_error(d, "expected " LUA_QL(":"));
+        d->p++;
+        decode_value(d, depth);
+        lua_rawset(L, -3);
+        skipspace(d);
+        if (*d->p == ',')
+            d->p++;
+        else if (*d->p == '}') {
+            d->p++;
+            return;
+        }
+        else
+            decode_error(d, "expected " LUA_QL(",") " or " LUA_QL("}"));
+    }
+}
+
+
+static void decode_value(DecodeState *d, int depth) {
+    skipspace(d);
+    switch (*d->p) {
+        case '{':
+        case '[': {
+            if (depth >= JSON_MAXDEPTH)
+                decode_error(d, "too many nested levels");
+            luaL_checkstack(d->L, 3, "too many nested levels");
+            if (*d->p == '{')
+                decode_object(d, depth + 1);
+            else
+                decode_array(d, depth + 1);
+            break;
+        }
+        case '"':
+            decode_string(d);
+            break;
+        case 't':
+            decode_literal(d, "true", 4);
+            lua_pushboolean(d->L, 1);
+            break;
+        case 'f':
+            decode_literal(d, "false", 5);
+            lua_pushboolean(d->L, 0);
+            break;
+        case 'n':
+            decode_literal(d, "null", 4);
+            lua_pushlightuserdata(d->L, NULL);
+            break;
+        default:
+            decode_number(d);
+            break;
+    }
+}
+
+
+static int json_decode(lua_State *L) {
+    DecodeState d;
+    size_t      len;
+    const char  *s = luaL_checklstring(L, 1, &len);
+    lua_settop(L, 1);
+    lua_pushnil(L);  /* slot for the element counts */
+    d.L      = L;
+    d.s      = d.p = s;
+    d.e      = s + len;
+    d.sizes  = NULL;
+    d.nsizes = d.maxsizes = d.next = 0;
+    prescan(&d);
+    decode_value(&d, 0);
+    skipspace(&d);
+    if (d.p != d.e)
+        decode_error(&d, "unexpected data after value");
+    return 1;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Encoding
+** All output goes to one heap-mode buffer, whose box is created before
+** anything else is pushed: the encoder then keeps keys and values on
+** the stack above it while it writes.
+** =======================================================
+*/
+
+static void encode_string(luaL_Buffer *b, const char *s, size_t l) {
+    static const char hexdigits[] = "0123456789abcdef";
+    luaL_addchar(b, '"');
+    for (;;) {
+        size_t n = 0;
+        int    c;
+        while (n < l && s[n] != '"' && s[n] != '\\' && uchar(s[n]) >= 0x20)
+            n++;
+        luaL_addlstring(b, s, n);  /* run of plain characters */
+        if (n == l)
+            break;
+        c = uchar(s[n]);
+        s += n + 1;
+        l -= n + 1;
+        luaL_addchar(b, '\\');
+        switch (c) {
+            case '"':  luaL_addchar(b, '"'); break;
+            case '\\': luaL_addchar(b, '\\'); break;
+            case '\b': luaL_addchar(b, 'b'); break;
+            case '\f': luaL_addchar(b, 'f'); break;
+            case '\n': luaL_addchar(b, 'n'); break;
+            case '\r': luaL_addchar(b, 'r'); break;
+            case '\t': luaL_addchar(b, 't'); break;
+            default: {
+                char buff[5];
+                buff[0] = 'u';
+                buff[1] = buff[2] = '0';
+                buff[3] = hexdigits[c >> 4];
+                buff[4] = hexdigits[c & 15];
+                luaL_addlstring(b, buff, 5);
+                break;
+            }
+        }
+    }
+    luaL_addchar(b, '"');
+}
+
+
+static void encode_number(lua_State *L, luaL_Buffer *b, lua_Number n) {
+    if (n - n != 0)  /* inf or NaN? */
+        luaL_error(L, "cannot encode a non-finite number");
+    if (-9.2e18 < n && n < 9.2e18 && (lua_Number) (long long) n == n &&
+        (n != 0 || 1 / n > 0)) {  /* integral (and not -0)? */
+        char               buff[24];
+        char               *p = buff + sizeof(buff);
+        long long          i  = (long long) n;
+        unsigned long long u  = (i < 0) ? 0 - (unsigned long long) i :
+                                (unsigned long long) i;
+        do {
+            *--p = (char) ('0' + u % 10);
+        } while ((u /= 10) != 0);
+        if (i < 0) *--p = '-';
+        luaL_addlstring(b, p, buff + sizeof(buff) - p);
+    }
+    else {
+#if defined(LUA_NUMBER_SHORTEST)
+        lua_pushnumber(L, n);
+        luaL_addvalue(b);  /* the shortest exact form, as `tostring' */
+#else
+        char *p = luaL_prepbuffsize(b, LUAI_MAXNUMBER2STR);
+        luaL_addsize(b, sprintf(p, LUA_NUMBER_FMT, n));
+#endif
+    }
+}
+
+
+/* `n' if the keys of the table on top are exactly 1..n, else 0 */
+static int arraylength(lua_State *L) {
+    lua_Number max   = 0;
+    int        count = 0;
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+        lua_Number k;
+        lua_pop(L, 1);  /* value */
+        if (lua_type(L, -1) != LUA_TNUMBER ||
+            (k = lua_tonumber(L, -1)) < 1 || k > INT_MAX || floor(k) != k) {
+            lua_pop(L, 1);  /* key */
+            return 0;
+        }
+        if (k > max) max = k;
+        count++;
+    }
+    return (max == count) ? count : 0;
+}
+
+
+static void encode_value(lua_State *L, luaL_Buffer *b, int depth);
+
+
+static void encode_table(lua_State *L, luaL_Buffer *b, int depth) {
+    int n;
+    if (depth >= JSON_MAXDEPTH)
+        luaL_error(L, "cannot encode: too many nested levels (or a cycle)");
+    luaL_checkstack(L, 3, "too many nested levels");
+    n = arraylength(L);
+    if (n > 0) {
+        int i;
+        luaL_addchar(b, '[');
+        for (i = 1; i <= n; i++) {
+            if (i > 1) luaL_addchar(b, ',');
+            lua_rawgeti(L, -1, i);
+            encode_value(L, b, depth + 1);
+            lua_pop(L, 1);
+        }
+        luaL_addchar(b, ']');
+    }
+    else {
+        int first = 1;
+        luaL_addchar(b, '{');
+        lua_pushnil(L);
+        while (lua_next(L, -2)) {
+            if (!first) luaL_addchar(b, ',');
+            first = 0;
+            switch (lua_type(L, -2)) {
+                case LUA_TSTRING: {
+                    size_t     l;
+                    const char *s = lua_tolstring(L, -2, &l);
+                    encode_string(b, s, l);
+                    break;
+                }
+                case LUA_TNUMBER: {
+                    luaL_addchar(b, '"');
+                    encode_number(L, b, lua_tonumber(L, -2));
+                    luaL_addchar(b, '"');
+                    break;
+                }
+                default:
+                    luaL_error(L, "cannot encode a key of type %s",
+                               luaL_typename(L, -2));
+            }
+            luaL_addchar(b, ':');
+            encode_value(L, b, depth + 1);
+            lua_pop(L, 1);  /* value; keep key for `lua_next' */
+        }
+        luaL_addchar(b, '}');
+    }
+}
+
+
+/* encodes the value on top of the stack (and leaves it there) */
+static void encode_value(lua_State *L, luaL_Buffer *b, int depth) {
+    switch (lua_type(L, -1)) {
+        case LUA_TSTRING: {
+            size_t     l;
+            const char *s = lua_tolstring(L, -1, &l);
+            encode_string(b, s, l);
+            break;
+        }
+        case LUA_TNUMBER:
+            encode_number(L, b, lua_tonumber(L, -1));
+            break;
+        case LUA_TBOOLEAN:
+            if (lua_toboolean(L, -1))
+                luaL_addlstring(b, "true", 4);
+            else
+                luaL_addlstring(b, "false", 5);
+            break;
+        case LUA_TTABLE:
+            encode_table(L, b, depth);
+            break;
+        case LUA_TNIL:
+            luaL_addlstring(b, "null", 4);
+            break;
+        case LUA_TLIGHTUSERDATA:
+            if (lua_touserdata(L, -1) == NULL) {  /* json.null? */
+                luaL_addlstring(b, "null", 4);
+                break;
+            }
+            luaL_error(L, "cannot encode a %s", luaL_typename(L, -1));
+            break;
+        default:
+            luaL_error(L, "cannot encode a %s", luaL_typename(L, -1));
+    }
+}
+
+
+static int json_encode(lua_State *L) {
+    luaL_Buffer b;
+    luaL_checkany(L, 1);
+    lua_settop(L, 1);
+    luaL_buffinitheap(L, &b);
+    luaL_prepbuffsize(&b, LUAL_BUFFERSIZE + 1);  /* create the box now */
+    lua_pushvalue(L, 1);
+    encode_value(L, &b, 0);
+    lua_pop(L, 1);
+    luaL_pushresult(&b);
+    return 1;
+}
+
+/* }====================================================== */
+
+
+static const luaL_Reg jsonlib[] = {
+        {"decode", json_decode},
+        {"encode", json_encode},
+        {NULL, NULL}
+};
+
+
+/*
+** Open json library
+*/
+LUALIB_API int luaopen_json(lua_State *L) {
+    luaL_register(L, LUA_JSONLIBNAME, jsonlib);
+    lua_pushlightuserdata(L, NULL);
+    lua_setfield(L, -2, "null");
+    return 1;
+}
+
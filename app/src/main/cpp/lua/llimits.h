@@ -80,6 +80,14 @@ typedef LUAI_UACNUMBER l_uacNumber;
 #define cast_int(i)	cast(int, (i))
 
 
+/* hint that `x' is usually true (for the compilers that take hints) */
+#if defined(__GNUC__)
+#define luai_likely(x)	__builtin_expect(((x) != 0), 1)
+#else
+#define luai_likely(x)	(x)
+#endif
+
+
 
 /*
 ** type for virtual-machine instructions
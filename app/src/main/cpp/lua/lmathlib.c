@@ -5,7 +5,9 @@
 */
 
 
-#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
 #include <math.h>
 
 #define lmathlib_c
@@ -176,41 +178,169 @@ static int math_max(lua_State *L) {
 }
 
 
-static int math_random(lua_State *L) {
-    /* the `%' avoids the (rare) case of r==1, and is needed also because on
-       some systems (SunOS!) `rand()' may return a value larger than RAND_MAX */
-    lua_Number r = (lua_Number) (rand() % RAND_MAX) / (lua_Number) RAND_MAX;
-    switch (lua_gettop(L)) {  /* check number of arguments */
-        case 0: {  /* no arguments */
-            lua_pushnumber(L, r);  /* Number between 0 and 1 */
-            break;
-        }
-        case 1: {  /* only upper limit */
-            int u = luaL_checkint(L, 1);
-            luaL_argcheck(L, 1 <= u, 1, "interval is empty");
-            lua_pushnumber(L, floor(r * u) + 1);  /* int between 1 and `u' */
-            break;
-        }
-        case 2: {  /* lower and upper limits */
-            int l = luaL_checkint(L, 1);
-            int u = luaL_checkint(L, 2);
-            luaL_argcheck(L, l <= u, 2, "interval is empty");
-            lua_pushnumber(L, floor(r * (u - l + 1)) + l);  /* int between `l' and `u' */
-            break;
+/*
+** {======================================================
+** Pseudo-random numbers: xoshiro256** (http://prng.di.unimi.it/). Each
+** state has its own generator, kept in a userdata that is the upvalue
+** of the functions using it, so states never share a generator or a lock.
+** =======================================================
+*/
+
+typedef struct RanState {
+    uint64_t s[4];
+}                     RanState;
+
+
+#define rotl(x, n)    (((x) << (n)) | ((x) >> (64 - (n))))
+
+static uint64_t nextrand(uint64_t *s) {
+    uint64_t res = rotl(s[1] * 5, 7) * 9;
+    uint64_t t   = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return res;
+}
+
+
+/* float in [0, 1) from the 53 higher bits of `r' */
+#define randfloat(r)    ((lua_Number) ((r) >> 11) * (0.5 / ((uint64_t) 1 << 52)))
+
+
+/*
+** uniform integer in [0, n], for `n' below 2^32: the high half of
+** (`r' >> 32) * (n + 1) (Lemire's method), redrawing the few values
+** that would make some results more likely than others
+*/
+static uint64_t project(uint64_t r, uint64_t n, RanState *state) {
+    uint64_t s = n + 1;  /* size of the interval (up to 2^32) */
+    uint64_t m = (r >> 32) * s;
+    if ((uint32_t) m < s) {  /* may be one of the extra values? */
+        uint32_t t = (uint32_t) ((((uint64_t) 1 << 32) - s) % s);
+        while ((uint32_t) m < t) {
+            r = nextrand(state->s);
+            m = (r >> 32) * s;
         }
-        default:
-            return luaL_error(L, "wrong number of arguments");
     }
+    return m >> 32;
+}
+
+
+static void setseed(RanState *state, uint64_t n1, uint64_t n2) {
+    int i;
+    state->s[0] = n1;
+    state->s[1] = 0xff;  /* avoid a zero state */
+    state->s[2] = n2;
+    state->s[3] = 0;
+    for (i = 0; i < 16; i++)
+        nextrand(state->s);  /* discard initial values to "spread" seed */
+}
+
+
+static void randseed(lua_State *L, RanState *state) {
+    uint64_t n1 = (uint64_t) time(NULL);
+    uint64_t n2 = (uint64_t) (size_t) L ^ ((uint64_t) (size_t) state << 32);
+    setseed(state, n1, n2);
+}
+
+
+#define getranstate(L)    ((RanState *) lua_touserdata(L, lua_upvalueindex(1)))
+
+
+/*
+** reads the limits of an integer result: [1, `u'] or [`l', `u'] from
+** argument `arg' on, by the number `nlim' of them given
+*/
+static void getlimits(lua_State *L, int nlim, int arg, int *l, int *u) {
+    if (nlim == 1) {
+        *l = 1;
+        *u = luaL_checkint(L, arg);
+        luaL_argcheck(L, *l <= *u, arg, "interval is empty");
+    }
+    else {
+        *l = luaL_checkint(L, arg);
+        *u = luaL_checkint(L, arg + 1);
+        luaL_argcheck(L, *l <= *u, arg + 1, "interval is empty");
+    }
+}
+
+
+/* pushes a float in [0, 1) if `nlim' is 0, else an integer in [l, u] */
+static void pushrandom(lua_State *L, RanState *state, int nlim, int l, int u) {
+    uint64_t r = nextrand(state->s);
+    if (nlim == 0)
+        lua_pushnumber(L, randfloat(r));
+    else {
+        r = project(r, (uint64_t) ((int64_t) u - l), state);
+        lua_pushinteger(L, (lua_Integer) ((int64_t) l + (int64_t) r));
+    }
+}
+
+
+static int math_random(lua_State *L) {
+    int n = lua_gettop(L);
+    int l = 0, u = 0;
+    if (n > 2)
+        return luaL_error(L, "wrong number of arguments");
+    if (n > 0)
+        getlimits(L, n, 1, &l, &u);
+    pushrandom(L, getranstate(L), n, l, u);
+    return 1;
+}
+
+
+/*
+** randomfill(t, n [, m [, k]]): sets t[1..n] to what `random' would
+** return for the same limits; returns `t'
+*/
+static int math_randomfill(lua_State *L) {
+    RanState *state = getranstate(L);
+    int      n      = luaL_checkint(L, 2);
+    int      nlim   = lua_gettop(L) - 2;
+    int      l      = 0, u = 0;
+    int      i;
+    luaL_checktype(L, 1, LUA_TTABLE);
+    luaL_argcheck(L, nlim <= 2, 5, "wrong number of arguments");
+    if (nlim > 0)
+        getlimits(L, nlim, 3, &l, &u);
+    for (i = 1; i <= n; i++) {
+        pushrandom(L, state, nlim, l, u);
+        lua_rawseti(L, 1, i);
+    }
+    lua_settop(L, 1);
     return 1;
 }
 
 
 static int math_randomseed(lua_State *L) {
-    srand(luaL_checkint(L, 1));
+    RanState *state = getranstate(L);
+    if (lua_isnone(L, 1))
+        randseed(L, state);
+    else {
+        lua_Number n1 = luaL_checknumber(L, 1);
+        lua_Number n2 = luaL_optnumber(L, 2, 0);
+        uint64_t   b1, b2;
+        memcpy(&b1, &n1, sizeof(b1));  /* every number gives its own seed */
+        memcpy(&b2, &n2, sizeof(b2));
+        setseed(state, b1, b2);
+    }
     return 0;
 }
 
 
+static const luaL_Reg randfuncs[] = {
+        {"random",     math_random},
+        {"randomfill", math_randomfill},
+        {"randomseed", math_randomseed},
+        {NULL, NULL}
+};
+
+/* }====================================================== */
+
+
 static const luaL_Reg mathlib[] = {
         {"abs",        math_abs},
         {"acos",       math_acos},
@@ -233,8 +363,6 @@ static const luaL_Reg mathlib[] = {
         {"modf",       math_modf},
         {"pow",        math_pow},
         {"rad",        math_rad},
-        {"random",     math_random},
-        {"randomseed", math_randomseed},
         {"sinh",       math_sinh},
         {"sin",        math_sin},
         {"sqrt",       math_sqrt},
@@ -248,7 +376,11 @@ static const luaL_Reg mathlib[] = {
 ** Open math library
 */
 LUALIB_API int luaopen_math(lua_State *L) {
+    RanState *state;
     luaL_register(L, LUA_MATHLIBNAME, mathlib);
+    state = (RanState *) lua_newuserdata(L, sizeof(RanState));
+    setseed(state, 0, 0);  /* fixed default: same sequence on every run */
+    luaI_openlib(L, NULL, randfuncs, 1);
     lua_pushnumber(L, PI);
     lua_setfield(L, -2, "pi");
     lua_pushnumber(L, HUGE_VAL);
@@ -5,9 +5,12 @@
 */
 
 #include <ctype.h>
+#include <locale.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define lobject_c
 #define LUA_CORE
@@ -87,6 +90,8 @@ int luaO_rawequalObj(const TValue *t1, const TValue *t2) {
                 return bvalue(t1) == bvalue(t2);  /* boolean true must be 1 !! */
             case LUA_TLIGHTUSERDATA:
                 return pvalue(t1) == pvalue(t2);
+            case LUA_TSTRING:
+                return luaS_eqstr(rawtsvalue(t1), rawtsvalue(t2));
             default:
                 lua_assert(iscollectable(t1));
                 return gcvalue(t1) == gcvalue(t2);
@@ -94,8 +99,112 @@ int luaO_rawequalObj(const TValue *t1, const TValue *t2) {
 }
 
 
+/*
+** sets `obj' to `n', with the integer subtype if `n' is an exact `int'
+*/
+void luaO_setnumber(TValue *obj, lua_Number n) {
+    int i;
+    lua_number2int(i, n);
+    if (luai_numeq(cast_num(i), n) && (i != 0 || 1 / n > 0)) {  /* not -0 */
+        setivalue(obj, i);
+    }
+    else {
+        setnvalue(obj, n);
+    }
+}
+
+
+/*
+** {======================================================
+** Numbers and strings
+** Decimal numerals with at most 15 significant digits and small
+** exponents are read without `strtod': both the digits and the power of
+** 10 are exact doubles, so one multiplication or division rounds
+** correctly. Integral numbers are written without `sprintf'. With
+** LUA_NUMBER_SHORTEST other numbers are written with Grisu3 (Loitsch,
+** "Printing Floating-Point Numbers Quickly and Accurately with
+** Integers"), which gives the shortest digits that read back as the same
+** double; in the few cases it cannot prove its digits shortest, they are
+** searched for with `sprintf' and `lua_str2number'.
+** =======================================================
+*/
+
+#if defined(LUA_NUMBER_DOUBLE)
+
+static const double pow10num[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+/* returns 0 when `s' is not a plain decimal numeral (let `strtod' try) */
+static int str2dfast(const char *s, lua_Number *result) {
+    uint64_t m   = 0;
+    int      nd  = 0;  /* significant digits in `m' */
+    int      e   = 0;  /* decimal exponent of `m' */
+    int      neg = 0;
+    while (isspace(cast(unsigned char, *s))) s++;
+    if (*s == '-') {
+        neg = 1;
+        s++;
+    }
+    else if (*s == '+') s++;
+    if (!isdigit(cast(unsigned char, *s)) &&
+        !(*s == '.' && isdigit(cast(unsigned char, *(s + 1)))))
+        return 0;
+    for (; isdigit(cast(unsigned char, *s)); s++) {
+        if (m != 0 || *s != '0') {
+            if (++nd > 15) return 0;
+            m = m * 10 + (*s - '0');
+        }
+    }
+    if (*s == '.') {
+        if (localeconv()->decimal_point[0] != '.') return 0;
+        for (s++; isdigit(cast(unsigned char, *s)); s++) {
+            if (m != 0 || *s != '0') {
+                if (++nd > 15) return 0;
+                m = m * 10 + (*s - '0');
+            }
+            e--;
+        }
+    }
+    if (*s == 'e' || *s == 'E') {
+        int eneg = 0;
+        int x    = 0;
+        s++;
+        if (*s == '-') {
+            eneg = 1;
+            s++;
+        }
+        else if (*s == '+') s++;
+        if (!isdigit(cast(unsigned char, *s))) return 0;
+        for (; isdigit(cast(unsigned char, *s)); s++) {
+            if (x > 1000) return 0;
+            x = x * 10 + (*s - '0');
+        }
+        e += eneg ? -x : x;
+    }
+    while (isspace(cast(unsigned char, *s))) s++;
+    if (*s != '\0') return 0;
+    if (m == 0)
+        *result = neg ? -0.0 : 0.0;
+    else if (-22 <= e && e <= 22) {
+        double d = cast_num(m);
+        d = (e < 0) ? d / pow10num[-e] : d * pow10num[e];
+        *result = neg ? -d : d;
+    }
+    else return 0;
+    return 1;
+}
+
+#endif
+
+
 int luaO_str2d(const char *s, lua_Number *result) {
     char *endptr;
+#if defined(LUA_NUMBER_DOUBLE)
+    if (str2dfast(s, result)) return 1;
+#endif
     *result = lua_str2number(s, &endptr);
     if (endptr == s) return 0;  /* conversion failed */
     if (*endptr == 'x' || *endptr == 'X')  /* maybe an hexadecimal constant? */
@@ -107,6 +216,376 @@ int luaO_str2d(const char *s, lua_Number *result) {
 }
 
 
+#if defined(LUA_NUMBER_DOUBLE)
+
+/* writes the decimal digits of `u' (plus a '\0'); returns their number */
+static int writeuint(char *s, uint64_t u) {
+    char buff[24];
+    char *p = buff + sizeof(buff);
+    int  n;
+    do {
+        *--p = cast(char, '0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    n = cast_int(buff + sizeof(buff) - p);
+    memcpy(s, p, n);
+    s[n] = '\0';
+    return n;
+}
+
+
+#if defined(LUA_NUMBER_SHORTEST)
+
+typedef struct DiyFp {
+    uint64_t f;
+    int      e;
+} DiyFp;
+
+
+static const uint64_t cachedpow_f[] = {
+        UINT64_C(0xfa8fd5a0081c0288), UINT64_C(0xbaaee17fa23ebf76), UINT64_C(0x8b16fb203055ac76),
+        UINT64_C(0xcf42894a5dce35ea), UINT64_C(0x9a6bb0aa55653b2d), UINT64_C(0xe61acf033d1a45df),
+        UINT64_C(0xab70fe17c79ac6ca), UINT64_C(0xff77b1fcbebcdc4f), UINT64_C(0xbe5691ef416bd60c),
+        UINT64_C(0x8dd01fad907ffc3c), UINT64_C(0xd3515c2831559a83), UINT64_C(0x9d71ac8fada6c9b5),
+        UINT64_C(0xea9c227723ee8bcb), UINT64_C(0xaecc49914078536d), UINT64_C(0x823c12795db6ce57),
+        UINT64_C(0xc21094364dfb5637), UINT64_C(0x9096ea6f3848984f), UINT64_C(0xd77485cb25823ac7),
+        UINT64_C(0xa086cfcd97bf97f4), UINT64_C(0xef340a98172aace5), UINT64_C(0xb23867fb2a35b28e),
+        UINT64_C(0x84c8d4dfd2c63f3b), UINT64_C(0xc5dd44271ad3cdba), UINT64_C(0x936b9fcebb25c996),
+        UINT64_C(0xdbac6c247d62a584), UINT64_C(0xa3ab66580d5fdaf6), UINT64_C(0xf3e2f893dec3f126),
+        UINT64_C(0xb5b5ada8aaff80b8), UINT64_C(0x87625f056c7c4a8b), UINT64_C(0xc9bcff6034c13053),
+        UINT64_C(0x964e858c91ba2655), UINT64_C(0xdff9772470297ebd), UINT64_C(0xa6dfbd9fb8e5b88f),
+        UINT64_C(0xf8a95fcf88747d94), UINT64_C(0xb94470938fa89bcf), UINT64_C(0x8a08f0f8bf0f156b),
+        UINT64_C(0xcdb02555653131b6), UINT64_C(0x993fe2c6d07b7fac), UINT64_C(0xe45c10c42a2b3b06),
+        UINT64_C(0xaa242499697392d3), UINT64_C(0xfd87b5f28300ca0e), UINT64_C(0xbce5086492111aeb),
+        UINT64_C(0x8cbccc096f5088cc), UINT64_C(0xd1b71758e219652c), UINT64_C(0x9c40000000000000),
+        UINT64_C(0xe8d4a51000000000), UINT64_C(0xad78ebc5ac620000), UINT64_C(0x813f3978f8940984),
+        UINT64_C(0xc097ce7bc90715b3), UINT64_C(0x8f7e32ce7bea5c70), UINT64_C(0xd5d238a4abe98068),
+        UINT64_C(0x9f4f2726179a2245), UINT64_C(0xed63a231d4c4fb27), UINT64_C(0xb0de65388cc8ada8),
+        UINT64_C(0x83c7088e1aab65db), UINT64_C(0xc45d1df942711d9a), UINT64_C(0x924d692ca61be758),
+        UINT64_C(0xda01ee641a708dea), UINT64_C(0xa26da3999aef774a), UINT64_C(0xf209787bb47d6b85),
+        UINT64_C(0xb454e4a179dd1877), UINT64_C(0x865b86925b9bc5c2), UINT64_C(0xc83553c5c8965d3d),
+        UINT64_C(0x952ab45cfa97a0b3), UINT64_C(0xde469fbd99a05fe3), UINT64_C(0xa59bc234db398c25),
+        UINT64_C(0xf6c69a72a3989f5c), UINT64_C(0xb7dcbf5354e9bece), UINT64_C(0x88fcf317f22241e2),
+        UINT64_C(0xcc20ce9bd35c78a5), UINT64_C(0x98165af37b2153df), UINT64_C(0xe2a0b5dc971f303a),
+        UINT64_C(0xa8d9d1535ce3b396), UINT64_C(0xfb9b7cd9a4a7443c), UINT64_C(0xbb764c4ca7a44410),
+        UINT64_C(0x8bab8eefb6409c1a), UINT64_C(0xd01fef10a657842c), UINT64_C(0x9b10a4e5e9913129),
+        UINT64_C(0xe7109bfba19c0c9d), UINT64_C(0xac2820d9623bf429), UINT64_C(0x80444b5e7aa7cf85),
+        UINT64_C(0xbf21e44003acdd2d), UINT64_C(0x8e679c2f5e44ff8f), UINT64_C(0xd433179d9c8cb841),
+        UINT64_C(0x9e19db92b4e31ba9), UINT64_C(0xeb96bf6ebadf77d9), UINT64_C(0xaf87023b9bf0ee6b)
+};
+
+static const short cachedpow_e[] = {
+        -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+        -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+        -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+        -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+        -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+        109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+        375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+        641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+        907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const uint64_t pow10int[] = {
+        UINT64_C(1), UINT64_C(10), UINT64_C(100), UINT64_C(1000),
+        UINT64_C(10000), UINT64_C(100000), UINT64_C(1000000),
+        UINT64_C(10000000), UINT64_C(100000000), UINT64_C(1000000000),
+        UINT64_C(10000000000), UINT64_C(100000000000),
+        UINT64_C(1000000000000), UINT64_C(10000000000000),
+        UINT64_C(100000000000000), UINT64_C(1000000000000000),
+        UINT64_C(10000000000000000), UINT64_C(100000000000000000),
+        UINT64_C(1000000000000000000), UINT64_C(10000000000000000000)
+};
+
+
+static DiyFp diyfp(uint64_t f, int e) {
+    DiyFp r;
+    r.f = f;
+    r.e = e;
+    return r;
+}
+
+
+/* product rounded to the upper 64 bits */
+static DiyFp diyfp_mul(DiyFp x, DiyFp y) {
+    const uint64_t M32 = 0xFFFFFFFFu;
+    uint64_t       a   = x.f >> 32, b = x.f & M32;
+    uint64_t       c   = y.f >> 32, d = y.f & M32;
+    uint64_t       ac  = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t       tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+    tmp += UINT64_C(1) << 31;  /* round */
+    return diyfp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64);
+}
+
+
+static DiyFp diyfp_normalize(DiyFp x) {
+    while (!(x.f & (UINT64_C(1) << 63))) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+
+/*
+** Moves the last digit of `buffer' towards `w' while the result stays in
+** the unsafe interval; fails (returns 0) unless the digits are then
+** surely the closest to `w' and surely inside the true interval. All
+** values are scaled by 10^-kappa; `unit' is the error of the products.
+*/
+static int roundweed(char *buffer, int len, uint64_t dist_high_w,
+                     uint64_t unsafe, uint64_t rest, uint64_t ten_kappa,
+                     uint64_t unit) {
+    uint64_t small = dist_high_w - unit;  /* surely above `w' */
+    uint64_t big   = dist_high_w + unit;  /* surely below `w' */
+    while (rest < small && unsafe - rest >= ten_kappa &&
+           (rest + ten_kappa < small ||
+            small - rest >= rest + ten_kappa - small)) {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+    if (rest < big && unsafe - rest >= ten_kappa &&
+        (rest + ten_kappa < big ||
+         big - rest > rest + ten_kappa - big))
+        return 0;  /* the next lower digit may be closer */
+    return 2 * unit <= rest && rest <= unsafe - 4 * unit;
+}
+
+
+static int countdigits(uint32_t n) {
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+
+/*
+** Generates the digits of `hi' until they are within the unsafe interval
+** (`lo' - 1, `hi' + 1) around `w'; returns their number, or 0 when it
+** cannot tell that they are the shortest and closest ones.
+*/
+static int digitgen(DiyFp lo, DiyFp w, DiyFp hi, char *buffer, int *k) {
+    uint64_t unit   = 1;
+    uint64_t high   = hi.f + unit;
+    uint64_t unsafe = high - (lo.f - unit);
+    DiyFp    one    = diyfp(UINT64_C(1) << -w.e, w.e);
+    uint32_t p1     = (uint32_t) (high >> -one.e);
+    uint64_t p2     = high & (one.f - 1);
+    int      kappa  = countdigits(p1);
+    int      len    = 0;
+    while (kappa > 0) {
+        uint32_t pw = (uint32_t) pow10int[kappa - 1];
+        uint64_t rest;
+        buffer[len++] = cast(char, '0' + p1 / pw);
+        p1 %= pw;
+        kappa--;
+        rest = ((uint64_t) p1 << -one.e) + p2;
+        if (rest < unsafe) {
+            *k += kappa;
+            return roundweed(buffer, len, high - w.f, unsafe, rest,
+                             (uint64_t) pw << -one.e, unit) ? len : 0;
+        }
+    }
+    for (; ;) {  /* kappa <= 0 */
+        p2 *= 10;
+        unit *= 10;
+        unsafe *= 10;
+        buffer[len++] = cast(char, '0' + (p2 >> -one.e));
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < unsafe) {
+            *k += kappa;
+            return roundweed(buffer, len, (high - w.f) * unit, unsafe, p2,
+                             one.f, unit) ? len : 0;
+        }
+    }
+}
+
+
+/*
+** Digits of `v' (finite, > 0) in `buffer', v = digits * 10^k, with
+** Grisu3; returns their number, or 0 in the few cases (about 0.5%) in
+** which it cannot prove that they are the shortest.
+*/
+static int grisu3(double v, char *buffer, int *k) {
+    uint64_t bits;
+    DiyFp    w, pl, mi, c;
+    int      biased, ck, index;
+    double   dk;
+    memcpy(&bits, &v, sizeof(bits));
+    biased = cast_int((bits >> 52) & 0x7FF);
+    if (biased != 0)
+        w = diyfp((bits & UINT64_C(0xFFFFFFFFFFFFF)) | (UINT64_C(1) << 52),
+                  biased - 1075);
+    else
+        w = diyfp(bits & UINT64_C(0xFFFFFFFFFFFFF), 1 - 1075);
+    /* boundaries m+ and m-, with the exponent of the normalized `w' */
+    pl = diyfp_normalize(diyfp((w.f << 1) + 1, w.e - 1));
+    if (w.f == (UINT64_C(1) << 52) && biased > 1)  /* m- is closer? */
+        mi = diyfp((w.f << 2) - 1, w.e - 2);
+    else
+        mi = diyfp((w.f << 1) - 1, w.e - 1);
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+    /* cached power of 10 that brings m+ into [2^-60, 2^-32) */
+    dk = (-61 - pl.e) * 0.30102999566398114 + 347;
+    ck = cast_int(dk);
+    if (dk - ck > 0.0) ck++;
+    index = (ck >> 3) + 1;
+    *k = -(-348 + index * 8);
+    c  = diyfp(cachedpow_f[index], cachedpow_e[index]);
+    return digitgen(diyfp_mul(mi, c), diyfp_mul(diyfp_normalize(w), c),
+                    diyfp_mul(pl, c), buffer, k);
+}
+
+
+/*
+** The `n'-digit decimal closest to `v' that reads back as `v', if any
+** (returns 0 otherwise). `sprintf' rounds correctly, so the closest
+** decimal is checked; the next one up is also checked when `v' is a
+** power of 2, the only case in which the interval of decimals that read
+** back as `v' extends further above it than below.
+*/
+static int exactdigits(double v, int n, int pow2, char *digits, int *k) {
+    char buff[32];
+    int  i, x;
+    sprintf(buff, "%.*e", n - 1, v);
+    if (lua_str2number(buff, NULL) != v) {
+        if (!pow2 || lua_str2number(buff, NULL) > v) return 0;
+        for (i = (n > 1) ? n : 0; i >= 0; i--) {  /* add 1 to the digits */
+            if (buff[i] == '.') continue;
+            if (buff[i] != '9') break;
+            buff[i] = '0';
+        }
+        if (i < 0) return 0;  /* a power of 10: never read as a power of 2 */
+        buff[i]++;
+        if (lua_str2number(buff, NULL) != v) return 0;
+    }
+    x = atoi(strchr(buff, 'e') + 1);
+    digits[0] = buff[0];
+    if (n > 1) memcpy(digits + 1, buff + 2, n - 1);
+    *k = x - n + 1;
+    while (n > 1 && digits[n - 1] == '0') {
+        n--;
+        (*k)++;
+    }
+    return n;
+}
+
+
+/*
+** Shortest digits of `v' without Grisu: a decimal with fewer digits is
+** also one with more, so the number of digits that read back as `v' can
+** be searched by bisection (17 always do).
+*/
+static int exactshortest(double v, char *digits, int *k) {
+    uint64_t bits;
+    int      pow2, lo = 1, hi = 17;
+    memcpy(&bits, &v, sizeof(bits));
+    pow2 = (bits & UINT64_C(0xFFFFFFFFFFFFF)) == 0 && (bits >> 52) > 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        char d[24];
+        int  dk;
+        if (exactdigits(v, mid, pow2, d, &dk)) hi = mid;
+        else lo = mid + 1;
+    }
+    return exactdigits(v, lo, pow2, digits, k);
+}
+
+
+/* `v' (finite, > 0) as in `%.17g' but with the shortest exact digits */
+static int writeshortest(char *s, double v) {
+    char digits[24];
+    char *p = s;
+    int  k, n, x, i;
+    n = grisu3(v, digits, &k);
+    if (n == 0) n = exactshortest(v, digits, &k);
+    x = n + k - 1;  /* exponent in scientific notation */
+    if (-4 <= x && x < 17) {
+        if (k >= 0) {  /* integral */
+            memcpy(p, digits, n);
+            p += n;
+            for (i = 0; i < k; i++) *p++ = '0';
+        }
+        else if (x >= 0) {  /* dddd.ddd */
+            memcpy(p, digits, x + 1);
+            p += x + 1;
+            *p++ = '.';
+            memcpy(p, digits + x + 1, n - x - 1);
+            p += n - x - 1;
+        }
+        else {  /* 0.000ddd */
+            *p++ = '0';
+            *p++ = '.';
+            for (i = 0; i < -x - 1; i++) *p++ = '0';
+            memcpy(p, digits, n);
+            p += n;
+        }
+    }
+    else {  /* d.ddde+xx */
+        *p++ = digits[0];
+        if (n > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, n - 1);
+            p += n - 1;
+        }
+        *p++ = 'e';
+        *p++ = (x < 0) ? '-' : '+';
+        if (x < 0) x = -x;
+        if (x < 10) *p++ = '0';
+        p += writeuint(p, cast(uint64_t, x));
+    }
+    *p = '\0';
+    return cast_int(p - s);
+}
+
+#define NUM2STR_INTMAX    9007199254740992.0  /* 2^53 */
+
+#else
+
+#define NUM2STR_INTMAX    1e14  /* larger ones get an exponent with %.14g */
+
+#endif
+
+#endif
+
+
+/*
+** Writes `n' as LUA_NUMBER_FMT would (or its shortest exact form, with
+** LUA_NUMBER_SHORTEST); returns the length.
+*/
+int luaO_num2str(char *s, lua_Number n) {
+#if defined(LUA_NUMBER_DOUBLE)
+    if (-NUM2STR_INTMAX < n && n < NUM2STR_INTMAX) {
+        int64_t i = (int64_t) n;
+        if (cast_num(i) == n && (i != 0 || 1 / n > 0)) {  /* not -0 */
+            if (i < 0) {
+                *s = '-';
+                return writeuint(s + 1, cast(uint64_t, -i)) + 1;
+            }
+            return writeuint(s, cast(uint64_t, i));
+        }
+    }
+#if defined(LUA_NUMBER_SHORTEST)
+    if (n != 0 && n - n == 0) {  /* finite? */
+        if (n < 0) {
+            *s = '-';
+            return writeshortest(s + 1, -n) + 1;
+        }
+        return writeshortest(s, n);
+    }
+#endif
+#endif
+    return sprintf(s, LUA_NUMBER_FMT, n);
+}
+
+/* }====================================================== */
+
+
 static void pushstr(lua_State *L, const char *str) {
     setsvalue2s(L, L->top, luaS_new(L, str));
     incr_top(L);
@@ -58,6 +58,7 @@ typedef union {
     GCObject   *gc;
     void       *p;
     lua_Number n;
+    int        i;
     int        b;
 }                      Value;
 
@@ -73,22 +74,45 @@ typedef struct lua_TValue {
 }                      TValue;
 
 
+/*
+** Numbers holding an exact `int' (other than -0) may have the variant
+** tag LUA_TNUMINT (see LUA_INTSUBTYPE); `ttype' gives LUA_TNUMBER for
+** both and `nvalue' the lua_Number of both.
+*/
+#define NUMINT_BIT    0x10
+#define LUA_TNUMINT   (LUA_TNUMBER | NUMINT_BIT)
+
+
 /* Macros to test type */
-#define ttisnil(o)    (ttype(o) == LUA_TNIL)
+#define ttisnil(o)    ((o)->tt == LUA_TNIL)
 #define ttisnumber(o)    (ttype(o) == LUA_TNUMBER)
-#define ttisstring(o)    (ttype(o) == LUA_TSTRING)
-#define ttistable(o)    (ttype(o) == LUA_TTABLE)
-#define ttisfunction(o)    (ttype(o) == LUA_TFUNCTION)
-#define ttisboolean(o)    (ttype(o) == LUA_TBOOLEAN)
-#define ttisuserdata(o)    (ttype(o) == LUA_TUSERDATA)
-#define ttisthread(o)    (ttype(o) == LUA_TTHREAD)
-#define ttislightuserdata(o)    (ttype(o) == LUA_TLIGHTUSERDATA)
+#define ttisstring(o)    ((o)->tt == LUA_TSTRING)
+#define ttistable(o)    ((o)->tt == LUA_TTABLE)
+#define ttisfunction(o)    ((o)->tt == LUA_TFUNCTION)
+#define ttisboolean(o)    ((o)->tt == LUA_TBOOLEAN)
+#define ttisuserdata(o)    ((o)->tt == LUA_TUSERDATA)
+#define ttisthread(o)    ((o)->tt == LUA_TTHREAD)
+#define ttislightuserdata(o)    ((o)->tt == LUA_TLIGHTUSERDATA)
 
 /* Macros to access values */
+#if defined(LUA_INTSUBTYPE)
+#define ttype(o)    ((o)->tt & ~NUMINT_BIT)
+#define ttisint(o)    ((o)->tt == LUA_TNUMINT)
+#define ttisfloat(o)    ((o)->tt == LUA_TNUMBER)
+#define fltvalue(o)    check_exp(ttisfloat(o), (o)->value.n)
+#define ivalue(o)    check_exp(ttisint(o), (o)->value.i)
+#define nvalue(o)    check_exp(ttisnumber(o), \
+    ttisint(o) ? cast_num((o)->value.i) : (o)->value.n)
+#else
 #define ttype(o)    ((o)->tt)
+#define ttisint(o)    0
+#define ttisfloat(o)    ttisnumber(o)
+#define fltvalue(o)    nvalue(o)
+#define ivalue(o)    cast_int((o)->value.n)
+#define nvalue(o)    check_exp(ttisnumber(o), (o)->value.n)
+#endif
 #define gcvalue(o)    check_exp(iscollectable(o), (o)->value.gc)
 #define pvalue(o)    check_exp(ttislightuserdata(o), (o)->value.p)
-#define nvalue(o)    check_exp(ttisnumber(o), (o)->value.n)
 #define rawtsvalue(o)    check_exp(ttisstring(o), &(o)->value.gc->ts)
 #define tsvalue(o)    (&rawtsvalue(o)->tsv)
 #define rawuvalue(o)    check_exp(ttisuserdata(o), &(o)->value.gc->u)
@@ -117,6 +141,13 @@ typedef struct lua_TValue {
 #define setnvalue(obj, x) \
   { TValue *i_o=(obj); i_o->value.n=(x); i_o->tt=LUA_TNUMBER; }
 
+#if defined(LUA_INTSUBTYPE)
+#define setivalue(obj, x) \
+  { TValue *i_o=(obj); i_o->value.i=(x); i_o->tt=LUA_TNUMINT; }
+#else
+#define setivalue(obj, x)    setnvalue(obj, cast_num(x))
+#endif
+
 #define setpvalue(obj, x) \
   { TValue *i_o=(obj); i_o->value.p=(x); i_o->tt=LUA_TLIGHTUSERDATA; }
 
@@ -179,7 +210,7 @@ typedef struct lua_TValue {
 #define setobj2n    setobj
 #define setsvalue2n    setsvalue
 
-#define setttype(obj, tt) (ttype(obj) = (tt))
+#define setttype(obj, t) ((obj)->tt = (t))
 
 
 #define iscollectable(o)    (ttype(o) >= LUA_TSTRING)
@@ -197,6 +228,8 @@ typedef union TString {
     struct {
         CommonHeader;
         lu_byte      reserved;
+        lu_byte      hashed;
+        /* long strings are hashed on first use as a key */
         unsigned int hash;
         size_t       len;
     }           tsv;
@@ -325,6 +358,17 @@ typedef union Closure {
 ** Tables
 */
 
+#if defined(LUA_USE_OPENHASH)
+
+typedef union TKey {
+    struct {
+        TValuefields;
+    }      nk;
+    TValue tvk;
+}              TKey;
+
+#else
+
 typedef union TKey {
     struct {
         TValuefields;
@@ -333,6 +377,8 @@ typedef union TKey {
     TValue tvk;
 }              TKey;
 
+#endif
+
 
 typedef struct Node {
     TValue i_val;
@@ -350,10 +396,16 @@ typedef struct Table {
     TValue       *array;
     /* array part */
     Node         *node;
+#if defined(LUA_USE_OPENHASH)
+    int          nodefree;
+    /* number of never used positions that may still be taken */
+#else
     Node         *lastfree;
     /* any free position is before this position */
+#endif
     GCObject     *gclist;
     int          sizearray;  /* size of `array' array */
+    unsigned int border;  /* last boundary found (see `luaH_getn') */
 }              Table;
 
 
@@ -383,8 +435,12 @@ LUAI_FUNC int        luaO_fb2int(int x);
 
 LUAI_FUNC int        luaO_rawequalObj(const TValue *t1, const TValue *t2);
 
+LUAI_FUNC void       luaO_setnumber(TValue *obj, lua_Number n);
+
 LUAI_FUNC int        luaO_str2d(const char *s, lua_Number *result);
 
+LUAI_FUNC int        luaO_num2str(char *s, lua_Number n);
+
 LUAI_FUNC const char *luaO_pushvfstring(lua_State *L, const char *fmt,
                                         va_list argp);
 
@@ -183,7 +183,7 @@ static int indexupvalue(FuncState *fs, TString *name, expdesc *v) {
     int   oldsize = f->sizeupvalues;
     for (i = 0; i < f->nups; i++) {
         if (fs->upvalues[i].k == v->k && fs->upvalues[i].info == v->u.s.info) {
-            lua_assert(f->upvalues[i] == name);
+            lua_assert(luaS_eqstr(f->upvalues[i], name));
             return i;
         }
     }
@@ -204,7 +204,7 @@ static int indexupvalue(FuncState *fs, TString *name, expdesc *v) {
 static int searchvar(FuncState *fs, TString *n) {
     int i;
     for (i = fs->nactvar - 1; i >= 0; i--) {
-        if (n == getlocvar(fs, i).varname)
+        if (luaS_eqstr(n, getlocvar(fs, i).varname))
             return i;
     }
     return -1;  /* not found */
@@ -226,6 +226,8 @@ static int singlevaraux(FuncState *fs, TString *n, expdesc *var, int base) {
     else {
         int v = searchvar(fs, n);  /* look up at current level */
         if (v >= 0) {
+            if ((fs->f->is_vararg & VARARG_HASARG) && v == fs->f->numparams)
+                fs->argused = 1;  /* the `arg' parameter */
             init_exp(var, VLOCAL, v);
             if (!base)
                 markupval(fs, v);  /* local will be used as an upval */
@@ -271,7 +273,7 @@ static void adjust_assign(LexState *ls, int nvars, int nexps, expdesc *e) {
 
 
 static void enterlevel(LexState *ls) {
-    if (++ls->L->nCcalls > LUAI_MAXCCALLS)
+    if (++ls->L->nCcalls > G(ls->L)->maxccalls)
         luaX_lexerror(ls, "chunk has too many syntax levels", 0);
 }
 
@@ -338,6 +340,7 @@ static void open_func(LexState *ls, FuncState *fs) {
     fs->np          = 0;
     fs->nlocvars    = 0;
     fs->nactvar     = 0;
+    fs->argused     = 0;
     fs->bl          = NULL;
     f->source       = ls->source;
     f->maxstacksize = 2;  /* registers 0/1 are always valid */
@@ -356,6 +359,8 @@ static void close_func(LexState *ls) {
     Proto     *f  = fs->f;
     removevars(ls, 0);
     luaK_ret(fs, 0, 0);  /* final return */
+    if (!fs->argused)  /* build no `arg' table that nobody reads */
+        f->is_vararg &= ~VARARG_NEEDSARG;
     luaM_reallocvector(L, f->code, f->sizecode, fs->pc, Instruction);
     f->sizecode = fs->pc;
     luaM_reallocvector(L, f->lineinfo, f->sizelineinfo, fs->pc, int);
@@ -978,7 +983,7 @@ static void assignment(LexState *ls, struct LHS_assign *lh, int nvars) {
         primaryexp(ls, &nv.v);
         if (nv.v.k == VLOCAL)
             check_conflict(ls, lh, &nv.v);
-        luaY_checklimit(ls->fs, nvars, LUAI_MAXCCALLS - ls->L->nCcalls,
+        luaY_checklimit(ls->fs, nvars, G(ls->L)->maxccalls - ls->L->nCcalls,
                         "variables in assignment");
         assignment(ls, &nv, nvars + 1);
     }
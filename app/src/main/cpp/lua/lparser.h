@@ -98,6 +98,8 @@ typedef struct FuncState {
     /* number of elements in `locvars' */
     lu_byte          nactvar;
     /* number of active local variables */
+    lu_byte          argused;
+    /* is the `arg' parameter (LUA_COMPAT_VARARG) referenced? */
     upvaldesc        upvalues[LUAI_MAXUPVALUES];
     /* upvalues */
     unsigned short   actvar[LUAI_MAXVARS];  /* declared-variable stack */
@@ -35,11 +35,11 @@ typedef struct LG {
 } LG;
 
 
-static void stack_init(lua_State *L1, lua_State *L) {
+static void stack_init(lua_State *L1, lua_State *L, int size_ci) {
     /* initialize CallInfo array */
-    L1->base_ci    = luaM_newvector(L, BASIC_CI_SIZE, CallInfo);
+    L1->base_ci    = luaM_newvector(L, size_ci, CallInfo);
     L1->ci         = L1->base_ci;
-    L1->size_ci    = BASIC_CI_SIZE;
+    L1->size_ci    = size_ci;
     L1->end_ci     = L1->base_ci + L1->size_ci - 1;
     /* initialize stack array */
     L1->stack      = luaM_newvector(L, BASIC_STACK_SIZE + EXTRA_STACK, TValue);
@@ -56,6 +56,7 @@ static void stack_init(lua_State *L1, lua_State *L) {
 
 static void freestack(lua_State *L, lua_State *L1) {
     luaM_freearray(L, L1->base_ci, L1->size_ci, CallInfo);
+    luaF_resizemap(L1, 0);
     luaM_freearray(L, L1->stack, L1->stacksize, TValue);
 }
 
@@ -66,7 +67,7 @@ static void freestack(lua_State *L, lua_State *L1) {
 static void f_luaopen(lua_State *L, void *ud) {
     global_State *g = G(L);
     UNUSED(ud);
-    stack_init(L, L);  /* init stack */
+    stack_init(L, L, MAIN_CI_SIZE);  /* init stack */
     sethvalue(L, gt(L), luaH_new(L, 0, 2));  /* table of globals */
     sethvalue(L, registry(L), luaH_new(L, 0, 2));  /* registry */
     luaS_resize(L, MINSTRTABSIZE);  /* initial size of string table */
@@ -86,13 +87,18 @@ static void preinit_state(lua_State *L, global_State *g) {
     L->hookmask      = 0;
     L->basehookcount = 0;
     L->allowhook     = 1;
+    L->ciovf         = 0;
     resethookcount(L);
     L->openupval = NULL;
+    L->upvalmap  = NULL;
+    L->upvalbits = NULL;
+    L->sizeupvalmap = 0;
     L->size_ci   = 0;
     L->nCcalls   = L->baseCcalls = 0;
     L->status    = 0;
     L->base_ci   = L->ci         = NULL;
     L->savedpc   = NULL;
+    L->park      = NULL;
     L->errfunc   = 0;
     setnilvalue(gt(L));
 }
@@ -104,7 +110,8 @@ static void close_state(lua_State *L) {
     luaC_freeall(L);  /* collect all objects */
     lua_assert(g->rootgc == obj2gco(L));
     lua_assert(g->strt.nuse == 0);
-    luaM_freearray(L, G(L)->strt.hash, G(L)->strt.size, TString *);
+    luaM_freemem(L, G(L)->strt.hash, sizestrtab(G(L)->strt.size));
+    luaM_freemem(L, G(L)->strt.oldhash, sizestrtab(G(L)->strt.oldsize));
     luaZ_freebuffer(L, &g->buff);
     freestack(L, L);
     lua_assert(g->totalbytes == sizeof(LG));
@@ -116,7 +123,7 @@ lua_State *luaE_newthread(lua_State *L) {
     lua_State *L1 = tostate(luaM_malloc(L, state_size(lua_State)));
     luaC_link(L, obj2gco(L1), LUA_TTHREAD);
     preinit_state(L1, G(L));
-    stack_init(L1, L);  /* init stack */
+    stack_init(L1, L, BASIC_CI_SIZE);  /* init stack */
     setobj2n(L, gt(L1), gt(L));  /* share table of globals */
     L1->hookmask      = L->hookmask;
     L1->basehookcount = L->basehookcount;
@@ -159,10 +166,19 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
     g->strt.size       = 0;
     g->strt.nuse       = 0;
     g->strt.hash       = NULL;
+    g->strt.oldhash    = NULL;
+    g->strt.oldsize    = 0;
+    g->strt.migrate    = 0;
+    g->seed            = luai_makeseed(L);
     setnilvalue(registry(L));
     luaZ_initbuffer(L, &g->buff);
     g->panic      = NULL;
+    g->maxccalls  = LUAI_MAXCCALLS;
+    g->maxcalls   = LUAI_MAXCALLS;
     g->gcstate    = GCSpause;
+    g->gckind     = KGC_NORMAL;
+    g->gcgen      = 0;
+    g->gcremark   = 0;
     g->rootgc     = obj2gco(L);
     g->sweepstrgc = 0;
     g->sweepgc    = &g->rootgc;
@@ -173,6 +189,12 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
     g->totalbytes = sizeof(LG);
     g->gcpause    = LUAI_GCPAUSE;
     g->gcstepmul  = LUAI_GCMUL;
+    g->gcmajorinc = LUAI_GCMAJOR;
+    g->gcmajorbase = 0;
+    g->gcbudget   = 0;
+    g->sweeper    = NULL;
+    for (i = 0; i < LUA_GCHISTSIZE; i++) g->gcpausehist[i] = 0;
+    g->gctimed    = 0;
     g->gcdept     = 0;
     for (i = 0; i < NUM_TAGS; i++) g->mt[i] = NULL;
     if (luaD_rawrunprotected(L, f_luaopen, NULL) != 0) {
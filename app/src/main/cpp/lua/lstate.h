@@ -30,6 +30,19 @@ struct lua_longjmp;  /* defined in ldo.c */
 
 #define BASIC_CI_SIZE           8
 
+/* `CallInfo's of the main thread, which the collector leaves in place */
+#define MAIN_CI_SIZE            64
+
+/* `CallInfo's past the call limit, to run the handler of its error */
+#define EXTRA_CI                200
+
+/*
+** largest limits: 9/8 of the C one (the part left for error handling)
+** still fits a 1 MB C stack, the smallest one we run Lua threads on
+*/
+#define MAXCCALLSLIMIT          (2*LUAI_MAXCCALLS)
+#define MAXCALLSLIMIT           (MAX_INT / 2 - EXTRA_CI)
+
 #define BASIC_STACK_SIZE        (2*LUA_MINSTACK)
 
 
@@ -38,6 +51,10 @@ typedef struct stringtable {
     lu_int32 nuse;
     /* number of elements */
     int      size;
+    GCObject **oldhash;
+    /* previous `hash' while the table is being resized (or NULL) */
+    int      oldsize;
+    int      migrate;  /* next bucket of `oldhash' to be moved into `hash' */
 }                   stringtable;
 
 
@@ -70,6 +87,8 @@ typedef struct CallInfo {
 typedef struct global_State {
     stringtable      strt;
     /* hash table for strings */
+    unsigned int     seed;
+    /* randomized seed for string hashes */
     lua_Alloc        frealloc;
     /* function to reallocate memory */
     void             *ud;
@@ -77,6 +96,12 @@ typedef struct global_State {
     lu_byte          currentwhite;
     lu_byte          gcstate;
     /* state of garbage collector */
+    lu_byte          gckind;
+    /* kind of the current collection (KGC_NORMAL or KGC_GEN) */
+    lu_byte          gcgen;
+    /* true if generational mode was selected */
+    lu_byte          gcremark;
+    /* true if `grayagain' was already traversed in this cycle */
     int              sweepstrgc;
     /* position of sweep in `strt' */
     GCObject         *rootgc;
@@ -104,8 +129,24 @@ typedef struct global_State {
     /* size of pause between successive GCs */
     int              gcstepmul;
     /* GC `granularity' */
+    int              gcmajorinc;
+    /* heap growth (%) that triggers a major collection */
+    lu_mem           gcmajorbase;
+    /* memory in use after the last major collection */
+    lu_mem           gcbudget;
+    /* time limit of a GC step in microseconds (0: no limit) */
+    lu_mem           gcpausehist[LUA_GCHISTSIZE];
+    /* number of GC pauses by duration (see `recordpause') */
+    lu_byte          gctimed;
+    /* true if pauses go to `gcpausehist' even without a budget */
+    struct Sweeper   *sweeper;
+    /* background thread freeing swept objects (NULL if none) */
     lua_CFunction    panic;
     /* to be called in unprotected errors */
+    int              maxccalls;
+    /* limit of nested C calls and syntactical levels */
+    int              maxcalls;
+    /* limit of nested calls (`CallInfo's) of each thread */
     TValue           l_registry;
     struct lua_State *mainthread;
     UpVal            uvhead;
@@ -148,6 +189,8 @@ struct lua_State {
     /* nested C calls when resuming coroutine */
     lu_byte            hookmask;
     lu_byte            allowhook;
+    lu_byte            ciovf;
+    /* true from a `CallInfo' overflow until its error is handled */
     int                basehookcount;
     int                hookcount;
     lua_Hook           hook;
@@ -157,7 +200,15 @@ struct lua_State {
     /* temporary place for environments */
     GCObject           *openupval;
     /* list of open upvalues in this stack */
+    struct UpVal       **upvalmap;
+    /* open upvalue of each stack slot, or NULL (`sizeupvalmap' entries) */
+    lu_int32           *upvalbits;
+    /* bit i set if slot i has an open upvalue (same block as the map) */
+    int                sizeupvalmap;
+    /* never less than `stacksize' once the map exists */
     GCObject           *gclist;
+    void               *park;
+    /* while not NULL, only the owner of this key resumes the thread */
     struct lua_longjmp *errorJmp;
     /* current error recover point */
     ptrdiff_t          errfunc;  /* current error handling function (stack index) */
@@ -18,38 +18,207 @@
 #include "lstring.h"
 
 
+#define rotl32(x, n)    (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define mixblock(h, k) { \
+    k *= 0xcc9e2d51u; k = rotl32(k, 15); k *= 0x1b873593u; h ^= k; }
+
+
+/*
+** Murmur3-style hashing of 4-byte blocks. The result depends on the byte
+** order of the machine, which is fine as hashes are never stored.
+*/
+static lu_int32 hashbytes(lu_int32 h, const char *str, size_t l) {
+    lu_int32 k;
+    for (; l >= 4; str += 4, l -= 4) {
+        memcpy(&k, str, 4);
+        mixblock(h, k);
+        h = rotl32(h, 13);
+        h = h * 5 + 0xe6546b64u;
+    }
+    k = 0;
+    switch (l) {  /* remaining bytes */
+        case 3:
+            k ^= cast(lu_int32, cast(unsigned char, str[2])) << 16;
+            /* FALLTHROUGH */
+        case 2:
+            k ^= cast(lu_int32, cast(unsigned char, str[1])) << 8;
+            /* FALLTHROUGH */
+        case 1:
+            k ^= cast(lu_int32, cast(unsigned char, str[0]));
+            mixblock(h, k);
+    }
+    return h;
+}
+
+
+unsigned int luaS_hash(const char *str, size_t l, unsigned int seed) {
+    lu_int32 h = cast(lu_int32, seed ^ cast(unsigned int, l));
+    if (l <= LUAI_HASHLIMIT)
+        h = hashbytes(h, str, l);
+    else {  /* hash both ends in full and sample the middle */
+        size_t half = LUAI_HASHLIMIT / 2;
+        size_t step = ((l - 2 * half) >> 6) + 4;  /* at most 64 samples */
+        size_t i;
+        h = hashbytes(h, str, half);
+        for (i = half; i + 4 <= l - half; i += step)
+            h = hashbytes(h, str + i, 4);
+        h = hashbytes(h, str + l - half, half);
+    }
+    /* final avalanche */
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return cast(unsigned int, h);
+}
+
+
+/*
+** While the table is being resized, a string lives in its bucket of
+** `oldhash' until that bucket is migrated, and in `hash' afterwards.
+** Returns the number of the bucket, as in `luaS_bucket'.
+*/
+static int bucket(stringtable *tb, unsigned int h) {
+    if (tb->oldhash != NULL) {
+        int h1 = lmod(h, tb->oldsize);
+        if (h1 >= tb->migrate)  /* not migrated yet? */
+            return h1;
+    }
+    return tb->oldsize + lmod(h, tb->size);
+}
+
+
+/* young bits of a table of `n' buckets at `h' */
+#define youngbits(h, n)    cast(lu_int32 *, (h) + (n))
+#define bitmask32(i)       (cast(lu_int32, 1) << ((i) & 31))
+
+
+void luaS_setyoung(stringtable *tb, int i, int young) {
+    lu_int32 *bits;
+    if (i < tb->oldsize)
+        bits = youngbits(tb->oldhash, tb->oldsize);
+    else {
+        i -= tb->oldsize;
+        bits = youngbits(tb->hash, tb->size);
+    }
+    if (young)
+        bits[i >> 5] |= bitmask32(i);
+    else
+        bits[i >> 5] &= ~bitmask32(i);
+}
+
+
+/* every bucket may hold young strings (all of them are swept next) */
+void luaS_allyoung(stringtable *tb) {
+    int i;
+    for (i = 0; i < youngwords(tb->oldsize); i++)
+        youngbits(tb->oldhash, tb->oldsize)[i] = ~cast(lu_int32, 0);
+    for (i = 0; i < youngwords(tb->size); i++)
+        youngbits(tb->hash, tb->size)[i] = ~cast(lu_int32, 0);
+}
+
+
+/* first bucket from `i' on with its young bit set in a table of `n' */
+static int firstyoung(GCObject **h, int n, int i) {
+    lu_int32 *bits = youngbits(h, n);
+    int      w     = i >> 5;
+    lu_int32 b;
+    if (i >= n)
+        return n;
+    b = bits[w] & ~(bitmask32(i) - 1);  /* buckets >= i */
+    while (b == 0) {
+        if (++w >= youngwords(n))
+            return n;
+        b = bits[w];
+    }
+    i = (w << 5) + luaO_log2(b & (~b + 1));  /* lowest bit */
+    return (i < n) ? i : n;
+}
+
+
+/*
+** The first bucket from `i' on (numbered as in `luaS_bucket') that may
+** hold young strings, or `luaS_nbuckets' if there is none; it skips 32
+** buckets at a time, so a minor collection does not pay for every one.
+*/
+int luaS_nextyoung(stringtable *tb, int i) {
+    if (i < tb->oldsize) {
+        i = firstyoung(tb->oldhash, tb->oldsize, i);
+        if (i < tb->oldsize)
+            return i;
+    }
+    return tb->oldsize + firstyoung(tb->hash, tb->size, i - tb->oldsize);
+}
+
+
+/*
+** move up to `n' buckets of the old table to the new one; frees the old
+** table once it is empty
+*/
+static void migrate(lua_State *L, int n) {
+    stringtable *tb = &G(L)->strt;
+    if (G(L)->gcstate == GCSsweepstring)
+        return;  /* cannot move strings during GC traverse */
+    for (; n > 0 && tb->migrate < tb->oldsize; n--) {
+        GCObject *p = tb->oldhash[tb->migrate];
+        tb->oldhash[tb->migrate++] = NULL;
+        while (p) {  /* for each node in the list */
+            GCObject     *next = p->gch.next;  /* save next */
+            unsigned int h     = gco2ts(p)->hash;
+            int          h1    = lmod(h, tb->size);  /* new position */
+            lua_assert(cast_int(h % tb->size) == lmod(h, tb->size));
+            p->gch.next = tb->hash[h1];  /* chain it */
+            tb->hash[h1] = p;
+            if (!isold(p))
+                youngbits(tb->hash, tb->size)[h1 >> 5] |= bitmask32(h1);
+            p = next;
+        }
+    }
+    if (tb->oldhash != NULL && tb->migrate >= tb->oldsize) {  /* done? */
+        luaM_freemem(L, tb->oldhash, sizestrtab(tb->oldsize));
+        tb->oldhash = NULL;
+        tb->oldsize = 0;
+        tb->migrate = 0;
+    }
+}
+
+
+/*
+** Start a resize of the string table. When growing, the strings are
+** moved to the new table incrementally, LUAI_STRMIGRATE buckets per new
+** string, instead of in a single pass. Shrinking (done by the collector
+** on a mostly empty table) still completes at once.
+*/
 void luaS_resize(lua_State *L, int newsize) {
     GCObject    **newhash;
     stringtable *tb;
     int         i;
     if (G(L)->gcstate == GCSsweepstring)
         return;  /* cannot resize during GC traverse */
-    newhash = luaM_newvector(L, newsize, GCObject *);
-    tb      = &G(L)->strt;
+    tb = &G(L)->strt;
+    migrate(L, MAX_INT);  /* finish any previous resize */
+    if (cast(size_t, newsize) >= MAX_SIZET / sizestrtab(1))
+        luaM_toobig(L);
+    newhash = cast(GCObject **, luaM_malloc(L, sizestrtab(newsize)));
     for (i = 0; i < newsize; i++) newhash[i] = NULL;
-    /* rehash */
-    for (i = 0; i < tb->size; i++) {
-        GCObject *p = tb->hash[i];
-        while (p) {  /* for each node in the list */
-            GCObject     *next = p->gch.next;  /* save next */
-            unsigned int h     = gco2ts(p)->hash;
-            int          h1    = lmod(h, newsize);  /* new position */
-            lua_assert(cast_int(h % newsize) == lmod(h, newsize));
-            p->gch.next = newhash[h1];  /* chain it */
-            newhash[h1] = p;
-            p = next;
-        }
+    for (i = 0; i < youngwords(newsize); i++) youngbits(newhash, newsize)[i] = 0;
+    if (tb->size > 0) {
+        tb->oldhash = tb->hash;
+        tb->oldsize = tb->size;
+        tb->migrate = 0;
     }
-    luaM_freearray(L, tb->hash, tb->size, TString *);
     tb->size = newsize;
     tb->hash = newhash;
+    if (newsize < tb->oldsize)
+        migrate(L, MAX_INT);
 }
 
 
-static TString *newlstr(lua_State *L, const char *str, size_t l,
-                        unsigned int h) {
-    TString     *ts;
-    stringtable *tb;
+static TString *createstr(lua_State *L, const char *str, size_t l,
+                          unsigned int h) {
+    TString *ts;
     if (l + 1 > (MAX_SIZET - sizeof(TString)) / sizeof(char))
         luaM_toobig(L);
     ts = cast(TString *, luaM_malloc(L, (l + 1) * sizeof(char) + sizeof(TString)));
@@ -58,37 +227,81 @@ static TString *newlstr(lua_State *L, const char *str, size_t l,
     ts->tsv.marked   = luaC_white(G(L));
     ts->tsv.tt       = LUA_TSTRING;
     ts->tsv.reserved = 0;
+    ts->tsv.hashed   = 1;
     memcpy(ts + 1, str, l * sizeof(char));
     ((char *) (ts + 1))[l] = '\0';  /* ending 0 */
-    tb = &G(L)->strt;
-    h  = lmod(h, tb->size);
-    ts->tsv.next = tb->hash[h];  /* chain new entry */
-    tb->hash[h] = obj2gco(ts);
+    return ts;
+}
+
+
+static TString *newlstr(lua_State *L, const char *str, size_t l,
+                        unsigned int h, int i) {
+    TString     *ts   = createstr(L, str, l, h);
+    stringtable *tb   = &G(L)->strt;
+    GCObject    **list = luaS_bucket(tb, i);
+    ts->tsv.next = *list;  /* chain new entry */
+    *list = obj2gco(ts);
+    luaS_setyoung(tb, i, 1);
     tb->nuse++;
-    if (tb->nuse > cast(lu_int32, tb->size) && tb->size <= MAX_INT / 2)
+    if (tb->oldhash != NULL)
+        migrate(L, LUAI_STRMIGRATE);  /* keep moving the old table */
+    else if (tb->nuse > cast(lu_int32, tb->size) && tb->size <= MAX_INT / 2)
         luaS_resize(L, tb->size * 2);  /* too crowded */
     return ts;
 }
 
 
+/*
+** Long strings skip the string table and live in the `rootgc' list like
+** any other object. Their `hash' holds the seed until they are hashed.
+*/
+static TString *newlngstr(lua_State *L, const char *str, size_t l) {
+    TString *ts = createstr(L, str, l, G(L)->seed);
+    ts->tsv.hashed = 0;
+    luaC_link(L, obj2gco(ts), LUA_TSTRING);
+    return ts;
+}
+
+
+unsigned int luaS_hashlongstr(TString *ts) {
+    lua_assert(luaS_islong(ts));
+    if (!ts->tsv.hashed) {
+        ts->tsv.hash   = luaS_hash(getstr(ts), ts->tsv.len, ts->tsv.hash);
+        ts->tsv.hashed = 1;
+    }
+    return ts->tsv.hash;
+}
+
+
+int luaS_eqlngstr(TString *a, TString *b) {
+    size_t len = a->tsv.len;
+    lua_assert(luaS_islong(a));
+    return (a == b) ||  /* same instance or... */
+           ((len == b->tsv.len) &&  /* equal length and ... */
+            (!a->tsv.hashed || !b->tsv.hashed ||
+             a->tsv.hash == b->tsv.hash) &&  /* no hash mismatch and ... */
+            (memcmp(getstr(a), getstr(b), len) == 0));  /* equal contents */
+}
+
+
 TString *luaS_newlstr(lua_State *L, const char *str, size_t l) {
     GCObject     *o;
-    unsigned int h    = cast(unsigned int, l);  /* seed */
-    size_t       step = (l >> 5) + 1;  /* if string is too long, don't hash all its chars */
-    size_t       l1;
-    for (l1 = l; l1 >= step; l1 -= step)  /* compute hash */
-        h  = h ^ ((h << 5) + (h >> 2) + cast(unsigned char, str[l1 - 1]));
-    for (o = G(L)->strt.hash[lmod(h, G(L)->strt.size)];
-         o != NULL;
-         o = o->gch.next) {
+    unsigned int h;
+    int          i;
+    if (l > LUAI_MAXSHORTLEN)
+        return newlngstr(L, str, l);  /* long strings are not interned */
+    h = luaS_hash(str, l, G(L)->seed);
+    i = bucket(&G(L)->strt, h);
+    for (o = *luaS_bucket(&G(L)->strt, i); o != NULL; o = o->gch.next) {
         TString *ts = rawgco2ts(o);
-        if (ts->tsv.len == l && (memcmp(str, getstr(ts), l) == 0)) {
+        if (ts->tsv.hash == h && ts->tsv.len == l &&
+            (memcmp(str, getstr(ts), l) == 0)) {
             /* string may be dead */
             if (isdead(G(L), o)) changewhite(o);
             return ts;
         }
     }
-    return newlstr(L, str, l, h);  /* not found */
+    return newlstr(L, str, l, h, i);  /* not found */
 }
 
 
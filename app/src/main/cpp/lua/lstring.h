@@ -23,7 +23,39 @@
 
 #define luaS_fix(s)	l_setbit((s)->tsv.marked, FIXEDBIT)
 
+/* long strings are not interned, so they must be compared by contents */
+#define luaS_islong(ts)	((ts)->tsv.len > LUAI_MAXSHORTLEN)
+#define luaS_eqstr(a,b)	((a) == (b) || \
+                         (luaS_islong(a) && luaS_eqlngstr(a, b)))
+
+#define luaS_strhash(ts)	((ts)->tsv.hashed ? (ts)->tsv.hash : \
+                                 luaS_hashlongstr(ts))
+
+/*
+** buckets of a string table, including those of a table that is still
+** being migrated by an incremental resize (old buckets come first)
+*/
+#define luaS_nbuckets(tb)	((tb)->oldsize + (tb)->size)
+#define luaS_bucket(tb,i)	((i) < (tb)->oldsize ? &(tb)->oldhash[i] : \
+                                 &(tb)->hash[(i) - (tb)->oldsize])
+
+/*
+** The young bits of a string table sit in the same block, right after
+** its buckets: bit `i' is set while bucket `i' may hold strings that are
+** not old, which are the only buckets a minor collection sweeps
+*/
+#define youngwords(n)	(((n) + 31) >> 5)
+#define sizestrtab(n)	(cast(size_t, n) * sizeof(GCObject *) + \
+                         cast(size_t, youngwords(n)) * sizeof(lu_int32))
+
+LUAI_FUNC unsigned int luaS_hash (const char *str, size_t l,
+                                  unsigned int seed);
+LUAI_FUNC unsigned int luaS_hashlongstr (TString *ts);
+LUAI_FUNC int luaS_eqlngstr (TString *a, TString *b);
 LUAI_FUNC void luaS_resize (lua_State *L, int newsize);
+LUAI_FUNC void luaS_setyoung (stringtable *tb, int i, int young);
+LUAI_FUNC void luaS_allyoung (stringtable *tb);
+LUAI_FUNC int luaS_nextyoung (stringtable *tb, int i);
 LUAI_FUNC Udata *luaS_newudata (lua_State *L, size_t s, Table *e);
 LUAI_FUNC TString *luaS_newlstr (lua_State *L, const char *str, size_t l);
 
@@ -6,9 +6,11 @@
 
 
 #include <ctype.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define lstrlib_c
 #define LUA_LIB
@@ -94,9 +96,21 @@ static int str_rep(lua_State *L) {
     luaL_Buffer b;
     const char  *s = luaL_checklstring(L, 1, &l);
     int         n  = luaL_checkint(L, 2);
-    luaL_buffinit(L, &b);
-    while (n-- > 0)
-        luaL_addlstring(&b, s, l);
+    size_t      total, done;
+    char        *p;
+    if (n <= 0 || l == 0) {
+        lua_pushliteral(L, "");
+        return 1;
+    }
+    if (l > ~(size_t) 0 / (size_t) n)
+        return luaL_error(L, "resulting string too large");
+    total = l * (size_t) n;
+    luaL_buffinitheap(L, &b);
+    p = luaL_prepbuffsize(&b, total);  /* the whole result at once */
+    memcpy(p, s, l);
+    for (done = l; done < total; done *= 2)  /* double what is there */
+        memcpy(p + done, p, (total - done < done) ? total - done : done);
+    luaL_addsize(&b, total);
     luaL_pushresult(&b);
     return 1;
 }
@@ -172,6 +186,8 @@ typedef struct MatchState {
     const char *src_end;
     /* end (`\0') of source string */
     lua_State  *L;
+    const struct PItem *code;
+    /* compiled pattern, or NULL to interpret the source */
     int        level;
     /* total number of captures (finished or unfinished) */
     struct {
@@ -201,18 +217,17 @@ static int capture_to_close(MatchState *ms) {
 }
 
 
-static const char *classend(MatchState *ms, const char *p) {
+/* end of the single char class at `p', or NULL if it is malformed */
+static const char *classlimit(const char *p) {
     switch (*p++) {
         case L_ESC: {
-            if (*p == '\0')
-                luaL_error(ms->L, "malformed pattern (ends with " LUA_QL("%%") ")");
+            if (*p == '\0') return NULL;
             return p + 1;
         }
         case '[': {
             if (*p == '^') p++;
             do {  /* look for a `]' */
-                if (*p == '\0')
-                    luaL_error(ms->L, "malformed pattern (missing " LUA_QL("]") ")");
+                if (*p == '\0') return NULL;
                 if (*(p++) == L_ESC && *p != '\0')
                     p++;  /* skip escapes (e.g. `%]') */
             } while (*p != ']');
@@ -225,6 +240,18 @@ static const char *classend(MatchState *ms, const char *p) {
 }
 
 
+static const char *classend(MatchState *ms, const char *p) {
+    const char *ep = classlimit(p);
+    if (ep == NULL) {
+        if (*p == L_ESC)
+            luaL_error(ms->L, "malformed pattern (ends with " LUA_QL("%%") ")");
+        else
+            luaL_error(ms->L, "malformed pattern (missing " LUA_QL("]") ")");
+    }
+    return ep;
+}
+
+
 static int match_class(int c, int cl) {
     int res;
     switch (tolower(cl)) {
@@ -477,28 +504,640 @@ static const char *match(MatchState *ms, const char *s, const char *p) {
 }
 
 
-static const char *lmemfind(const char *s1, size_t l1,
-                            const char *s2, size_t l2) {
-    if (l2 == 0) return s1;  /* empty strings are everywhere */
-    else if (l2 > l1) return NULL;  /* avoids a negative `l1' */
+/*
+** {======================================================
+** Compiled patterns
+** A pattern is parsed once into an array of items (single char classes
+** with their repetition, captures, anchors, `%b', `%f' and back
+** references); `cmatch' then walks that array with the same backtracking
+** as `match', so results and errors are those of the interpreter. Char
+** sets that do not depend on the locale become bitmaps. Patterns that are
+** malformed are left to the interpreter, which reports the error only
+** when the match reaches it. Each state keeps the last LUA_PATCACHE
+** compiled patterns, keyed by the address of the pattern string. A
+** subject shorter than MINCOMPILE chars goes to the interpreter without
+** looking at the cache: it is as fast there, and compiling costs more
+** than such a match when many patterns keep evicting each other.
+** =======================================================
+*/
+
+#define PI_SINGLE    0  /* one char class with an optional repetition */
+#define PI_OPEN      1  /* `(' */
+#define PI_POSITION  2  /* `()' */
+#define PI_CLOSE     3  /* `)' */
+#define PI_BALANCE   4  /* `%bxy' */
+#define PI_FRONTIER  5  /* `%f[set]' */
+#define PI_BACKREF   6  /* `%1' .. `%9' (and the invalid `%0') */
+#define PI_EOS       7  /* `$' at the end of the pattern */
+#define PI_END       8  /* end of pattern */
+
+#define PK_CHAR      0  /* a plain char */
+#define PK_ANY       1  /* `.' */
+#define PK_CLASS     2  /* `%a' and friends (locale dependent) */
+#define PK_SET       3  /* a bracket class as a bitmap */
+#define PK_SETX      4  /* a bracket class with `%a' and friends */
+
+typedef struct PItem {
+    unsigned char op;
+    /* PI_xxx */
+    unsigned char kind;
+    /* how a char is matched (PK_xxx), for PI_SINGLE and PI_FRONTIER */
+    unsigned char quant;
+    /* repetition of a PI_SINGLE: `?', `*', `+', `-' or 0 */
+    unsigned char c;
+    /* char of PK_CHAR, class of PK_CLASS or index of PI_BACKREF */
+    const char    *p;
+    /* bracket class of PK_SETX or arguments of PI_BALANCE */
+    const char    *ep;
+    /* last char (the `]') of a PK_SETX bracket class */
+    unsigned char set[32];
+    /* bitmap of PK_SET */
+} PItem;
+
+typedef struct Pattern {
+    size_t     len;
+    /* length of the source */
+    const char *src;
+    /* copy of the source (after the items); PItem's point into it */
+    int        lead;
+    /* index of the item every match starts with a char of, or -1 */
+    PItem      code[1];
+} Pattern;
+
+typedef struct PatCache {
+    struct {
+        const char *key;
+        /* address of the pattern string */
+        Pattern    *pat;
+        unsigned   used;
+        /* clock of the last use */
+    }        entry[LUA_PATCACHE];
+    unsigned clock;
+} PatCache;
+
+
+static const char patcachekey = 'p';
+
+#define MINCOMPILE   128
+
+
+static int isclassletter(int cl) {
+    switch (tolower(cl)) {
+        case 'a': case 'c': case 'd': case 'l': case 'p':
+        case 's': case 'u': case 'w': case 'x': case 'z':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+
+static void compileset(PItem *it, const char *p, const char *ec) {
+    const char *q;
+    int        c;
+    for (q = p + 1; q < ec; q++) {
+        if (*q == L_ESC && isclassletter(uchar(*++q))) {
+            it->kind = PK_SETX;  /* depends on the locale */
+            it->p    = p;
+            it->ep   = ec;
+            return;
+        }
+    }
+    it->kind = PK_SET;
+    memset(it->set, 0, sizeof(it->set));
+    for (c = 0; c <= UCHAR_MAX; c++) {
+        if (matchbracketclass(c, p, ec))
+            it->set[c >> 3] |= (unsigned char) (1 << (c & 7));
+    }
+}
+
+
+static void compileclass(PItem *it, const char *p, const char *ep) {
+    switch (*p) {
+        case '.': {
+            it->kind = PK_ANY;
+            break;
+        }
+        case L_ESC: {
+            it->kind = isclassletter(uchar(*(p + 1))) ? PK_CLASS : PK_CHAR;
+            it->c    = uchar(*(p + 1));
+            break;
+        }
+        case '[': {
+            compileset(it, p, ep - 1);
+            break;
+        }
+        default: {
+            it->kind = PK_CHAR;
+            it->c    = uchar(*p);
+            break;
+        }
+    }
+}
+
+
+/*
+** Parse `p' the way `match' walks it. Returns the number of items, or -1
+** if `p' is malformed; items are stored only when `code' is not NULL.
+*/
+static int compile(const char *p, PItem *code) {
+    PItem dummy;
+    int   n = 0;
+    for (; ; n++) {
+        PItem *it = (code != NULL) ? &code[n] : &dummy;
+        it->quant = 0;
+        switch (*p) {
+            case '\0': {
+                it->op = PI_END;
+                return n + 1;
+            }
+            case '(': {
+                if (*(p + 1) == ')') {
+                    it->op = PI_POSITION;
+                    p += 2;
+                }
+                else {
+                    it->op = PI_OPEN;
+                    p++;
+                }
+                continue;
+            }
+            case ')': {
+                it->op = PI_CLOSE;
+                p++;
+                continue;
+            }
+            case '$': {
+                if (*(p + 1) == '\0') {
+                    it->op = PI_EOS;
+                    p++;
+                    continue;
+                }
+                break;
+            }
+            case L_ESC: {
+                if (*(p + 1) == 'b') {
+                    if (*(p + 2) == '\0' || *(p + 3) == '\0') return -1;
+                    it->op = PI_BALANCE;
+                    it->p  = p + 2;
+                    p += 4;
+                    continue;
+                }
+                else if (*(p + 1) == 'f') {
+                    const char *ep;
+                    p += 2;
+                    if (*p != '[' || (ep = classlimit(p)) == NULL) return -1;
+                    it->op = PI_FRONTIER;
+                    compileset(it, p, ep - 1);
+                    p = ep;
+                    continue;
+                }
+                else if (isdigit(uchar(*(p + 1)))) {
+                    it->op = PI_BACKREF;
+                    it->c  = uchar(*(p + 1));
+                    p += 2;
+                    continue;
+                }
+                break;
+            }
+        }
+        {  /* it is a pattern item */
+            const char *ep = classlimit(p);
+            if (ep == NULL) return -1;
+            it->op = PI_SINGLE;
+            compileclass(it, p, ep);
+            switch (*ep) {
+                case '?':
+                case '*':
+                case '+':
+                case '-': {
+                    it->quant = uchar(*ep);
+                    ep++;
+                    break;
+                }
+            }
+            p = ep;
+        }
+    }
+}
+
+
+static int csingle(const PItem *it, int c) {
+    switch (it->kind) {
+        case PK_CHAR:
+            return (it->c == c);
+        case PK_ANY:
+            return 1;
+        case PK_CLASS:
+            return match_class(c, it->c);
+        case PK_SET:
+            return (it->set[c >> 3] >> (c & 7)) & 1;
+        default:
+            return matchbracketclass(c, it->p, it->ep);
+    }
+}
+
+
+static const char *cmatch(MatchState *ms, const char *s, const PItem *it);
+
+
+static const char *cmax_expand(MatchState *ms, const char *s,
+                               const PItem *it) {
+    ptrdiff_t i = 0;  /* counts maximum expand for item */
+    if (it->kind == PK_ANY)
+        i = ms->src_end - s;
     else {
-        const char *init;  /* to search for a `*s2' inside `s1' */
-        l2--;  /* 1st char will be checked by `memchr' */
-        l1 = l1 - l2;  /* `s2' cannot be found after that */
-        while (l1 > 0 && (init = (const char *) memchr(s1, *s2, l1)) != NULL) {
-            init++;   /* 1st char is already checked */
-            if (memcmp(init, s2 + 1, l2) == 0)
-                return init - 1;
-            else {  /* correct `l1' and `s1' to try again */
-                l1 -= init - s1;
-                s1 = init;
+        while ((s + i) < ms->src_end && csingle(it, uchar(*(s + i))))
+            i++;
+    }
+    /* keeps trying to match with the maximum repetitions */
+    while (i >= 0) {
+        const char *res = cmatch(ms, (s + i), it + 1);
+        if (res) return res;
+        i--;  /* else didn't match; reduce 1 repetition to try again */
+    }
+    return NULL;
+}
+
+
+static const char *cmin_expand(MatchState *ms, const char *s,
+                               const PItem *it) {
+    for (; ;) {
+        const char *res = cmatch(ms, s, it + 1);
+        if (res != NULL)
+            return res;
+        else if (s < ms->src_end && csingle(it, uchar(*s)))
+            s++;  /* try with one more repetition */
+        else return NULL;
+    }
+}
+
+
+static const char *cstart_capture(MatchState *ms, const char *s,
+                                  const PItem *it, int what) {
+    const char *res;
+    int        level = ms->level;
+    if (level >= LUA_MAXCAPTURES) luaL_error(ms->L, "too many captures");
+    ms->capture[level].init = s;
+    ms->capture[level].len  = what;
+    ms->level               = level + 1;
+    if ((res = cmatch(ms, s, it)) == NULL)  /* match failed? */
+        ms->level--;  /* undo capture */
+    return res;
+}
+
+
+static const char *cend_capture(MatchState *ms, const char *s,
+                                const PItem *it) {
+    int        l = capture_to_close(ms);
+    const char *res;
+    ms->capture[l].len = s - ms->capture[l].init;  /* close capture */
+    if ((res = cmatch(ms, s, it)) == NULL)  /* match failed? */
+        ms->capture[l].len = CAP_UNFINISHED;  /* undo capture */
+    return res;
+}
+
+
+static const char *cmatch(MatchState *ms, const char *s, const PItem *it) {
+    init: /* using goto's to optimize tail recursion */
+    switch (it->op) {
+        case PI_SINGLE: {
+            int m = s < ms->src_end && csingle(it, uchar(*s));
+            switch (it->quant) {
+                case '?': {  /* optional */
+                    const char *res;
+                    if (m && ((res = cmatch(ms, s + 1, it + 1)) != NULL))
+                        return res;
+                    it++;
+                    goto init;
+                }
+                case '*': {  /* 0 or more repetitions */
+                    return cmax_expand(ms, s, it);
+                }
+                case '+': {  /* 1 or more repetitions */
+                    return (m ? cmax_expand(ms, s + 1, it) : NULL);
+                }
+                case '-': {  /* 0 or more repetitions (minimum) */
+                    return cmin_expand(ms, s, it);
+                }
+                default: {
+                    if (!m) return NULL;
+                    s++;
+                    it++;
+                    goto init;
+                }
             }
         }
-        return NULL;  /* not found */
+        case PI_OPEN: {
+            return cstart_capture(ms, s, it + 1, CAP_UNFINISHED);
+        }
+        case PI_POSITION: {
+            return cstart_capture(ms, s, it + 1, CAP_POSITION);
+        }
+        case PI_CLOSE: {
+            return cend_capture(ms, s, it + 1);
+        }
+        case PI_BALANCE: {
+            s = matchbalance(ms, s, it->p);
+            if (s == NULL) return NULL;
+            it++;
+            goto init;
+        }
+        case PI_FRONTIER: {
+            int previous = (s == ms->src_init) ? '\0' : uchar(*(s - 1));
+            if (csingle(it, previous) || !csingle(it, uchar(*s)))
+                return NULL;
+            it++;
+            goto init;
+        }
+        case PI_BACKREF: {
+            s = match_capture(ms, s, it->c);
+            if (s == NULL) return NULL;
+            it++;
+            goto init;
+        }
+        case PI_EOS: {
+            return (s == ms->src_end) ? s : NULL;  /* check end of string */
+        }
+        default: {  /* end of pattern */
+            return s;  /* match succeeded */
+        }
     }
 }
 
 
+/*
+** First position from `s' on where a match can start, or NULL if there is
+** none; only for patterns with a `lead' item.
+*/
+static const char *cskip(MatchState *ms, const char *s, const PItem *it) {
+    if (it->kind == PK_CHAR)
+        return (const char *) memchr(s, it->c, ms->src_end - s);
+    while (s < ms->src_end && !csingle(it, uchar(*s)))
+        s++;
+    return (s < ms->src_end) ? s : NULL;
+}
+
+
+static PatCache *newpatcache(lua_State *L) {
+    PatCache *pc = (PatCache *) lua_newuserdata(L, sizeof(PatCache));
+    memset(pc, 0, sizeof(PatCache));
+    lua_createtable(L, LUA_PATCACHE, 0);  /* keeps the compiled patterns */
+    lua_setfenv(L, -2);
+    lua_pushlightuserdata(L, (void *) &patcachekey);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+    return pc;
+}
+
+
+static Pattern *newpattern(lua_State *L, const char *p, size_t lp, int n) {
+    Pattern *pat = (Pattern *) lua_newuserdata(L, sizeof(Pattern) +
+                                                  (n - 1) * sizeof(PItem) + lp + 1);
+    char    *src = (char *) &pat->code[n];
+    int     i;
+    memcpy(src, p, lp + 1);
+    pat->len  = lp;
+    pat->src  = src;
+    pat->lead = -1;
+    compile(src, pat->code);
+    for (i = 0; pat->code[i].op == PI_OPEN || pat->code[i].op == PI_POSITION; i++);
+    if (pat->code[i].op == PI_SINGLE &&
+        (pat->code[i].quant == 0 || pat->code[i].quant == '+'))
+        pat->lead = i;  /* every match starts with a char of this item */
+    return pat;
+}
+
+
+/*
+** Compiled form of pattern `p' (with length `lp') for a subject of `ls'
+** chars, or NULL if it must be interpreted. When `keep' is set the pattern
+** is also pushed (or nil), so that it survives being evicted while in use.
+*/
+static const Pattern *getpattern(lua_State *L, const char *p, size_t lp,
+                                 size_t ls, int keep) {
+    PatCache *pc;
+    Pattern  *pat;
+    int      i, n;
+    int      victim = 0;
+    if (ls < MINCOMPILE) {
+        if (keep) lua_pushnil(L);
+        return NULL;
+    }
+    lua_pushlightuserdata(L, (void *) &patcachekey);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    pc = (PatCache *) lua_touserdata(L, -1);
+    if (pc == NULL) {
+        lua_pop(L, 1);
+        pc = newpatcache(L);
+    }
+    for (i = 0; i < LUA_PATCACHE; i++) {
+        pat = pc->entry[i].pat;
+        if (pc->entry[i].key == p && pat->len == lp &&
+            memcmp(pat->src, p, lp) == 0) {
+            pc->entry[i].used = ++pc->clock;
+            if (keep) {
+                lua_getfenv(L, -1);
+                lua_rawgeti(L, -1, i + 1);
+                lua_replace(L, -3);
+                lua_pop(L, 1);
+            }
+            else lua_pop(L, 1);
+            return pat;
+        }
+    }
+    n = compile(p, NULL);
+    if (n < 0) {  /* malformed; let `match' report it (if it gets there) */
+        lua_pop(L, 1);
+        if (keep) lua_pushnil(L);
+        return NULL;
+    }
+    for (i = 1; i < LUA_PATCACHE; i++) {  /* evict the least recently used */
+        if (pc->entry[i].used < pc->entry[victim].used)
+            victim = i;
+    }
+    lua_getfenv(L, -1);
+    pat = newpattern(L, p, lp, n);
+    lua_pushvalue(L, -1);
+    lua_rawseti(L, -3, victim + 1);  /* replaces the evicted one */
+    pc->entry[victim].key  = p;
+    pc->entry[victim].pat  = pat;
+    pc->entry[victim].used = ++pc->clock;
+    if (keep) {
+        lua_replace(L, -3);
+        lua_pop(L, 1);
+    }
+    else lua_pop(L, 3);
+    return pat;
+}
+
+
+#define domatch(ms, s, p) \
+    ((ms)->code ? cmatch(ms, s, (ms)->code) : match(ms, s, p))
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Plain substring search
+** For needles of 2 or more bytes, a block of the subject is compared at
+** once with the first byte of the needle and the block `l2 - 1' bytes
+** ahead with its last byte (SSE2 or AVX2 on x86, NEON on ARM); only the
+** positions where both match are checked with `memcmp'. AVX2 is used
+** when the running CPU has it.
+** =======================================================
+*/
+
+#if defined(__GNUC__) && (defined(__SSE2__) || defined(__x86_64__))
+#include <emmintrin.h>
+#define MEMFIND_SSE2
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MEMFIND_AVX2
+#endif
+#elif defined(__GNUC__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define MEMFIND_NEON
+#endif
+
+
+/* `memchr' for the first byte, then `memcmp' for the rest */
+static const char *memfind_scalar(const char *s1, size_t l1,
+                                  const char *s2, size_t l2) {
+    const char *init;  /* to search for a `*s2' inside `s1' */
+    l2--;  /* 1st char will be checked by `memchr' */
+    l1 = l1 - l2;  /* `s2' cannot be found after that */
+    while (l1 > 0 && (init = (const char *) memchr(s1, *s2, l1)) != NULL) {
+        init++;   /* 1st char is already checked */
+        if (memcmp(init, s2 + 1, l2) == 0)
+            return init - 1;
+        else {  /* correct `l1' and `s1' to try again */
+            l1 -= init - s1;
+            s1 = init;
+        }
+    }
+    return NULL;  /* not found */
+}
+
+
+#if defined(MEMFIND_SSE2)
+
+static const char *memfind_sse2(const char *s1, size_t l1,
+                                const char *s2, size_t l2) {
+    const __m128i first = _mm_set1_epi8(s2[0]);
+    const __m128i last  = _mm_set1_epi8(s2[l2 - 1]);
+    size_t        n     = l1 - l2 + 1;  /* number of possible positions */
+    size_t        i;
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i      bf   = _mm_loadu_si128((const __m128i *) (s1 + i));
+        __m128i      bl   = _mm_loadu_si128((const __m128i *) (s1 + i + l2 - 1));
+        unsigned int mask = _mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(bf, first), _mm_cmpeq_epi8(bl, last)));
+        while (mask != 0) {
+            size_t k = i + __builtin_ctz(mask);
+            if (memcmp(s1 + k + 1, s2 + 1, l2 - 2) == 0)
+                return s1 + k;
+            mask &= mask - 1;
+        }
+    }
+    return memfind_scalar(s1 + i, l1 - i, s2, l2);
+}
+
+#endif
+
+
+#if defined(MEMFIND_AVX2)
+
+__attribute__((target("avx2")))
+static const char *memfind_avx2(const char *s1, size_t l1,
+                                const char *s2, size_t l2) {
+    const __m256i first = _mm256_set1_epi8(s2[0]);
+    const __m256i last  = _mm256_set1_epi8(s2[l2 - 1]);
+    size_t        n     = l1 - l2 + 1;  /* number of possible positions */
+    size_t        i;
+    for (i = 0; i + 32 <= n; i += 32) {
+        __m256i      bf   = _mm256_loadu_si256((const __m256i *) (s1 + i));
+        __m256i      bl   = _mm256_loadu_si256((const __m256i *) (s1 + i + l2 - 1));
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(bf, first),
+                                 _mm256_cmpeq_epi8(bl, last)));
+        while (mask != 0) {
+            size_t k = i + __builtin_ctz(mask);
+            if (memcmp(s1 + k + 1, s2 + 1, l2 - 2) == 0)
+                return s1 + k;
+            mask &= mask - 1;
+        }
+    }
+    return memfind_sse2(s1 + i, l1 - i, s2, l2);
+}
+
+#endif
+
+
+#if defined(MEMFIND_NEON)
+
+static const char *memfind_neon(const char *s1, size_t l1,
+                                const char *s2, size_t l2) {
+    const uint8x16_t first = vdupq_n_u8(uchar(s2[0]));
+    const uint8x16_t last  = vdupq_n_u8(uchar(s2[l2 - 1]));
+    size_t           n     = l1 - l2 + 1;  /* number of possible positions */
+    size_t           i;
+    for (i = 0; i + 16 <= n; i += 16) {
+        uint8x16_t bf = vld1q_u8((const uint8_t *) (s1 + i));
+        uint8x16_t bl = vld1q_u8((const uint8_t *) (s1 + i + l2 - 1));
+        uint8x16_t eq = vandq_u8(vceqq_u8(bf, first), vceqq_u8(bl, last));
+        uint64x2_t m  = vreinterpretq_u64_u8(eq);
+        if ((vgetq_lane_u64(m, 0) | vgetq_lane_u64(m, 1)) != 0) {
+            size_t k;
+            for (k = i; k < i + 16; k++) {
+                if (s1[k] == s2[0] && s1[k + l2 - 1] == s2[l2 - 1] &&
+                    memcmp(s1 + k + 1, s2 + 1, l2 - 2) == 0)
+                    return s1 + k;
+            }
+        }
+    }
+    return memfind_scalar(s1 + i, l1 - i, s2, l2);
+}
+
+#endif
+
+
+typedef const char *(*MemFind)(const char *s1, size_t l1,
+                               const char *s2, size_t l2);
+
+
+/* choose the best search for the running CPU (once) */
+static MemFind memfind_select(void) {
+    static MemFind f = NULL;
+    if (f == NULL) {
+#if defined(MEMFIND_AVX2)
+        __builtin_cpu_init();
+        f = __builtin_cpu_supports("avx2") ? memfind_avx2 : memfind_sse2;
+#elif defined(MEMFIND_SSE2)
+        f = memfind_sse2;
+#elif defined(MEMFIND_NEON)
+        f = memfind_neon;
+#else
+        f = memfind_scalar;
+#endif
+    }
+    return f;
+}
+
+
+static const char *lmemfind(const char *s1, size_t l1,
+                            const char *s2, size_t l2) {
+    if (l2 == 0) return s1;  /* empty strings are everywhere */
+    else if (l2 > l1) return NULL;  /* avoids a negative `l1' */
+    else if (l2 == 1) return (const char *) memchr(s1, *s2, l1);
+    else if (l1 < 64) return memfind_scalar(s1, l1, s2, l2);
+    else return (*memfind_select())(s1, l1, s2, l2);
+}
+
+/* }====================================================== */
+
+
 static void push_onecapture(MatchState *ms, int i, const char *s,
                             const char *e) {
     if (i >= ms->level) {
@@ -528,9 +1167,14 @@ static int push_captures(MatchState *ms, const char *s, const char *e) {
 }
 
 
-static int str_find_aux(lua_State *L, int find) {
-    size_t     l1, l2;
-    const char *s   = luaL_checklstring(L, 1, &l1);
+/*
+** `string.find' (or `string.match') over the `l1' bytes at `s', which
+** must be followed by a '\0'; the other arguments are at stack indices
+** 2 to 4, as for those functions.
+*/
+LUALIB_API int luaI_strfind(lua_State *L, const char *s, size_t l1,
+                            int find) {
+    size_t     l2;
     const char *p   = luaL_checklstring(L, 2, &l2);
     ptrdiff_t  init = posrelat(luaL_optinteger(L, 3, 1), l1) - 1;
     if (init < 0) init = 0;
@@ -546,16 +1190,23 @@ static int str_find_aux(lua_State *L, int find) {
         }
     }
     else {
-        MatchState ms;
-        int        anchor = (*p == '^') ? (p++, 1) : 0;
-        const char *s1    = s + init;
+        MatchState    ms;
+        int           anchor = (*p == '^') ? (p++, 1) : 0;
+        const char    *s1    = s + init;
+        const Pattern *pat   = getpattern(L, p, l2 - anchor, l1 - init, 0);
+        const PItem   *lead  = NULL;
         ms.L        = L;
         ms.src_init = s;
         ms.src_end  = s + l1;
+        ms.code     = (pat != NULL) ? pat->code : NULL;
+        if (pat != NULL && pat->lead >= 0 && !anchor)
+            lead = &pat->code[pat->lead];
         do {
             const char *res;
+            if (lead != NULL && (s1 = cskip(&ms, s1, lead)) == NULL)
+                break;  /* no position left where a match can start */
             ms.level = 0;
-            if ((res = match(&ms, s1, p)) != NULL) {
+            if ((res = domatch(&ms, s1, p)) != NULL) {
                 if (find) {
                     lua_pushinteger(L, s1 - s + 1);  /* start */
                     lua_pushinteger(L, res - s);   /* end */
@@ -571,6 +1222,13 @@ static int str_find_aux(lua_State *L, int find) {
 }
 
 
+static int str_find_aux(lua_State *L, int find) {
+    size_t     l;
+    const char *s = luaL_checklstring(L, 1, &l);
+    return luaI_strfind(L, s, l, find);
+}
+
+
 static int str_find(lua_State *L) {
     return str_find_aux(L, 1);
 }
@@ -582,20 +1240,27 @@ static int str_match(lua_State *L) {
 
 
 static int gmatch_aux(lua_State *L) {
-    MatchState ms;
-    size_t     ls;
-    const char *s = lua_tolstring(L, lua_upvalueindex(1), &ls);
-    const char *p = lua_tostring(L, lua_upvalueindex(2));
-    const char *src;
+    MatchState    ms;
+    size_t        ls;
+    const char    *s   = lua_tolstring(L, lua_upvalueindex(1), &ls);
+    const char    *p   = lua_tostring(L, lua_upvalueindex(2));
+    const Pattern *pat = (const Pattern *) lua_touserdata(L, lua_upvalueindex(4));
+    const PItem   *lead = NULL;
+    const char    *src;
     ms.L        = L;
     ms.src_init = s;
     ms.src_end  = s + ls;
+    ms.code     = (pat != NULL) ? pat->code : NULL;
+    if (pat != NULL && pat->lead >= 0)
+        lead = &pat->code[pat->lead];
     for (src = s + (size_t) lua_tointeger(L, lua_upvalueindex(3));
          src <= ms.src_end;
          src++) {
         const char *e;
+        if (lead != NULL && (src = cskip(&ms, src, lead)) == NULL)
+            break;  /* no position left where a match can start */
         ms.level = 0;
-        if ((e = match(&ms, src, p)) != NULL) {
+        if ((e = domatch(&ms, src, p)) != NULL) {
             lua_Integer newstart = e - s;
             if (e == src) newstart++;  /* empty match? go at least one position */
             lua_pushinteger(L, newstart);
@@ -608,11 +1273,14 @@ static int gmatch_aux(lua_State *L) {
 
 
 static int gmatch(lua_State *L) {
-    luaL_checkstring(L, 1);
-    luaL_checkstring(L, 2);
+    size_t     ls, lp;
+    const char *p;
+    luaL_checklstring(L, 1, &ls);
+    p = luaL_checklstring(L, 2, &lp);
     lua_settop(L, 2);
     lua_pushinteger(L, 0);
-    lua_pushcclosure(L, gmatch_aux, 3);
+    getpattern(L, p, lp, ls, 1);  /* compiled pattern (or nil) */
+    lua_pushcclosure(L, gmatch_aux, 4);
     return 1;
 }
 
@@ -678,26 +1346,39 @@ static void add_value(MatchState *ms, luaL_Buffer *b, const char *s,
 
 
 static int str_gsub(lua_State *L) {
-    size_t      srcl;
-    const char  *src   = luaL_checklstring(L, 1, &srcl);
-    const char  *p     = luaL_checkstring(L, 2);
-    int         tr     = lua_type(L, 3);
-    int         max_s  = luaL_optint(L, 4, srcl + 1);
-    int         anchor = (*p == '^') ? (p++, 1) : 0;
-    int         n      = 0;
-    MatchState  ms;
-    luaL_Buffer b;
+    size_t        srcl, lp;
+    const char    *src   = luaL_checklstring(L, 1, &srcl);
+    const char    *p     = luaL_checklstring(L, 2, &lp);
+    int           tr     = lua_type(L, 3);
+    int           max_s  = luaL_optint(L, 4, srcl + 1);
+    int           anchor = (*p == '^') ? (p++, 1) : 0;
+    int           n      = 0;
+    MatchState    ms;
+    luaL_Buffer   b;
+    const Pattern *pat;
+    const PItem   *lead  = NULL;
     luaL_argcheck(L, tr == LUA_TNUMBER || tr == LUA_TSTRING ||
                      tr == LUA_TFUNCTION || tr == LUA_TTABLE, 3,
                   "string/function/table expected");
-    luaL_buffinit(L, &b);
+    /* kept on the stack: a replacement function may evict it */
+    pat = getpattern(L, p, lp - anchor, srcl, 1);
+    luaL_buffinitheap(L, &b);
     ms.L        = L;
     ms.src_init = src;
     ms.src_end  = src + srcl;
+    ms.code     = (pat != NULL) ? pat->code : NULL;
+    if (pat != NULL && pat->lead >= 0 && !anchor)
+        lead = &pat->code[pat->lead];
     while (n < max_s) {
         const char *e;
+        if (lead != NULL) {
+            const char *next = cskip(&ms, src, lead);
+            if (next == NULL) break;  /* no more matches; copy the rest */
+            luaL_addlstring(&b, src, next - src);
+            src = next;
+        }
         ms.level = 0;
-        e = match(&ms, src, p);
+        e = domatch(&ms, src, p);
         if (e) {
             n++;
             add_value(&ms, &b, src, e);
@@ -791,19 +1472,33 @@ static void addintlen(char *form) {
 }
 
 
-static int str_format(lua_State *L) {
+/* `%d' without flags, width or precision, written without `sprintf' */
+static void formatint(char *buff, LUA_INTFRM_T v) {
+    char                   tmp[3 * sizeof(LUA_INTFRM_T) + 2];
+    char                   *p = tmp + sizeof(tmp);
+    unsigned LUA_INTFRM_T u  = (v < 0) ? 0u - (unsigned LUA_INTFRM_T) v
+                                        : (unsigned LUA_INTFRM_T) v;
+    *--p = '\0';
+    do {
+        *--p = (char) ('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (v < 0) *--p = '-';
+    memcpy(buff, p, tmp + sizeof(tmp) - p);
+}
+
+
+/* format the values after `arg' as told by the format string at `arg' */
+static void addformat(lua_State *L, luaL_Buffer *b, int arg) {
     int         top          = lua_gettop(L);
-    int         arg          = 1;
     size_t      sfl;
     const char  *strfrmt     = luaL_checklstring(L, arg, &sfl);
     const char  *strfrmt_end = strfrmt + sfl;
-    luaL_Buffer b;
-    luaL_buffinit(L, &b);
     while (strfrmt < strfrmt_end) {
         if (*strfrmt != L_ESC)
-            luaL_addchar(&b, *strfrmt++);
+            luaL_addchar(b, *strfrmt++);
         else if (*++strfrmt == L_ESC)
-            luaL_addchar(&b, *strfrmt++);  /* %% */
+            luaL_addchar(b, *strfrmt++);  /* %% */
         else { /* format item */
             char form[MAX_FORMAT];  /* to store the format (`%...') */
             char buff[MAX_ITEM];  /* to store the formatted item */
@@ -817,8 +1512,13 @@ static int str_format(lua_State *L) {
                 }
                 case 'd':
                 case 'i': {
-                    addintlen(form);
-                    sprintf(buff, form, (LUA_INTFRM_T) luaL_checknumber(L, arg));
+                    LUA_INTFRM_T v = (LUA_INTFRM_T) luaL_checknumber(L, arg);
+                    if (form[2] == '\0')  /* plain `%d'? */
+                        formatint(buff, v);
+                    else {
+                        addintlen(form);
+                        sprintf(buff, form, v);
+                    }
                     break;
                 }
                 case 'o':
@@ -838,7 +1538,7 @@ static int str_format(lua_State *L) {
                     break;
                 }
                 case 'q': {
-                    addquoted(L, &b, arg);
+                    addquoted(L, b, arg);
                     continue;  /* skip the 'addsize' at the end */
                 }
                 case 's': {
@@ -848,7 +1548,7 @@ static int str_format(lua_State *L) {
                         /* no precision and string is too long to be formatted;
                            keep original string */
                         lua_pushvalue(L, arg);
-                        luaL_addvalue(&b);
+                        luaL_addvalue(b);
                         continue;  /* skip the `addsize' at the end */
                     }
                     else {
@@ -857,19 +1557,185 @@ static int str_format(lua_State *L) {
                     }
                 }
                 default: {  /* also treat cases `pnLlh' */
-                    return luaL_error(L, "invalid option " LUA_QL("%%%c") " to "
+                    luaL_error(L, "invalid option " LUA_QL("%%%c") " to "
                             LUA_QL("format"), *(strfrmt - 1));
                 }
             }
-            luaL_addlstring(&b, buff, strlen(buff));
+            luaL_addlstring(b, buff, strlen(buff));
         }
     }
+}
+
+
+static int str_format(lua_State *L) {
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    addformat(L, &b, 1);
     luaL_pushresult(&b);
     return 1;
 }
 
 
+/*
+** {======================================================
+** String builder
+** A userdata with a growable buffer, so that building a string piece by
+** piece costs amortized O(1) per byte instead of the copy of everything
+** so far that `s = s .. x' does. The buffer is a userdata kept in the
+** builder's environment table, so the collector accounts for its memory.
+** =======================================================
+*/
+
+#define MINBUILDER  64  /* smallest buffer */
+
+typedef struct StrBuilder {
+    char   *buf;
+    /* contents (inside the environment's userdata), or NULL */
+    size_t len;
+    size_t size;
+} StrBuilder;
+
+
+/*
+** The builder at index 1. Methods keep the metatable as their upvalue, so
+** the check needs no lookup of LUA_STRBUILDER in the registry.
+*/
+static StrBuilder *tobuilder(lua_State *L) {
+    StrBuilder *sb = (StrBuilder *) lua_touserdata(L, 1);
+    if (sb == NULL || !lua_getmetatable(L, 1) ||
+        !lua_rawequal(L, -1, lua_upvalueindex(1)))
+        luaL_typerror(L, 1, LUA_STRBUILDER);
+    lua_pop(L, 1);  /* metatable */
+    return sb;
+}
+
+
+/* make room for `l' more bytes in the builder at index 1 */
+static char *builder_reserve(lua_State *L, StrBuilder *sb, size_t l) {
+    if (sb->size - sb->len < l) {
+        size_t newsize = sb->size * 2;
+        char   *newbuf;
+        if (l > ~(size_t) 0 / 2 - sb->len)
+            luaL_error(L, "string builder too large");
+        if (newsize < sb->len + l) newsize = sb->len + l;
+        if (newsize < MINBUILDER) newsize = MINBUILDER;
+        lua_getfenv(L, 1);
+        newbuf = (char *) lua_newuserdata(L, newsize);
+        if (sb->len > 0) memcpy(newbuf, sb->buf, sb->len);
+        lua_rawseti(L, -2, 1);  /* the old buffer becomes garbage */
+        lua_pop(L, 1);
+        sb->buf  = newbuf;
+        sb->size = newsize;
+    }
+    return sb->buf + sb->len;
+}
+
+
+static void builder_add(lua_State *L, StrBuilder *sb, const char *s,
+                        size_t l) {
+    if (l > 0) {
+        memcpy(builder_reserve(L, sb, l), s, l);
+        sb->len += l;
+    }
+}
+
+
+static int str_builder(lua_State *L) {
+    lua_Integer size = luaL_optinteger(L, 1, 0);
+    StrBuilder  *sb;
+    luaL_argcheck(L, size >= 0, 1, "negative size");
+    lua_settop(L, 0);
+    sb = (StrBuilder *) lua_newuserdata(L, sizeof(StrBuilder));
+    sb->buf  = NULL;
+    sb->len  = 0;
+    sb->size = 0;
+    luaL_getmetatable(L, LUA_STRBUILDER);
+    lua_setmetatable(L, 1);
+    lua_createtable(L, 1, 0);  /* environment holds the buffer */
+    lua_setfenv(L, 1);
+    if (size > 0)
+        builder_reserve(L, sb, (size_t) size);
+    return 1;
+}
+
+
+static int builder_addvalues(lua_State *L) {
+    StrBuilder *sb = tobuilder(L);
+    int        n   = lua_gettop(L);
+    int        i;
+    for (i = 2; i <= n; i++) {
+        size_t     l;
+        const char *s = luaL_checklstring(L, i, &l);
+        builder_add(L, sb, s, l);
+    }
+    lua_settop(L, 1);
+    return 1;  /* the builder, for chaining */
+}
+
+
+static int builder_addf(lua_State *L) {
+    StrBuilder  *sb = tobuilder(L);
+    luaL_Buffer b;
+    size_t      l;
+    const char  *s;
+    luaL_buffinit(L, &b);
+    addformat(L, &b, 2);
+    luaL_pushresult(&b);
+    s = lua_tolstring(L, -1, &l);
+    builder_add(L, sb, s, l);
+    lua_settop(L, 1);
+    return 1;  /* the builder, for chaining */
+}
+
+
+static int builder_tostring(lua_State *L) {
+    StrBuilder *sb = tobuilder(L);
+    if (sb->len == 0)
+        lua_pushliteral(L, "");
+    else
+        lua_pushlstring(L, sb->buf, sb->len);
+    return 1;
+}
+
+
+static int builder_len(lua_State *L) {
+    lua_pushinteger(L, (lua_Integer) tobuilder(L)->len);
+    return 1;
+}
+
+
+static int builder_clear(lua_State *L) {
+    tobuilder(L)->len = 0;  /* keeps the buffer for reuse */
+    lua_settop(L, 1);
+    return 1;
+}
+
+
+static const luaL_Reg builderlib[] = {
+        {"add",        builder_addvalues},
+        {"addf",       builder_addf},
+        {"clear",      builder_clear},
+        {"tostring",   builder_tostring},
+        {"__len",      builder_len},
+        {"__tostring", builder_tostring},
+        {NULL, NULL}
+};
+
+
+static void createbuildermeta(lua_State *L) {
+    luaL_newmetatable(L, LUA_STRBUILDER);  /* create metatable for builders */
+    lua_pushvalue(L, -1);  /* push metatable */
+    lua_setfield(L, -2, "__index");  /* metatable.__index = metatable */
+    lua_pushvalue(L, -1);  /* shared by the methods */
+    luaI_openlib(L, NULL, builderlib, 1);  /* builder methods */
+    lua_pop(L, 1);
+}
+
+/* }====================================================== */
+
+
 static const luaL_Reg strlib[] = {
+        {"builder", str_builder},
         {"byte",    str_byte},
         {"char",    str_char},
         {"dump",    str_dump},
@@ -911,6 +1777,7 @@ LUALIB_API int luaopen_string(lua_State *L) {
     lua_setfield(L, -2, "gfind");
 #endif
     createmetatable(L);
+    createbuildermeta(L);
     return 1;
 }
 
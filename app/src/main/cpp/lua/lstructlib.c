@@ -0,0 +1,428 @@
+/*
+** $Id: lstructlib.c $
+** Packing and unpacking of binary data (the `struct' module)
+** See Copyright Notice in lua.h
+*/
+
+
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#define lstructlib_c
+#define LUA_LIB
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+/*
+** A format is a sequence of options, each one item of data:
+**   < > =      little endian, big endian, native order (the default)
+**              for the options that follow
+**   b B        signed/unsigned char
+**   h H        signed/unsigned short (2 bytes)
+**   i[n] I[n]  signed/unsigned integer with `n' bytes (default 4)
+**   l L        signed/unsigned long (8 bytes)
+**   f d        float, double
+**   s[n]       string preceded by its length, an unsigned integer with
+**              `n' bytes (default 4)
+**   z          zero-terminated string
+**   c[n]       string of exactly `n' bytes (default 1)
+**   x          one byte of padding (zero)
+** Spaces are ignored. There is no alignment: binary protocols are
+** packed, and `x' pads where they are not. Integers wider than 53 bits
+** are exact only while they fit in a double.
+*/
+
+
+/* macro to `unsign' a character */
+#define uchar(c)        ((unsigned char)(c))
+
+#define MAXINTSIZE      8
+
+#define nativelittle()  (*(const char *) &nativeone)
+
+static const int nativeone = 1;
+
+
+typedef enum KOption {
+    Kint,
+    /* signed integer */
+    Kuint,
+    /* unsigned integer */
+    Kfloat,
+    Kdouble,
+    Kchar,
+    /* string of fixed size */
+    Kstring,
+    /* string preceded by its length */
+    Kzstr,
+    /* zero-terminated string */
+    Kpadding,
+    Knop
+    /* byte order or space: no data */
+} KOption;
+
+
+typedef struct Header {
+    lua_State *L;
+    int       little;
+    /* byte order of the options that follow */
+} Header;
+
+
+static void initheader(lua_State *L, Header *h) {
+    h->L      = L;
+    h->little = nativelittle();
+}
+
+
+static int getnum(const char **fmt, int df) {
+    if (!isdigit(uchar(**fmt)))  /* no number? */
+        return df;  /* return default value */
+    else {
+        int a = 0;
+        do {
+            a = a * 10 + (*((*fmt)++) - '0');
+        } while (isdigit(uchar(**fmt)) && a <= (INT_MAX - 9) / 10);
+        return a;
+    }
+}
+
+
+static int getintsize(Header *h, const char **fmt, int df) {
+    int sz = getnum(fmt, df);
+    if (sz < 1 || sz > MAXINTSIZE)
+        luaL_error(h->L, "integral size (%d) out of limits [1,%d]",
+                   sz, MAXINTSIZE);
+    return sz;
+}
+
+
+/* reads the next option of `fmt' and the size of its data */
+static KOption getoption(Header *h, const char **fmt, int *size) {
+    int opt = *((*fmt)++);
+    *size = 0;
+    switch (opt) {
+        case 'b': *size = 1; return Kint;
+        case 'B': *size = 1; return Kuint;
+        case 'h': *size = 2; return Kint;
+        case 'H': *size = 2; return Kuint;
+        case 'l': *size = 8; return Kint;
+        case 'L': *size = 8; return Kuint;
+        case 'i': *size = getintsize(h, fmt, 4); return Kint;
+        case 'I': *size = getintsize(h, fmt, 4); return Kuint;
+        case 'f': *size = 4; return Kfloat;
+        case 'd': *size = 8; return Kdouble;
+        case 's': *size = getintsize(h, fmt, 4); return Kstring;
+        case 'z': return Kzstr;
+        case 'c': *size = getnum(fmt, 1); return Kchar;
+        case 'x': *size = 1; return Kpadding;
+        case ' ': break;
+        case '<': h->little = 1; break;
+        case '>': h->little = 0; break;
+        case '=': h->little = nativelittle(); break;
+        default: luaL_error(h->L, "invalid format option " LUA_QL("%c"), opt);
+    }
+    return Knop;
+}
+
+
+static void packint(luaL_Buffer *b, unsigned long long v, int little,
+                    int size) {
+    char buff[MAXINTSIZE];
+    int  i;
+    for (i = 0; i < size; i++) {
+        buff[little ? i : size - 1 - i] = (char) (v & 0xFF);
+        v >>= 8;
+    }
+    luaL_addlstring(b, buff, size);
+}
+
+
+static unsigned long long unpackint(const char *s, int little, int size) {
+    unsigned long long v = 0;
+    int                i;
+    for (i = 0; i < size; i++)
+        v = (v << 8) | uchar(s[little ? size - 1 - i : i]);
+    return v;
+}
+
+
+/*
+** the bytes of argument `arg': a string, or a userdata whose metatable
+** has a LUA_BUFFERFIELD function (mapped files, Java direct buffers);
+** only functions listed in LUA_BUFFERREADERS are called, so a function
+** put in the metatable by Lua code cannot hand out any pointer
+*/
+static const char *getdata(lua_State *L, int arg, size_t *len) {
+    const char *s;
+    int        trusted = 0;
+    if (lua_type(L, arg) != LUA_TUSERDATA ||
+        !luaL_getmetafield(L, arg, LUA_BUFFERFIELD))
+        return luaL_checklstring(L, arg, len);
+    lua_getfield(L, LUA_REGISTRYINDEX, LUA_BUFFERREADERS);
+    if (lua_istable(L, -1)) {
+        lua_pushvalue(L, -2);  /* the reader */
+        lua_rawget(L, -2);
+        trusted = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);  /* reader list */
+    if (!trusted)
+        luaL_argerror(L, arg, "invalid buffer");
+    lua_pushvalue(L, arg);
+    lua_call(L, 1, 2);
+    s = (const char *) lua_touserdata(L, -2);
+    if (s == NULL || !lua_isnumber(L, -1) || lua_tonumber(L, -1) < 0)
+        luaL_argerror(L, arg, "invalid buffer");
+    *len = (size_t) lua_tonumber(L, -1);
+    lua_pop(L, 2);  /* the object at `arg' keeps the bytes alive */
+    return s;
+}
+
+
+/*
+** the value to pack from argument `arg'; the buffer may have pushed
+** its pieces above the last argument, `top'
+*/
+static int checkarg(lua_State *L, int arg, int top, int t) {
+    if (arg > top)
+        luaL_argerror(L, arg, lua_pushfstring(L, "%s expected, got no value",
+                                              lua_typename(L, t)));
+    return arg;
+}
+
+
+static unsigned long long checkint(lua_State *L, int arg, int size,
+                                   int issigned) {
+    lua_Number x   = luaL_checknumber(L, arg);
+    lua_Number lim = ldexp(1.0, size * 8 - issigned);
+    luaL_argcheck(L, (issigned ? -lim <= x : 0 <= x) && x < lim, arg,
+                  "integer overflow");
+    if (x >= 9223372036854775808.0)  /* beyond `long long' (2^63)? */
+        return (unsigned long long) (x - 9223372036854775808.0) | (1ull << 63);
+    return (unsigned long long) (long long) x;
+}
+
+
+/* pushes an integer, with the integer subtype when it fits an `int' */
+static void pushint(lua_State *L, unsigned long long v, int size,
+                    int issigned) {
+    if (issigned) {
+        long long s;
+        if (size < MAXINTSIZE && (v >> (size * 8 - 1)) != 0)
+            v |= ~0ull << (size * 8);  /* sign extension */
+        s = (long long) v;
+        if (INT_MIN <= s && s <= INT_MAX)
+            lua_pushinteger(L, (lua_Integer) (int) s);
+        else
+            lua_pushnumber(L, (lua_Number) s);
+    }
+    else if (v <= INT_MAX)
+        lua_pushinteger(L, (lua_Integer) (int) v);
+    else
+        lua_pushnumber(L, (lua_Number) v);
+}
+
+
+static int struct_pack(lua_State *L) {
+    luaL_Buffer b;
+    Header      h;
+    const char  *fmt = luaL_checkstring(L, 1);
+    int         top  = lua_gettop(L);
+    int         arg  = 1;  /* current argument to pack */
+    initheader(L, &h);
+    luaL_buffinit(L, &b);
+    while (*fmt != '\0') {
+        int     size;
+        KOption opt = getoption(&h, &fmt, &size);
+        switch (opt) {
+            case Kint:
+            case Kuint: {
+                arg = checkarg(L, arg + 1, top, LUA_TNUMBER);
+                packint(&b, checkint(L, arg, size, opt == Kint), h.little,
+                        size);
+                break;
+            }
+            case Kfloat: {
+                float        f;
+                unsigned int u;
+                arg = checkarg(L, arg + 1, top, LUA_TNUMBER);
+                f   = (float) luaL_checknumber(L, arg);
+                memcpy(&u, &f, sizeof(u));
+                packint(&b, u, h.little, size);
+                break;
+            }
+            case Kdouble: {
+                double             d;
+                unsigned long long u;
+                arg = checkarg(L, arg + 1, top, LUA_TNUMBER);
+                d   = (double) luaL_checknumber(L, arg);
+                memcpy(&u, &d, sizeof(u));
+                packint(&b, u, h.little, size);
+                break;
+            }
+            case Kchar: {
+                size_t     len;
+                const char *s;
+                arg = checkarg(L, arg + 1, top, LUA_TSTRING);
+                s   = luaL_checklstring(L, arg, &len);
+                luaL_argcheck(L, len <= (size_t) size, arg,
+                              "string longer than given size");
+                luaL_addlstring(&b, s, len);
+                for (; len < (size_t) size; len++)  /* pad extra space */
+                    luaL_addchar(&b, '\0');
+                break;
+            }
+            case Kstring: {
+                size_t     len;
+                const char *s;
+                arg = checkarg(L, arg + 1, top, LUA_TSTRING);
+                s   = luaL_checklstring(L, arg, &len);
+                luaL_argcheck(L, size >= (int) sizeof(size_t) ||
+                                 len < ((size_t) 1 << (size * 8)),
+                              arg, "string length does not fit in given size");
+                packint(&b, (unsigned long long) len, h.little, size);
+                luaL_addlstring(&b, s, len);
+                break;
+            }
+            case Kzstr: {
+                size_t     len;
+                const char *s;
+                arg = checkarg(L, arg + 1, top, LUA_TSTRING);
+                s   = luaL_checklstring(L, arg, &len);
+                luaL_argcheck(L, strlen(s) == len, arg, "string contains zeros");
+                luaL_addlstring(&b, s, len);
+                luaL_addchar(&b, '\0');  /* add zero at the end */
+                break;
+            }
+            case Kpadding:
+                luaL_addchar(&b, '\0');
+                break;
+            case Knop:
+                break;
+        }
+    }
+    luaL_pushresult(&b);
+    return 1;
+}
+
+
+static int struct_size(lua_State *L) {
+    Header     h;
+    const char *fmt  = luaL_checkstring(L, 1);
+    size_t     total = 0;
+    initheader(L, &h);
+    while (*fmt != '\0') {
+        int     size;
+        KOption opt = getoption(&h, &fmt, &size);
+        luaL_argcheck(L, opt != Kstring && opt != Kzstr, 1,
+                      "variable-length format");
+        total += (size_t) size;
+    }
+    lua_pushinteger(L, (lua_Integer) total);
+    return 1;
+}
+
+
+/*
+** unpack(fmt, data [, pos]): the values in `data' from position `pos',
+** then the position after the last byte read
+*/
+static int struct_unpack(lua_State *L) {
+    Header      h;
+    const char  *fmt  = luaL_checkstring(L, 1);
+    size_t      ld;
+    const char  *data = getdata(L, 2, &ld);
+    lua_Integer ipos  = luaL_optinteger(L, 3, 1);
+    size_t      pos;
+    int         n     = 0;  /* number of results */
+    if (ipos < 0) ipos += (lua_Integer) ld + 1;  /* relative to the end */
+    luaL_argcheck(L, ipos >= 1 && (size_t) (ipos - 1) <= ld, 3,
+                  "initial position out of data");
+    pos = (size_t) (ipos - 1);
+    initheader(L, &h);
+    while (*fmt != '\0') {
+        int     size;
+        KOption opt = getoption(&h, &fmt, &size);
+        if (opt == Knop)
+            continue;
+        luaL_argcheck(L, (size_t) size <= ld - pos, 2, "data too short");
+        luaL_checkstack(L, 2, "too many results");
+        n++;
+        switch (opt) {
+            case Kint:
+            case Kuint: {
+                pushint(L, unpackint(data + pos, h.little, size), size,
+                        opt == Kint);
+                break;
+            }
+            case Kfloat: {
+                float        f;
+                unsigned int u = (unsigned int) unpackint(data + pos, h.little,
+                                                          size);
+                memcpy(&f, &u, sizeof(f));
+                lua_pushnumber(L, (lua_Number) f);
+                break;
+            }
+            case Kdouble: {
+                double             d;
+                unsigned long long u = unpackint(data + pos, h.little, size);
+                memcpy(&d, &u, sizeof(d));
+                lua_pushnumber(L, (lua_Number) d);
+                break;
+            }
+            case Kchar: {
+                lua_pushlstring(L, data + pos, size);
+                break;
+            }
+            case Kstring: {
+                unsigned long long len = unpackint(data + pos, h.little, size);
+                luaL_argcheck(L, len <= ld - pos - size, 2, "data too short");
+                lua_pushlstring(L, data + pos + size, (size_t) len);
+                pos += (size_t) len;  /* skip string */
+                break;
+            }
+            case Kzstr: {
+                const char *e = (const char *) memchr(data + pos, '\0',
+                                                      ld - pos);
+                luaL_argcheck(L, e != NULL, 2,
+                              "unfinished string for format " LUA_QL("z"));
+                lua_pushlstring(L, data + pos, (size_t) (e - (data + pos)));
+                pos += (size_t) (e - (data + pos)) + 1;  /* skip string and zero */
+                break;
+            }
+            case Kpadding:
+            case Knop:
+                n--;  /* undo increment */
+                break;
+        }
+        pos += (size_t) size;
+    }
+    lua_pushinteger(L, (lua_Integer) pos + 1);  /* next position */
+    return n + 1;
+}
+
+
+static const luaL_Reg structlib[] = {
+        {"pack",   struct_pack},
+        {"size",   struct_size},
+        {"unpack", struct_unpack},
+        {NULL, NULL}
+};
+
+
+/*
+** Open struct library
+*/
+LUALIB_API int luaopen_struct(lua_State *L) {
+    luaL_register(L, LUA_STRUCTLIBNAME, structlib);
+    return 1;
+}
+
@@ -16,6 +16,8 @@
 ** in its main position (i.e. the `original' position that its hash gives
 ** to it), then the colliding element is in its own main position.
 ** Hence even when the load factor reaches 100%, performance remains good.
+** With LUA_USE_OPENHASH the hash part uses open addressing instead (see
+** below); traversal order and the handling of removed keys do not change.
 */
 
 #include <math.h>
@@ -28,7 +30,9 @@
 
 #include "ldebug.h"
 #include "lgc.h"
+#include "lstring.h"
 #include "ltable.h"
+#include "lvm.h"
 
 
 /*
@@ -43,9 +47,17 @@
 #define MAXASIZE    (1 << MAXBITS)
 
 
+/*
+** number of ints inside a lua_Number
+*/
+#define numints        cast_int(sizeof(lua_Number)/sizeof(int))
+
+
+#if !defined(LUA_USE_OPENHASH)
+
 #define hashpow2(t, n)      (gnode(t, lmod((n), sizenode(t))))
 
-#define hashstr(t, str)  hashpow2(t, (str)->tsv.hash)
+#define hashstr(t, str)  hashpow2(t, luaS_strhash(str))
 #define hashboolean(t, p)        hashpow2(t, p)
 
 
@@ -59,12 +71,6 @@
 #define hashpointer(t, p)    hashmod(t, IntPoint(p))
 
 
-/*
-** number of ints inside a lua_Number
-*/
-#define numints        cast_int(sizeof(lua_Number)/sizeof(int))
-
-
 #define dummynode        (&dummynode_)
 
 static const Node dummynode_ = {
@@ -107,11 +113,124 @@ static Node *mainposition(const Table *t, const TValue *key) {
 }
 
 
+#define freenodes(L, n, size)    luaM_freearray(L, n, size, Node)
+
+#else
+
+/*
+** Open addressing: a key goes to the first position not in use found by
+** linear probing from its main position. The node array is followed (in
+** the same block) by an array with the hash of each key, 0 marking the
+** positions never used, so a probe only reads that packed array until a
+** hash matches. As in chained tables, a removed entry keeps its key; it
+** ends no probe and new keys on the same probe path may reuse it.
+*/
+
+#define nodetags(t)    (cast(lu_int32 *, (t)->node + sizenode(t)))
+
+#define nodebytes(size)    ((size) * (sizeof(Node) + sizeof(lu_int32)))
+
+/* main position: Fibonacci hashing, i.e. top bits of h * 2^32/phi */
+#define hashslot(t, h) \
+    cast_int(cast(lu_int32, (h) * 2654435769u) >> (31 - (t)->lsizenode) >> 1)
+
+/* hash 0 marks free positions */
+#define nonzero(h)    ((h) != 0 ? (h) : 1)
+
+/* never used positions that may be taken (at least one stays free) */
+#define maxfree(size)    ((size) - ((size) >> 3) - 1)
+
+
+static const struct {
+    Node     node;
+    lu_int32 tag;
+}                    dummy_ = {
+        {{{NULL}, LUA_TNIL},  /* value */
+         {{{NULL}, LUA_TNIL}}},  /* key */
+        0  /* hash */
+};
+
+#define dummynode        (&dummy_.node)
+
+
+/*
+** hash for lua_Numbers
+*/
+static lu_int32 hashnum(lua_Number n) {
+    unsigned int a[numints];
+    int          i;
+    if (luai_numeq(n, 0))  /* avoid problems with -0 */
+        return 1;
+    memcpy(a, &n, sizeof(a));
+    for (i = 1; i < numints; i++) a[0] += a[i];
+    return nonzero(a[0]);
+}
+
+
+static lu_int32 hashkey(const TValue *key) {
+    lu_int32 h;
+    switch (ttype(key)) {
+        case LUA_TNUMBER:
+            return hashnum(nvalue(key));
+        case LUA_TSTRING:
+            h = luaS_strhash(rawtsvalue(key));
+            break;
+        case LUA_TBOOLEAN:
+            h = bvalue(key);
+            break;
+        case LUA_TLIGHTUSERDATA:
+            h = IntPoint(pvalue(key));
+            break;
+        default:
+            h = IntPoint(gcvalue(key));
+            break;
+    }
+    return nonzero(h);
+}
+
+
+#if defined(LUA_DEBUG)
+static Node *mainposition(const Table *t, const TValue *key) {
+    return gnode(t, hashslot(t, hashkey(key)));
+}
+#endif
+
+
+/*
+** returns the position of `key' in the hash part, or -1. If `dead' is
+** true a dead key matches too (it is ok to use it in `next').
+*/
+static int findslot(const Table *t, const TValue *key, int dead) {
+    lu_int32 h     = hashkey(key);
+    lu_int32 *tags = nodetags(t);
+    int      mask  = sizenode(t) - 1;
+    int      i;
+    for (i = hashslot(t, h); tags[i] != 0; i = (i + 1) & mask) {
+        if (tags[i] == h) {
+            Node *n = gnode(t, i);
+            if (luaO_rawequalObj(key2tval(n), key))
+                return i;
+            if (dead && ttype(gkey(n)) == LUA_TDEADKEY && iscollectable(key) &&
+                gcvalue(gkey(n)) == gcvalue(key))
+                return i;
+        }
+    }
+    return -1;
+}
+
+
+#define freenodes(L, n, size)    luaM_freemem(L, n, nodebytes(size))
+
+#endif
+
+
 /*
 ** returns the index for `key' if `key' is an appropriate key to live in
 ** the array part of the table, -1 otherwise.
 */
 static int arrayindex(const TValue *key) {
+    if (ttisint(key))
+        return ivalue(key);
     if (ttisnumber(key)) {
         lua_Number n = nvalue(key);
         int        k;
@@ -135,6 +254,11 @@ static int findindex(lua_State *L, Table *t, StkId key) {
     if (0 < i && i <= t->sizearray)  /* is `key' inside array part? */
         return i - 1;  /* yes; that's the index (corrected to C) */
     else {
+#if defined(LUA_USE_OPENHASH)
+        i = findslot(t, key, 1);
+        if (i >= 0)  /* hash elements are numbered after array ones */
+            return i + t->sizearray;
+#else
         Node *n = mainposition(t, key);
         do {  /* check whether `key' is somewhere in the chain */
             /* key may be dead already, but it is ok to use it in `next' */
@@ -147,6 +271,7 @@ static int findindex(lua_State *L, Table *t, StkId key) {
             }
             else n = gnext(n);
         } while (n);
+#endif
         luaG_runerror(L, "invalid key to " LUA_QL("next"));  /* key not found */
         return 0;  /* to avoid warnings */
     }
@@ -157,7 +282,7 @@ int luaH_next(lua_State *L, Table *t, StkId key) {
     int i = findindex(L, t, key);  /* find original element */
     for (i++; i < t->sizearray; i++) {  /* try first array part */
         if (!ttisnil(&t->array[i])) {  /* a non-nil value? */
-            setnvalue(key, cast_num(i + 1));
+            setivalue(key, i + 1);
             setobj2s(L, key + 1, &t->array[i]);
             return 1;
         }
@@ -263,30 +388,73 @@ static void setarrayvector(lua_State *L, Table *t, int size) {
 }
 
 
+#if defined(LUA_USE_OPENHASH)
+
+static void clearnodes(Table *t, int size) {
+    int i;
+    for (i = 0; i < size; i++) {
+        Node *n = gnode(t, i);
+        setnilvalue(gkey(n));
+        setnilvalue(gval(n));
+        nodetags(t)[i] = 0;
+    }
+    t->nodefree = maxfree(size);
+}
+
+
+static void setnodevector(lua_State *L, Table *t, int size) {
+    int lsize;
+    if (size == 0) {  /* no elements to hash part? */
+        t->node     = cast(Node *, dummynode);  /* use common `dummynode' */
+        t->nodefree = 0;
+        lsize = 0;
+    }
+    else {
+        lsize = ceillog2(size + (size >> 2) + 1);  /* room for `maxfree' */
+        if (lsize > MAXBITS)
+            luaG_runerror(L, "table overflow");
+        size = twoto(lsize);
+        t->node      = cast(Node *, luaM_malloc(L, nodebytes(size)));
+        t->lsizenode = cast_byte(lsize);
+        clearnodes(t, size);
+    }
+    t->lsizenode = cast_byte(lsize);
+}
+
+#else
+
+static void clearnodes(Table *t, int size) {
+    int i;
+    for (i = 0; i < size; i++) {
+        Node *n = gnode(t, i);
+        gnext(n) = NULL;
+        setnilvalue(gkey(n));
+        setnilvalue(gval(n));
+    }
+    t->lastfree = gnode(t, size);  /* all positions are free */
+}
+
+
 static void setnodevector(lua_State *L, Table *t, int size) {
     int lsize;
     if (size == 0) {  /* no elements to hash part? */
-        t->node = cast(Node *, dummynode);  /* use common `dummynode' */
+        t->node     = cast(Node *, dummynode);  /* use common `dummynode' */
+        t->lastfree = gnode(t, 0);
         lsize = 0;
     }
     else {
-        int i;
         lsize = ceillog2(size);
         if (lsize > MAXBITS)
             luaG_runerror(L, "table overflow");
         size = twoto(lsize);
         t->node = luaM_newvector(L, size, Node);
-        for (i = 0; i < size; i++) {
-            Node *n = gnode(t, i);
-            gnext(n) = NULL;
-            setnilvalue(gkey(n));
-            setnilvalue(gval(n));
-        }
+        clearnodes(t, size);
     }
     t->lsizenode = cast_byte(lsize);
-    t->lastfree  = gnode(t, size);  /* all positions are free */
 }
 
+#endif
+
 
 static void resize(lua_State *L, Table *t, int nasize, int nhsize) {
     int  i;
@@ -314,7 +482,7 @@ static void resize(lua_State *L, Table *t, int nasize, int nhsize) {
                 setobjt2t (L, luaH_set(L, t, key2tval(old)), gval(old));
     }
     if (nold != dummynode)
-        luaM_freearray(L, nold, twoto(oldhsize), Node);  /* free old array */
+        freenodes(L, nold, twoto(oldhsize));  /* free old array */
 }
 
 
@@ -356,6 +524,7 @@ Table *luaH_new(lua_State *L, int narray, int nhash) {
     /* temporary values (kept only if some malloc fails) */
     t->array     = NULL;
     t->sizearray = 0;
+    t->border    = 0;
     t->lsizenode = 0;
     t->node      = cast(Node *, dummynode);
     setarrayvector(L, t, narray);
@@ -364,14 +533,111 @@ Table *luaH_new(lua_State *L, int narray, int nhash) {
 }
 
 
+/*
+** remove all entries of `t' but keep both parts allocated, so that a
+** table reused as a buffer does not grow (and rehash) all over again
+*/
+void luaH_clear(Table *t) {
+    int i;
+    for (i = 0; i < t->sizearray; i++)
+        setnilvalue(&t->array[i]);
+    t->border = 0;
+    if (t->node != dummynode)
+        clearnodes(t, sizenode(t));
+}
+
+
 void luaH_free(lua_State *L, Table *t) {
     if (t->node != dummynode)
-        luaM_freearray(L, t->node, sizenode(t), Node);
+        freenodes(L, t->node, sizenode(t));
     luaM_freearray(L, t->array, t->sizearray, TValue);
     luaM_free(L, t);
 }
 
 
+#if defined(LUA_USE_OPENHASH)
+
+/*
+** inserts a new key into a hash table, at the first position on its
+** probe path holding no value: a removed entry or a never used one. When
+** no never used position can be taken anymore, the table is rehashed.
+*/
+static TValue *newkey(lua_State *L, Table *t, const TValue *key) {
+    lu_int32 h     = hashkey(key);
+    lu_int32 *tags = nodetags(t);
+    int      mask  = sizenode(t) - 1;
+    int      i     = hashslot(t, h);
+    Node     *n;
+    while (tags[i] != 0 && !ttisnil(gval(gnode(t, i))))
+        i = (i + 1) & mask;
+    if (tags[i] == 0) {  /* a never used position? */
+        if (t->nodefree == 0) {  /* table is full? */
+            rehash(L, t, key);  /* grow table */
+            return luaH_set(L, t, key);  /* re-insert key into grown table */
+        }
+        t->nodefree--;
+    }
+    n       = gnode(t, i);
+    tags[i] = h;
+    gkey(n)->value = key->value;
+    gkey(n)->tt = key->tt;
+    luaC_barriert(L, t, key);
+    lua_assert(ttisnil(gval(n)));
+    return gval(n);
+}
+
+
+/*
+** search function for integers
+*/
+const TValue *luaH_getnum(Table *t, int key) {
+    /* (1 <= key && key <= t->sizearray) */
+    if (cast(unsigned int, key - 1) < cast(unsigned int, t->sizearray))
+        return &t->array[key - 1];
+    else {
+        lua_Number nk    = cast_num(key);
+        lu_int32   h     = hashnum(nk);
+        lu_int32   *tags = nodetags(t);
+        int        mask  = sizenode(t) - 1;
+        int        i;
+        for (i = hashslot(t, h); tags[i] != 0; i = (i + 1) & mask) {
+            Node *n = gnode(t, i);
+            if (tags[i] == h && ttisnumber(gkey(n)) &&
+                luai_numeq(nvalue(gkey(n)), nk))
+                return gval(n);  /* that's it */
+        }
+        return luaO_nilobject;
+    }
+}
+
+
+/*
+** search function for strings
+*/
+const TValue *luaH_getstr(Table *t, TString *key) {
+    lu_int32 h     = nonzero(luaS_strhash(key));
+    lu_int32 *tags = nodetags(t);
+    int      mask  = sizenode(t) - 1;
+    int      i;
+    if (luaS_islong(key)) {  /* not interned: compare contents */
+        for (i = hashslot(t, h); tags[i] != 0; i = (i + 1) & mask) {
+            Node *n = gnode(t, i);
+            if (tags[i] == h && ttisstring(gkey(n)) &&
+                luaS_eqlngstr(key, rawtsvalue(gkey(n))))
+                return gval(n);  /* that's it */
+        }
+        return luaO_nilobject;
+    }
+    for (i = hashslot(t, h); tags[i] != 0; i = (i + 1) & mask) {
+        Node *n = gnode(t, i);
+        if (tags[i] == h && ttisstring(gkey(n)) && rawtsvalue(gkey(n)) == key)
+            return gval(n);  /* that's it */
+    }
+    return luaO_nilobject;
+}
+
+#else
+
 static Node *getfreepos(Table *t) {
     while (t->lastfree-- > t->node) {
         if (ttisnil(gkey(t->lastfree)))
@@ -447,6 +713,14 @@ const TValue *luaH_getnum(Table *t, int key) {
 */
 const TValue *luaH_getstr(Table *t, TString *key) {
     Node *n = hashstr(t, key);
+    if (luaS_islong(key)) {  /* not interned: compare contents */
+        do {
+            if (ttisstring(gkey(n)) && luaS_eqlngstr(key, rawtsvalue(gkey(n))))
+                return gval(n);  /* that's it */
+            else n = gnext(n);
+        } while (n);
+        return luaO_nilobject;
+    }
     do {  /* check whether `key' is somewhere in the chain */
         if (ttisstring(gkey(n)) && rawtsvalue(gkey(n)) == key)
             return gval(n);  /* that's it */
@@ -455,11 +729,15 @@ const TValue *luaH_getstr(Table *t, TString *key) {
     return luaO_nilobject;
 }
 
+#endif
+
 
 /*
 ** main search function
 */
 const TValue *luaH_get(Table *t, const TValue *key) {
+    if (ttisint(key))
+        return luaH_getnum(t, ivalue(key));
     switch (ttype(key)) {
         case LUA_TNIL:
             return luaO_nilobject;
@@ -474,6 +752,10 @@ const TValue *luaH_get(Table *t, const TValue *key) {
             /* else go through */
         }
         default: {
+#if defined(LUA_USE_OPENHASH)
+            int i = findslot(t, key, 0);
+            return (i >= 0) ? gval(gnode(t, i)) : luaO_nilobject;
+#else
             Node *n = mainposition(t, key);
             do {  /* check whether `key' is somewhere in the chain */
                 if (luaO_rawequalObj(key2tval(n), key))
@@ -481,6 +763,7 @@ const TValue *luaH_get(Table *t, const TValue *key) {
                 else n = gnext(n);
             } while (n);
             return luaO_nilobject;
+#endif
         }
     }
 }
@@ -506,7 +789,7 @@ TValue *luaH_setnum(lua_State *L, Table *t, int key) {
         return cast(TValue *, p);
     else {
         TValue k;
-        setnvalue(&k, cast_num(key));
+        setivalue(&k, key);
         return newkey(L, t, &k);
     }
 }
@@ -551,25 +834,233 @@ static int unbound_search(Table *t, unsigned int j) {
 /*
 ** Try to find a boundary in table `t'. A `boundary' is an integer index
 ** such that t[i] is non-nil and t[i+1] is nil (and 0 if t[1] is nil).
+** The last boundary found is kept in `t->border'; as sequences usually
+** grow or shrink at their end, it (or a neighbor) is checked first, which
+** makes `#t' O(1) for appends and removals.
 */
 int luaH_getn(Table *t) {
     unsigned int j = t->sizearray;
+    unsigned int b = t->border;
     if (j > 0 && ttisnil(&t->array[j - 1])) {
-        /* there is a boundary in the array part: (binary) search for it */
+        /* there is a boundary in the array part */
         unsigned int i = 0;
+        if (b < j) {  /* try the cached one */
+            if (ttisnil(&t->array[b])) {
+                if (b == 0 || !ttisnil(&t->array[b - 1]))
+                    return b;
+                if (b == 1 || !ttisnil(&t->array[b - 2]))
+                    return t->border = b - 1;
+            }
+            else if (ttisnil(&t->array[b + 1]))  /* b + 1 < j */
+                return t->border = b + 1;
+        }
+        /* (binary) search for it */
         while (j - i > 1) {
             unsigned int m = (i + j) / 2;
             if (ttisnil(&t->array[m - 1])) j = m;
             else i = m;
         }
-        return i;
+        return t->border = i;
     }
         /* else must find a boundary in hash part */
     else if (t->node == dummynode)  /* hash part is empty? */
         return j;  /* that is easy... */
-    else return unbound_search(t, j);
+    else {
+        if (b > j && !ttisnil(luaH_getnum(t, b))) {  /* try the cached one */
+            if (ttisnil(luaH_getnum(t, b + 1)))
+                return b;
+            if (ttisnil(luaH_getnum(t, b + 2)))
+                return t->border = b + 1;
+        }
+        return t->border = unbound_search(t, j);
+    }
+}
+
+
+
+/*
+** {=============================================================
+** Sorting of arrays of numbers or strings (pattern-defeating quicksort)
+** ==============================================================
+*/
+
+#define SORTINSERT    16  /* ranges up to this size use insertion sort */
+#define SORTMOVES    8  /* moves allowed to a partial insertion sort */
+
+
+/* `a < b' for two numbers (`isstr' false) or two strings */
+#define sortlt(a, b, isstr) \
+    ((isstr) ? luaV_strcmp(rawtsvalue(a), rawtsvalue(b)) < 0 \
+             : luai_numlt(nvalue(a), nvalue(b)))
+
+
+static void swapvalues(TValue *a, TValue *b) {
+    TValue t = *a;
+    *a = *b;
+    *b = t;
+}
+
+
+/* order a[i] <= a[j] <= a[k] */
+static void sort3(TValue *a, int i, int j, int k, int isstr) {
+    if (sortlt(&a[j], &a[i], isstr)) swapvalues(&a[i], &a[j]);
+    if (sortlt(&a[k], &a[j], isstr)) {
+        swapvalues(&a[j], &a[k]);
+        if (sortlt(&a[j], &a[i], isstr)) swapvalues(&a[i], &a[j]);
+    }
+}
+
+
+/*
+** insertion sort of a[lo..hi-1]; gives up (returning 0) once more than
+** `limit' elements were moved
+*/
+static int insertsort(TValue *a, int lo, int hi, int limit, int isstr) {
+    int i;
+    int moves = 0;
+    for (i = lo + 1; i < hi; i++) {
+        int    j = i;
+        TValue v = a[i];
+        while (j > lo && sortlt(&v, &a[j - 1], isstr)) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = v;
+        moves += i - j;
+        if (moves > limit) return 0;
+    }
+    return 1;
+}
+
+
+static void siftdown(TValue *a, int lo, int i, int n, int isstr) {
+    TValue v = a[lo + i];
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && sortlt(&a[lo + c], &a[lo + c + 1], isstr)) c++;
+        if (!sortlt(&v, &a[lo + c], isstr)) break;
+        a[lo + i] = a[lo + c];
+        i = c;
+    }
+    a[lo + i] = v;
+}
+
+
+static void heapsort(TValue *a, int lo, int hi, int isstr) {
+    int n = hi - lo;
+    int i;
+    for (i = n / 2 - 1; i >= 0; i--)
+        siftdown(a, lo, i, n, isstr);
+    for (i = n - 1; i > 0; i--) {
+        swapvalues(&a[lo], &a[lo + i]);
+        siftdown(a, lo, 0, i, isstr);
+    }
+}
+
+
+/*
+** sort a[lo..hi-1]. The pivot is a median of 3 (of 9 in large ranges);
+** after `bad' unbalanced partitions the range goes to heap sort, which
+** bounds the worst case to O(n log n). Unbalanced partitions also swap
+** a few elements to break patterns, and a partition that moved nothing
+** tries a short insertion sort on each side, making sorted runs O(n).
+*/
+static void sortrange(TValue *a, int lo, int hi, int bad, int isstr) {
+    while (hi - lo > SORTINSERT) {
+        int    n   = hi - lo;
+        int    mid = lo + n / 2;
+        int    i   = lo;
+        int    j   = hi;
+        int    p, nl, nr, sorted;
+        TValue pivot;
+        if (n > 128) {  /* pseudo-median of 9 */
+            sort3(a, lo, mid, hi - 1, isstr);
+            sort3(a, lo + 1, mid - 1, hi - 2, isstr);
+            sort3(a, lo + 2, mid + 1, hi - 3, isstr);
+            sort3(a, mid - 1, mid, mid + 1, isstr);
+            swapvalues(&a[lo], &a[mid]);
+        }
+        else
+            sort3(a, mid, lo, hi - 1, isstr);
+        /* partition around pivot a[lo]; the medians bound both scans */
+        pivot = a[lo];
+        do i++; while (sortlt(&a[i], &pivot, isstr));
+        if (i - 1 == lo) {
+            while (i < j) {
+                j--;
+                if (sortlt(&a[j], &pivot, isstr)) break;
+            }
+        }
+        else
+            do j--; while (!sortlt(&a[j], &pivot, isstr));
+        sorted = (i >= j);  /* nothing to swap? */
+        while (i < j) {
+            swapvalues(&a[i], &a[j]);
+            do i++; while (sortlt(&a[i], &pivot, isstr));
+            do j--; while (!sortlt(&a[j], &pivot, isstr));
+        }
+        p = i - 1;
+        a[lo] = a[p];
+        a[p]  = pivot;
+        /* a[lo..p-1] < pivot <= a[p+1..hi-1] */
+        nl = p - lo;
+        nr = hi - p - 1;
+        if (nl < n / 8 || nr < n / 8) {  /* unbalanced partition? */
+            if (--bad == 0) {
+                heapsort(a, lo, hi, isstr);
+                return;
+            }
+            if (nl >= SORTINSERT) {
+                swapvalues(&a[lo], &a[lo + nl / 4]);
+                swapvalues(&a[p - 1], &a[p - nl / 4]);
+            }
+            if (nr >= SORTINSERT) {
+                swapvalues(&a[p + 1], &a[p + 1 + nr / 4]);
+                swapvalues(&a[hi - 1], &a[hi - nr / 4]);
+            }
+        }
+        else if (sorted && insertsort(a, lo, p, SORTMOVES, isstr) &&
+                 insertsort(a, p + 1, hi, SORTMOVES, isstr))
+            return;
+        if (nl < nr) {  /* recurse into the smaller side */
+            sortrange(a, lo, p, bad, isstr);
+            lo = p + 1;
+        }
+        else {
+            sortrange(a, p + 1, hi, bad, isstr);
+            hi = p;
+        }
+    }
+    insertsort(a, lo, hi, MAX_INT, isstr);
+}
+
+
+/*
+** sort t[1..n] with the primitive `<' if they are all in the array part
+** and are all numbers (no NaN) or all strings; returns 0, leaving the
+** table untouched, otherwise
+*/
+int luaH_sort(Table *t, int n) {
+    int i;
+    int isstr;
+    int bad = 1;
+    if (n < 2) return (n >= 0 && n <= t->sizearray);
+    if (n > t->sizearray) return 0;
+    isstr = ttisstring(&t->array[0]);
+    for (i = 0; i < n; i++) {
+        const TValue *v = &t->array[i];
+        if (isstr ? !ttisstring(v)
+                  : !ttisnumber(v) || luai_numisnan(nvalue(v)))
+            return 0;
+    }
+    for (i = n; i > 1; i >>= 1) bad++;  /* log2(n) unbalanced partitions */
+    sortrange(t->array, 0, n, bad, isstr);
+    return 1;
 }
 
+/* }============================================================= */
+
 
 #if defined(LUA_DEBUG)
 
@@ -13,7 +13,9 @@
 #define gnode(t, i)    (&(t)->node[i])
 #define gkey(n)        (&(n)->i_key.nk)
 #define gval(n)        (&(n)->i_val)
+#if !defined(LUA_USE_OPENHASH)
 #define gnext(n)    ((n)->i_key.nk.next)
+#endif
 
 #define key2tval(n)    (&(n)->i_key.tvk)
 
@@ -34,12 +36,16 @@ LUAI_FUNC Table        *luaH_new(lua_State *L, int narray, int lnhash);
 
 LUAI_FUNC void         luaH_resizearray(lua_State *L, Table *t, int nasize);
 
+LUAI_FUNC void         luaH_clear(Table *t);
+
 LUAI_FUNC void         luaH_free(lua_State *L, Table *t);
 
 LUAI_FUNC int          luaH_next(lua_State *L, Table *t, StkId key);
 
 LUAI_FUNC int          luaH_getn(Table *t);
 
+LUAI_FUNC int          luaH_sort(Table *t, int n);
+
 
 #if defined(LUA_DEBUG)
 LUAI_FUNC Node *luaH_mainposition (const Table *t, const TValue *key);
@@ -5,6 +5,7 @@
 */
 
 
+#include <limits.h>
 #include <stddef.h>
 
 #define ltablib_c
@@ -69,6 +70,23 @@ static int maxn(lua_State *L) {
 }
 
 
+static int tnew(lua_State *L) {
+    int narray = luaL_optint(L, 1, 0);
+    int nhash  = luaL_optint(L, 2, 0);
+    luaL_argcheck(L, narray >= 0, 1, "size must be non-negative");
+    luaL_argcheck(L, nhash >= 0, 2, "size must be non-negative");
+    lua_createtable(L, narray, nhash);
+    return 1;
+}
+
+
+static int tclear(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_cleartable(L, 1);
+    return 0;
+}
+
+
 static int getn(lua_State *L) {
     lua_pushinteger(L, aux_getn(L, 1));
     return 1;
@@ -149,7 +167,7 @@ static int tconcat(lua_State *L) {
     luaL_checktype(L, 1, LUA_TTABLE);
     i    = luaL_optint(L, 3, 1);
     last = luaL_opt(L, luaL_checkint, 4, luaL_getn(L, 1));
-    luaL_buffinit(L, &b);
+    luaL_buffinitheap(L, &b);
     for (; i < last; i++) {
         addfield(L, &b, i);
         luaL_addlstring(&b, sep, lsep);
@@ -166,14 +184,28 @@ static int tconcat(lua_State *L) {
 ** Quicksort
 ** (based on `Algorithms in MODULA-3', Robert Sedgewick;
 **  Addison-Wesley, 1993.)
+** with the pattern-defeating refinements of pdqsort: insertion sort
+** for short ranges, a short insertion sort after a partition that moved
+** nothing (sorted runs), some swaps after unbalanced partitions and heap
+** sort after too many of them, so the worst case is O(n log n).
 */
 
 
+#define SORTINSERT    12  /* ranges up to this size use insertion sort */
+#define SORTMOVES    8  /* moves allowed to a partial insertion sort */
+
+
 static void set2(lua_State *L, int i, int j) {
     lua_rawseti(L, 1, i);
     lua_rawseti(L, 1, j);
 }
 
+static void swap(lua_State *L, int i, int j) {
+    lua_rawgeti(L, 1, i);
+    lua_rawgeti(L, 1, j);
+    set2(L, i, j);
+}
+
 static int sort_comp(lua_State *L, int a, int b) {
     if (!lua_isnil(L, 2)) {  /* function? */
         int res;
@@ -189,9 +221,71 @@ static int sort_comp(lua_State *L, int a, int b) {
         return lua_lessthan(L, a, b);
 }
 
-static void auxsort(lua_State *L, int l, int u) {
-    while (l < u) {  /* for tail recursion */
-        int i, j;
+/*
+** insertion sort of a[l..u]; gives up (returning 0) once more than
+** `limit' elements were moved
+*/
+static int insertsort(lua_State *L, int l, int u, int limit) {
+    int i;
+    int moves = 0;
+    for (i = l + 1; i <= u; i++) {
+        int j = i;
+        lua_rawgeti(L, 1, i);  /* element to insert */
+        while (j > l) {
+            lua_rawgeti(L, 1, j - 1);
+            if (!sort_comp(L, -2, -1)) {  /* a[j-1] <= element? */
+                lua_pop(L, 1);
+                break;
+            }
+            lua_rawseti(L, 1, j);  /* a[j] = a[j-1] */
+            j--;
+        }
+        lua_rawseti(L, 1, j);
+        moves += i - j;
+        if (moves > limit) return 0;
+    }
+    return 1;
+}
+
+static void siftdown(lua_State *L, int l, int i, int n) {
+    lua_rawgeti(L, 1, l + i);  /* element to sift */
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        lua_rawgeti(L, 1, l + c);
+        if (c + 1 < n) {
+            lua_rawgeti(L, 1, l + c + 1);
+            if (sort_comp(L, -2, -1)) {  /* a[c] < a[c+1]? */
+                lua_remove(L, -2);
+                c++;
+            }
+            else
+                lua_pop(L, 1);
+        }
+        if (!sort_comp(L, -2, -1)) {  /* child <= element? */
+            lua_pop(L, 1);
+            break;
+        }
+        lua_rawseti(L, 1, l + i);  /* a[i] = child */
+        i = c;
+    }
+    lua_rawseti(L, 1, l + i);
+}
+
+static void heapsort(lua_State *L, int l, int u) {
+    int n = u - l + 1;
+    int i;
+    for (i = n / 2 - 1; i >= 0; i--)
+        siftdown(L, l, i, n);
+    for (i = n - 1; i > 0; i--) {
+        swap(L, l, l + i);
+        siftdown(L, l, 0, i);
+    }
+}
+
+static void auxsort(lua_State *L, int l, int u, int bad) {
+    while (u - l >= SORTINSERT) {  /* for tail recursion */
+        int i, j, n, swaps;
         /* sort elements a[l], a[(l+u)/2] and a[u] */
         lua_rawgeti(L, 1, l);
         lua_rawgeti(L, 1, u);
@@ -199,7 +293,6 @@ static void auxsort(lua_State *L, int l, int u) {
             set2(L, l, u);  /* swap a[l] - a[u] */
         else
             lua_pop(L, 2);
-        if (u - l == 1) break;  /* only 2 elements */
         i = (l + u) / 2;
         lua_rawgeti(L, 1, i);
         lua_rawgeti(L, 1, l);
@@ -213,14 +306,15 @@ static void auxsort(lua_State *L, int l, int u) {
             else
                 lua_pop(L, 2);
         }
-        if (u - l == 2) break;  /* only 3 elements */
         lua_rawgeti(L, 1, i);  /* Pivot */
         lua_pushvalue(L, -1);
         lua_rawgeti(L, 1, u - 1);
         set2(L, i, u - 1);
         /* a[l] <= P == a[u-1] <= a[u], only need to sort from l+1 to u-2 */
-        i = l;
-        j = u - 1;
+        n     = u - l + 1;
+        swaps = 0;
+        i     = l;
+        j     = u - 1;
         for (; ;) {  /* invariant: a[l..i] <= P <= a[j..u] */
             /* repeat ++i until a[i] >= P */
             while (lua_rawgeti(L, 1, ++i), sort_comp(L, -1, -2)) {
@@ -237,11 +331,29 @@ static void auxsort(lua_State *L, int l, int u) {
                 break;
             }
             set2(L, i, j);
+            swaps++;
         }
         lua_rawgeti(L, 1, u - 1);
         lua_rawgeti(L, 1, i);
         set2(L, u - 1, i);  /* swap pivot (a[u-1]) with a[i] */
         /* a[l..i-1] <= a[i] == P <= a[i+1..u] */
+        if (i - l < n / 8 || u - i < n / 8) {  /* unbalanced partition? */
+            if (--bad == 0) {  /* too many of them: go for the worst case */
+                heapsort(L, l, u);
+                return;
+            }
+            if (i - l > SORTINSERT) {  /* break patterns */
+                swap(L, l + 1, l + (i - l) / 4);
+                swap(L, i - 1, i - (i - l) / 4);
+            }
+            if (u - i > SORTINSERT) {
+                swap(L, i + 1, i + (u - i) / 4);
+                swap(L, u - 1, u - (u - i) / 4);
+            }
+        }
+        else if (swaps == 0 && insertsort(L, l, i - 1, SORTMOVES) &&
+                 insertsort(L, i + 1, u, SORTMOVES))
+            return;  /* it was (almost) sorted already */
         /* adjust so that smaller half is in [j..i] and larger one in [l..u] */
         if (i - l < u - i) {
             j = l;
@@ -253,17 +365,23 @@ static void auxsort(lua_State *L, int l, int u) {
             i = u;
             u = j - 2;
         }
-        auxsort(L, j, i);  /* call recursively the smaller one */
+        auxsort(L, j, i, bad);  /* call recursively the smaller one */
     }  /* repeat the routine for the larger one */
+    insertsort(L, l, u, INT_MAX);
 }
 
 static int sort(lua_State *L) {
-    int n = aux_getn(L, 1);
+    int n   = aux_getn(L, 1);
+    int bad = 1;
+    int i;
     luaL_checkstack(L, 40, "");  /* assume array is smaller than 2^40 */
     if (!lua_isnoneornil(L, 2))  /* is there a 2nd argument? */
         luaL_checktype(L, 2, LUA_TFUNCTION);
     lua_settop(L, 2);  /* make sure there is two arguments */
-    auxsort(L, 1, n);
+    if (lua_isnil(L, 2) && lua_rawsort(L, 1, n))
+        return 0;  /* sorted numbers or strings directly */
+    for (i = n; i > 1; i >>= 1) bad++;  /* log2(n) unbalanced partitions */
+    auxsort(L, 1, n, bad);
     return 0;
 }
 
@@ -271,11 +389,13 @@ static int sort(lua_State *L) {
 
 
 static const luaL_Reg tab_funcs[] = {
+        {"clear",    tclear},
         {"concat",   tconcat},
         {"foreach",  foreach},
         {"foreachi", foreachi},
         {"getn",     getn},
         {"maxn",     maxn},
+        {"new",      tnew},
         {"insert",   tinsert},
         {"remove",   tremove},
         {"setn",     setn},
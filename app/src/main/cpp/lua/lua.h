@@ -239,6 +239,10 @@ LUA_API int   (lua_setmetatable)(lua_State *L, int objindex);
 
 LUA_API int   (lua_setfenv)(lua_State *L, int idx);
 
+LUA_API void  (lua_cleartable)(lua_State *L, int idx);
+
+LUA_API int   (lua_rawsort)(lua_State *L, int idx, int n);
+
 
 /*
 ** `load' and `call' functions (load and run Lua code)
@@ -264,6 +268,12 @@ LUA_API int  (lua_resume)(lua_State *L, int narg);
 
 LUA_API int  (lua_status)(lua_State *L);
 
+LUA_API int  (lua_isyieldable)(lua_State *L);
+
+LUA_API void  (lua_setpark)(lua_State *L, void *key);
+
+LUA_API void *(lua_getpark)(lua_State *L);
+
 /*
 ** garbage-collection function and options
 */
@@ -276,6 +286,15 @@ LUA_API int  (lua_status)(lua_State *L);
 #define LUA_GCSTEP        5
 #define LUA_GCSETPAUSE        6
 #define LUA_GCSETSTEPMUL    7
+#define LUA_GCGEN        8
+#define LUA_GCINC        9
+#define LUA_GCSETMAJORINC    10
+#define LUA_GCSETBUDGETUS    11
+#define LUA_GCPAUSEHIST    12
+#define LUA_GCBGSWEEP    13
+
+/* number of buckets of the GC pause histogram (see LUA_GCPAUSEHIST) */
+#define LUA_GCHISTSIZE    16
 
 LUA_API int (lua_gc)(lua_State *L, int what, int data);
 
@@ -294,6 +313,10 @@ LUA_API lua_Alloc (lua_getallocf)(lua_State *L, void **ud);
 
 LUA_API void lua_setallocf(lua_State *L, lua_Alloc f, void *ud);
 
+LUA_API int   (lua_setcstacklimit)(lua_State *L, int limit);
+
+LUA_API int   (lua_setcalllimit)(lua_State *L, int limit);
+
 
 
 /* 
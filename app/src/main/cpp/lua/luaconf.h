@@ -59,6 +59,29 @@
 #endif
 
 
+/*
+@@ LUA_USE_MMAP lets io.mmap map files into memory with POSIX `mmap'.
+** CHANGE it (undefine it) if your system has no `mmap'; io.mmap then
+** fails with an error message.
+*/
+#if defined(LUA_USE_POSIX) || defined(__ANDROID__)
+#define LUA_USE_MMAP
+#endif
+
+
+/*
+@@ LUA_USE_ASYNCIO lets io.async run reads and writes on POSIX threads.
+** CHANGE it (undefine it) if your system has no `pthread' or `pread';
+** io.async then fails with an error message.
+@@ LUA_ASYNCTHREADS is the number of worker threads of io.async.
+** CHANGE it if your storage serves more (or fewer) requests at once.
+*/
+#if defined(LUA_USE_POSIX) || defined(__ANDROID__)
+#define LUA_USE_ASYNCIO
+#endif
+#define LUA_ASYNCTHREADS	8
+
+
 /*
 @@ LUA_PATH and LUA_CPATH are the names of the environment variables that
 @* Lua check to set its paths.
@@ -313,6 +336,45 @@
 #define LUAI_GCMUL	200 /* GC runs 'twice the speed' of memory allocation */
 
 
+/*
+@@ LUAI_GCMAJOR defines the default heap growth, as a percentage of the
+@* memory in use after the last major collection, that makes the
+@* generational collector do a major (full) collection.
+** CHANGE it if you want major collections to happen more or less often.
+** You can also change this value dynamically.
+*/
+#define LUAI_GCMAJOR	200  /* 200% (major collection when heap doubles) */
+
+
+/*
+@@ LUA_USE_BGSWEEP lets the collector hand the memory of swept objects to
+@* a background thread (see LUA_GCBGSWEEP). It needs POSIX threads, and
+@* it is off at run time until LUA_GCBGSWEEP turns it on.
+** While a sweep step runs, the state's allocator is swapped for one that
+** defers frees to that thread, which then calls the allocator given to
+** `lua_newstate' concurrently with the state. So only turn it on when
+** that allocator is thread safe and its `ud' is not shared with code
+** that assumes a single thread (`luaL_newstate', over the C library, is
+** fine).
+@@ LUAI_SWEEPBATCH is the number of blocks handed to that thread at once.
+** CHANGE it (define it) to try it on your platform; change the batch
+** to trade latency of the frees against synchronization.
+*/
+/* #define LUA_USE_BGSWEEP */
+#define LUAI_SWEEPBATCH	256
+
+
+/*
+@@ LUA_USE_OPENHASH makes the hash part of tables use open addressing
+@* (linear probing) instead of chained scatter tables. Nodes lose their
+@* `next' pointer and the hashes of their keys are packed in a separate
+@* array, so a lookup scans a few contiguous words instead of chasing
+@* pointers. It needs more slack (the load factor is kept below 7/8).
+** CHANGE it (define it) to try it on your platform.
+*/
+/* #define LUA_USE_OPENHASH */
+
+
 
 /*
 @@ LUA_COMPAT_GETN controls compatibility with old getn behavior.
@@ -430,7 +492,8 @@
 @@ LUAI_MAXCALLS limits the number of nested calls.
 ** CHANGE it if you need really deep recursive calls. This limit is
 ** arbitrary; its only purpose is to stop infinite recursion before
-** exhausting memory.
+** exhausting memory. It is only the default: `lua_setcalllimit' (and
+** `debug.setcalllimit') change it for a state.
 */
 #define LUAI_MAXCALLS	20000
 
@@ -446,6 +509,48 @@
 #define LUAI_MAXCSTACK	8000
 
 
+/*
+@@ LUAI_HASHLIMIT is the maximum length of a string that is hashed in
+@* full when it is interned.
+** CHANGE it to trade hash quality for speed when interning very long
+** strings. Longer strings hash their first and last LUAI_HASHLIMIT/2
+** bytes plus a sample of the bytes in between. (must be a multiple of 8)
+*/
+#define LUAI_HASHLIMIT	4096
+
+
+/*
+@@ LUAI_MAXSHORTLEN is the maximum length of an interned string.
+** CHANGE it to intern more or fewer strings. Longer strings (file
+** contents, concatenation results, big buffers) skip the string table:
+** they are hashed only when used as a table key and compared by
+** contents.
+*/
+#define LUAI_MAXSHORTLEN	40
+
+
+/*
+@@ LUAI_STRMIGRATE is the number of string-table buckets moved to the
+@* new table by each string creation while the table is being resized.
+** CHANGE it to spread the rehash over more (smaller values) or fewer
+** (larger values) allocations. (must be at least 1)
+*/
+#define LUAI_STRMIGRATE	4
+
+
+/*
+@@ luai_makeseed is the per-state seed for string hashes.
+** CHANGE it if you need reproducible hashes (e.g. a constant) or have a
+** better source of randomness. The default mixes the current time with
+** the (randomized) address of the new state.
+*/
+#if defined(LUA_CORE)
+#include <time.h>
+#define luai_makeseed(L)	((unsigned int)time(NULL) ^ \
+				 (unsigned int)(size_t)(L))
+#endif
+
+
 
 /*
 ** {==================================================================
@@ -464,6 +569,9 @@
 /*
 @@ LUAI_MAXCCALLS is the maximum depth for nested C calls (short) and
 @* syntactical nested non-terminals in a program.
+** It is only the default: `lua_setcstacklimit' (and
+** `debug.setcstacklimit') change it for a state, up to twice this value;
+** a thread running on a 1 MB C stack must survive that depth.
 */
 #define LUAI_MAXCCALLS		200
 
@@ -514,16 +622,37 @@
 /*
 @@ LUA_NUMBER_SCAN is the format for reading numbers.
 @@ LUA_NUMBER_FMT is the format for writing numbers.
-@@ lua_number2str converts a number to a string.
+@@ lua_number2str converts a number to a string (and gives its length).
 @@ LUAI_MAXNUMBER2STR is maximum size of previous conversion.
 @@ lua_str2number converts a string to a number.
 */
 #define LUA_NUMBER_SCAN		"%lf"
 #define LUA_NUMBER_FMT		"%.14g"
-#define lua_number2str(s,n)	sprintf((s), LUA_NUMBER_FMT, (n))
+#define lua_number2str(s,n)	luaO_num2str((s), (n))
 #define LUAI_MAXNUMBER2STR	32 /* 16 digits, sign, point, and \0 */
 #define lua_str2number(s,p)	strtod((s), (p))
 
+/*
+@@ LUA_NUMBER_SHORTEST makes numbers convert to the shortest string that
+@* reads back as the same number (so 0.1 gives "0.1" and 1/3 gives all
+@* 16 digits) instead of using LUA_NUMBER_FMT. Numbers keep %.14g
+@* style: an exponent is used below 1e-4 and from 1e17 on.
+** CHANGE it (define it) if your programs need numbers to survive a trip
+** through strings (e.g., when writing JSON or CSV). By default the output
+** of standard Lua is kept.
+*/
+/* #define LUA_NUMBER_SHORTEST */
+
+/*
+@@ LUA_INTSUBTYPE gives numbers holding an exact 'int' a subtype of
+@* their own, so that numeric 'for' loops, +, -, * and table indexing
+@* with such numbers run without floating point. The subtype is internal:
+@* scripts and the API see the same numbers with or without it.
+** CHANGE it (undefine it) if your lua_Number cannot hold every 'int'
+** exactly or if you want the interpreter to be a bit smaller.
+*/
+#define LUA_INTSUBTYPE
+
 
 /*
 @@ The luai_num* macros define the primitive operations over numbers.
@@ -633,6 +762,16 @@ union luai_Cast { double l_d; long l_l; };
 #define LUA_MAXCAPTURES		32
 
 
+/*
+@@ LUA_PATCACHE is the number of compiled patterns that the string
+@* library keeps per state.
+** CHANGE it if your programs cycle through more distinct patterns than
+** this in their inner loops. Patterns are evicted least recently used
+** first; 0 is not allowed.
+*/
+#define LUA_PATCACHE		32
+
+
 /*
 @@ lua_tmpnam is the function that the OS library uses to create a
 @* temporary name.
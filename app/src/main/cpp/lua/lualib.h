@@ -14,6 +14,21 @@
 /* Key to file-handle type */
 #define LUA_FILEHANDLE		"FILE*"
 
+/* Key to mapped-file type */
+#define LUA_MMAPHANDLE		"MMAP*"
+
+/* Key to string-builder type */
+#define LUA_STRBUILDER		"string.builder"
+
+/* Metafield of userdata whose bytes can be read in place: a function
+   returning the first byte (as a light userdata) and the length */
+#define LUA_BUFFERFIELD		"__buffer"
+
+/* Registry table whose keys are the LUA_BUFFERFIELD functions to trust;
+   each one checks from C that its argument is one of its own userdata,
+   as Lua code can change the metatables that hold them */
+#define LUA_BUFFERREADERS	"_BUFFERREADERS"
+
 
 #define LUA_COLIBNAME	"coroutine"
 LUALIB_API int (luaopen_base) (lua_State *L);
@@ -29,10 +44,21 @@ LUALIB_API int (luaopen_os) (lua_State *L);
 
 #define LUA_STRLIBNAME	"string"
 LUALIB_API int (luaopen_string) (lua_State *L);
+LUALIB_API int (luaI_strfind) (lua_State *L, const char *s, size_t l,
+                               int find);
 
 #define LUA_MATHLIBNAME	"math"
 LUALIB_API int (luaopen_math) (lua_State *L);
 
+#define LUA_BITLIBNAME	"bit"
+LUALIB_API int (luaopen_bit) (lua_State *L);
+
+#define LUA_STRUCTLIBNAME	"struct"
+LUALIB_API int (luaopen_struct) (lua_State *L);
+
+#define LUA_JSONLIBNAME	"json"
+LUALIB_API int (luaopen_json) (lua_State *L);
+
 #define LUA_DBLIBNAME	"debug"
 LUALIB_API int (luaopen_debug) (lua_State *L);
 
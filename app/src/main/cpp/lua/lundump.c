@@ -102,7 +102,7 @@ static void LoadConstants(LoadState *S, Proto *f) {
                 break;
             case LUA_TBOOLEAN: setbvalue(o, LoadChar(S) != 0);
                 break;
-            case LUA_TNUMBER: setnvalue(o, LoadNumber(S));
+            case LUA_TNUMBER: luaO_setnumber(o, LoadNumber(S));
                 break;
             case LUA_TSTRING:
                 setsvalue2n (S->L, o, LoadString(S));
@@ -143,7 +143,7 @@ static void LoadDebug(LoadState *S, Proto *f) {
 
 static Proto *LoadFunction(LoadState *S, TString *p) {
     Proto *f;
-    if (++S->L->nCcalls > LUAI_MAXCCALLS) error(S, "code too deep");
+    if (++S->L->nCcalls > G(S->L)->maxccalls) error(S, "code too deep");
     f = luaF_newproto(S->L);
     setptvalue2s(S->L, S->L->top, f);
     incr_top(S->L);
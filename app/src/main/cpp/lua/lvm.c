@@ -5,6 +5,7 @@
 */
 
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -46,8 +47,8 @@ int luaV_tostring(lua_State *L, StkId obj) {
     else {
         char       s[LUAI_MAXNUMBER2STR];
         lua_Number n = nvalue(obj);
-        lua_number2str(s, n);
-        setsvalue2s(L, obj, luaS_new(L, s));
+        int        l = lua_number2str(s, n);
+        setsvalue2s(L, obj, luaS_newlstr(L, s, l));
         return 1;
     }
 }
@@ -195,7 +196,7 @@ static int call_orderTM(lua_State *L, const TValue *p1, const TValue *p2,
 }
 
 
-static int l_strcmp(const TString *ls, const TString *rs) {
+int luaV_strcmp(const TString *ls, const TString *rs) {
     const char *l = getstr(ls);
     size_t     ll = ls->tsv.len;
     const char *r = getstr(rs);
@@ -222,12 +223,14 @@ static int l_strcmp(const TString *ls, const TString *rs) {
 
 int luaV_lessthan(lua_State *L, const TValue *l, const TValue *r) {
     int res;
-    if (ttype(l) != ttype(r))
+    if (ttisint(l) && ttisint(r))
+        return ivalue(l) < ivalue(r);
+    else if (ttype(l) != ttype(r))
         return luaG_ordererror(L, l, r);
     else if (ttisnumber(l))
         return luai_numlt(nvalue(l), nvalue(r));
     else if (ttisstring(l))
-        return l_strcmp(rawtsvalue(l), rawtsvalue(r)) < 0;
+        return luaV_strcmp(rawtsvalue(l), rawtsvalue(r)) < 0;
     else if ((res = call_orderTM(L, l, r, TM_LT)) != -1)
         return res;
     return luaG_ordererror(L, l, r);
@@ -236,12 +239,14 @@ int luaV_lessthan(lua_State *L, const TValue *l, const TValue *r) {
 
 static int lessequal(lua_State *L, const TValue *l, const TValue *r) {
     int res;
-    if (ttype(l) != ttype(r))
+    if (ttisint(l) && ttisint(r))
+        return ivalue(l) <= ivalue(r);
+    else if (ttype(l) != ttype(r))
         return luaG_ordererror(L, l, r);
     else if (ttisnumber(l))
         return luai_numle(nvalue(l), nvalue(r));
     else if (ttisstring(l))
-        return l_strcmp(rawtsvalue(l), rawtsvalue(r)) <= 0;
+        return luaV_strcmp(rawtsvalue(l), rawtsvalue(r)) <= 0;
     else if ((res = call_orderTM(L, l, r, TM_LE)) != -1)  /* first try `le' */
         return res;
     else if ((res = call_orderTM(L, r, l, TM_LT)) != -1)  /* else try `lt' */
@@ -262,6 +267,8 @@ int luaV_equalval(lua_State *L, const TValue *t1, const TValue *t2) {
             return bvalue(t1) == bvalue(t2);  /* true must be 1 !! */
         case LUA_TLIGHTUSERDATA:
             return pvalue(t1) == pvalue(t2);
+        case LUA_TSTRING:
+            return luaS_eqstr(rawtsvalue(t1), rawtsvalue(t2));
         case LUA_TUSERDATA: {
             if (uvalue(t1) == uvalue(t2)) return 1;
             tm = get_compTM(L, uvalue(t1)->metatable, uvalue(t2)->metatable,
@@ -350,6 +357,60 @@ static void Arith(lua_State *L, StkId ra, const TValue *rb,
 
 
 
+/*
+** {======================================================
+** Operations over the integer subtype (see LUA_INTSUBTYPE): each one
+** sets `r' and is true when the result is an exact `int' other than -0;
+** otherwise the operation is redone with lua_Numbers.
+** =======================================================
+*/
+
+#define luai_intadd(r, a, b) \
+    ((r) = cast_int(cast(unsigned int, a) + cast(unsigned int, b)), \
+     (((a) ^ (r)) & ((b) ^ (r))) >= 0)
+
+#define luai_intsub(r, a, b) \
+    ((r) = cast_int(cast(unsigned int, a) - cast(unsigned int, b)), \
+     (((a) ^ (b)) & ((a) ^ (r))) >= 0)
+
+#define luai_intmul(r, a, b)    intmul(&(r), a, b)
+
+#define luai_intmod(r, a, b)    intmod(&(r), a, b)
+
+#define luai_intnone(r, a, b)    ((void) (r), 0)
+
+
+static int intmul(int *r, int a, int b) {
+    int64_t m = cast(int64_t, a) * b;
+    if (m < INT_MIN || m > INT_MAX)
+        return 0;
+    if (m == 0 && (a | b) < 0)
+        return 0;  /* -0 */
+    *r = cast_int(m);
+    return 1;
+}
+
+
+/*
+** `luai_nummod' is exact over `int's, so this gives the same floored
+** modulo; its zeros are +0 too
+*/
+static int intmod(int *r, int a, int b) {
+    if (b == 0)
+        return 0;  /* nan */
+    if (b == -1)
+        *r = 0;  /* (INT_MIN % -1 would overflow) */
+    else {
+        *r = a % b;
+        if (*r != 0 && (*r ^ b) < 0)
+            *r += b;  /* C truncates, Lua floors */
+    }
+    return 1;
+}
+
+/* }====================================================== */
+
+
 /*
 ** some macros for common tasks in `luaV_execute'
 */
@@ -373,11 +434,33 @@ static void Arith(lua_State *L, StkId ra, const TValue *rb,
 #define Protect(x)    { L->savedpc = pc; {x;}; base = L->base; }
 
 
-#define arith_op(op, tm) { \
-        TValue *rb = RKB(i); \
-        TValue *rc = RKC(i); \
-        if (ttisnumber(rb) && ttisnumber(rc)) { \
-          lua_Number nb = nvalue(rb), nc = nvalue(rc); \
+/* `n' gets the value of `o' if it is a number (not a string) */
+#define tonumns(o, n) \
+    (ttisfloat(o) ? ((n) = fltvalue(o), 1) : \
+     ttisint(o) ? ((n) = cast_num(ivalue(o)), 1) : 0)
+
+/*
+** slot of `int' key `k' in the array part of `h' when a primitive access
+** does it all (the slot holds a value or `h' has no metatable), or NULL
+*/
+#define arrayslot(h, k) \
+    ((cast(unsigned int, k) - 1 < cast(unsigned int, (h)->sizearray) && \
+      (!ttisnil(&(h)->array[(k) - 1]) || (h)->metatable == NULL)) ? \
+     &(h)->array[(k) - 1] : NULL)
+
+#define arith_op(op, iop, tm) { \
+        TValue     *rb = RKB(i); \
+        TValue     *rc = RKC(i); \
+        lua_Number nb, nc; \
+        int        ir; \
+        if (ttisfloat(rb) && ttisfloat(rc)) { \
+          setnvalue(ra, op(fltvalue(rb), fltvalue(rc))); \
+        } \
+        else if (luai_likely(ttisint(rb) && ttisint(rc)) && \
+                 iop(ir, ivalue(rb), ivalue(rc))) { \
+          setivalue(ra, ir); \
+        } \
+        else if (tonumns(rb, nb) && tonumns(rc, nc)) { \
           setnvalue(ra, op(nb, nc)); \
         } \
         else \
@@ -449,7 +532,16 @@ void luaV_execute(lua_State *L, int nexeccalls) {
                 continue;
             }
             case OP_GETTABLE: {
-                Protect(luaV_gettable(L, RB(i), RKC(i), ra));
+                TValue *rb = RB(i);
+                TValue *rc = RKC(i);
+                if (ttistable(rb) && ttisint(rc)) {
+                    TValue *slot = arrayslot(hvalue(rb), ivalue(rc));
+                    if (slot != NULL) {
+                        setobj2s(L, ra, slot);
+                        continue;
+                    }
+                }
+                Protect(luaV_gettable(L, rb, rc, ra));
                 continue;
             }
             case OP_SETGLOBAL: {
@@ -466,7 +558,17 @@ void luaV_execute(lua_State *L, int nexeccalls) {
                 continue;
             }
             case OP_SETTABLE: {
-                Protect(luaV_settable(L, ra, RKB(i), RKC(i)));
+                TValue *rb = RKB(i);
+                TValue *rc = RKC(i);
+                if (ttistable(ra) && ttisint(rb)) {
+                    TValue *slot = arrayslot(hvalue(ra), ivalue(rb));
+                    if (slot != NULL) {
+                        setobj2t(L, slot, rc);
+                        luaC_barriert(L, hvalue(ra), rc);
+                        continue;
+                    }
+                }
+                Protect(luaV_settable(L, ra, rb, rc));
                 continue;
             }
             case OP_NEWTABLE: {
@@ -483,32 +585,35 @@ void luaV_execute(lua_State *L, int nexeccalls) {
                 continue;
             }
             case OP_ADD: {
-                arith_op(luai_numadd, TM_ADD);
+                arith_op(luai_numadd, luai_intadd, TM_ADD);
                 continue;
             }
             case OP_SUB: {
-                arith_op(luai_numsub, TM_SUB);
+                arith_op(luai_numsub, luai_intsub, TM_SUB);
                 continue;
             }
             case OP_MUL: {
-                arith_op(luai_nummul, TM_MUL);
+                arith_op(luai_nummul, luai_intmul, TM_MUL);
                 continue;
             }
             case OP_DIV: {
-                arith_op(luai_numdiv, TM_DIV);
+                arith_op(luai_numdiv, luai_intnone, TM_DIV);
                 continue;
             }
             case OP_MOD: {
-                arith_op(luai_nummod, TM_MOD);
+                arith_op(luai_nummod, luai_intmod, TM_MOD);
                 continue;
             }
             case OP_POW: {
-                arith_op(luai_numpow, TM_POW);
+                arith_op(luai_numpow, luai_intnone, TM_POW);
                 continue;
             }
             case OP_UNM: {
                 TValue *rb = RB(i);
-                if (ttisnumber(rb)) {
+                if (ttisint(rb) && ivalue(rb) != 0 && ivalue(rb) != INT_MIN) {
+                    setivalue(ra, -ivalue(rb));  /* (neither -0 nor overflow) */
+                }
+                else if (ttisnumber(rb)) {
                     lua_Number nb = nvalue(rb);
                     setnvalue(ra, luai_numunm(nb));
                 }
@@ -526,11 +631,17 @@ void luaV_execute(lua_State *L, int nexeccalls) {
                 const TValue *rb = RB(i);
                 switch (ttype(rb)) {
                     case LUA_TTABLE: {
-                        setnvalue(ra, cast_num(luaH_getn(hvalue(rb))));
+                        setivalue(ra, luaH_getn(hvalue(rb)));
                         break;
                     }
                     case LUA_TSTRING: {
-                        setnvalue(ra, cast_num(tsvalue(rb)->len));
+                        size_t l = tsvalue(rb)->len;
+                        if (l <= MAX_INT) {
+                            setivalue(ra, cast_int(l));
+                        }
+                        else {
+                            setnvalue(ra, cast_num(l));
+                        }
                         break;
                     }
                     default: {  /* try metamethod */
@@ -557,26 +668,48 @@ void luaV_execute(lua_State *L, int nexeccalls) {
             case OP_EQ: {
                 TValue *rb = RKB(i);
                 TValue *rc = RKC(i);
-                Protect(
-                        if (equalobj(L, rb, rc) == GETARG_A(i))
-                            dojump(L, pc, GETARG_sBx(*pc));
-                )
+                if (ttisint(rb) && ttisint(rc)) {
+                    if ((ivalue(rb) == ivalue(rc)) == GETARG_A(i))
+                        dojump(L, pc, GETARG_sBx(*pc));
+                }
+                else {
+                    Protect(
+                            if (equalobj(L, rb, rc) == GETARG_A(i))
+                                dojump(L, pc, GETARG_sBx(*pc));
+                    )
+                }
                 pc++;
                 continue;
             }
             case OP_LT: {
-                Protect(
-                        if (luaV_lessthan(L, RKB(i), RKC(i)) == GETARG_A(i))
-                            dojump(L, pc, GETARG_sBx(*pc));
-                )
+                TValue *rb = RKB(i);
+                TValue *rc = RKC(i);
+                if (ttisint(rb) && ttisint(rc)) {
+                    if ((ivalue(rb) < ivalue(rc)) == GETARG_A(i))
+                        dojump(L, pc, GETARG_sBx(*pc));
+                }
+                else {
+                    Protect(
+                            if (luaV_lessthan(L, rb, rc) == GETARG_A(i))
+                                dojump(L, pc, GETARG_sBx(*pc));
+                    )
+                }
                 pc++;
                 continue;
             }
             case OP_LE: {
-                Protect(
-                        if (lessequal(L, RKB(i), RKC(i)) == GETARG_A(i))
-                            dojump(L, pc, GETARG_sBx(*pc));
-                )
+                TValue *rb = RKB(i);
+                TValue *rc = RKC(i);
+                if (ttisint(rb) && ttisint(rc)) {
+                    if ((ivalue(rb) <= ivalue(rc)) == GETARG_A(i))
+                        dojump(L, pc, GETARG_sBx(*pc));
+                }
+                else {
+                    Protect(
+                            if (lessequal(L, rb, rc) == GETARG_A(i))
+                                dojump(L, pc, GETARG_sBx(*pc));
+                    )
+                }
                 pc++;
                 continue;
             }
@@ -620,6 +753,8 @@ void luaV_execute(lua_State *L, int nexeccalls) {
                 if (b != 0) L->top = ra + b;  /* else previous instruction set top */
                 L->savedpc         = pc;
                 lua_assert(GETARG_C(i) - 1 == LUA_MULTRET);
+                if (luaD_pretailcall(L, ra))  /* Lua function in this frame? */
+                    goto reentry;
                 switch (luaD_precall(L, ra, LUA_MULTRET)) {
                     case PCRLUA: {
                         /* tail call: put new frame in place of previous one */
@@ -663,14 +798,28 @@ void luaV_execute(lua_State *L, int nexeccalls) {
                 }
             }
             case OP_FORLOOP: {
-                lua_Number step  = nvalue(ra + 2);
-                lua_Number idx   = luai_numadd(nvalue(ra), step); /* increment index */
-                lua_Number limit = nvalue(ra + 1);
-                if (luai_numlt(0, step) ? luai_numle(idx, limit)
-                                        : luai_numle(limit, idx)) {
-                    dojump(L, pc, GETARG_sBx(i));  /* jump back */
-                    setnvalue(ra, idx);  /* update internal index... */
-                    setnvalue(ra + 3, idx);  /* ...and external index */
+                if (luai_likely(ttisint(ra) && ttisint(ra + 1) && ttisint(ra + 2))) {
+                    int istep  = ivalue(ra + 2);
+                    int ilimit = ivalue(ra + 1);
+                    int iidx;
+                    /* past the `int' range is past the limit too */
+                    if (luai_intadd(iidx, ivalue(ra), istep) &&
+                        (0 < istep ? iidx <= ilimit : ilimit <= iidx)) {
+                        dojump(L, pc, GETARG_sBx(i));  /* jump back */
+                        setivalue(ra, iidx);  /* update internal index... */
+                        setivalue(ra + 3, iidx);  /* ...and external index */
+                    }
+                }
+                else {
+                    lua_Number step  = nvalue(ra + 2);
+                    lua_Number idx   = luai_numadd(nvalue(ra), step); /* increment index */
+                    lua_Number limit = nvalue(ra + 1);
+                    if (luai_numlt(0, step) ? luai_numle(idx, limit)
+                                            : luai_numle(limit, idx)) {
+                        dojump(L, pc, GETARG_sBx(i));  /* jump back */
+                        setnvalue(ra, idx);  /* update internal index... */
+                        setnvalue(ra + 3, idx);  /* ...and external index */
+                    }
                 }
                 continue;
             }
@@ -685,6 +834,14 @@ void luaV_execute(lua_State *L, int nexeccalls) {
                     luaG_runerror(L, LUA_QL("for") " limit must be a number");
                 else if (!tonumber(pstep, ra + 2))
                     luaG_runerror(L, LUA_QL("for") " step must be a number");
+                if (ttisint(ra) && ttisint(plimit) && ttisint(pstep)) {
+                    int iidx;
+                    if (luai_intsub(iidx, ivalue(ra), ivalue(pstep))) {
+                        setivalue(ra, iidx);  /* loop over `int's */
+                        dojump(L, pc, GETARG_sBx(i));
+                        continue;
+                    }
+                }
                 setnvalue(ra, luai_numsub(nvalue(ra), nvalue(pstep)));
                 dojump(L, pc, GETARG_sBx(i));
                 continue;
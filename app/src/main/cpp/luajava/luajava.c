@@ -55,6 +55,8 @@
 #define LUACALLMETAMETHODTAG  "__call"
 /* Constant that defines where in the metatable should I place the function name */
 #define LUAJAVAOBJFUNCCALLED  "__FunctionCalled"
+/* Environment of every java object, out of reach of Lua code */
+#define LUAJAVAOBJECTENV      "LuaJavaObjectEnv"
 
 
 static jclass    throwable_class      = NULL;
@@ -142,6 +144,28 @@ static int classIndex(lua_State *L);
 static int gc(lua_State *L);
 
 
+/***************************************************************************
+*
+* $FC Function javaBuffer
+*
+* $ED Description
+*    Function to be called by the metafield __buffer of the java object,
+*    so that libraries such as struct can read a direct ByteBuffer in place.
+*    Lua code can change the metatable of a java object, so the object is
+*    recognized by its environment, the upvalue of the function
+*
+* $EP Function Parameters
+*    $P L - lua State
+*    $P Stack - Parameters will be received by the stack
+*
+* $FV Returned Value
+*    int - Number of values to be returned by the function
+*
+*$. **********************************************************************/
+
+static int javaBuffer(lua_State *L);
+
+
 /***************************************************************************
 *
 * $FC Function javaBindClass
@@ -729,6 +753,53 @@ int gc(lua_State *L) {
 }
 
 
+/***************************************************************************
+*
+*  Function: javaBuffer
+*  ****/
+
+int javaBuffer(lua_State *L) {
+    jobject *pObj;
+    JNIEnv  *javaEnv;
+    void    *address;
+    jlong   capacity;
+
+    if (!lua_isuserdata(L, 1)) {
+        lua_pushstring(L, "Not a valid Java Object.");
+        lua_error(L);
+    }
+    lua_getfenv(L, 1);
+    if (!lua_rawequal(L, -1, lua_upvalueindex(1))) {
+        lua_pushstring(L, "Not a valid Java Object.");
+        lua_error(L);
+    }
+    lua_pop(L, 1);
+
+    pObj = (jobject *) lua_touserdata(L, 1);
+
+    /* Gets the JNI Environment */
+    javaEnv = getEnvFromState(L);
+    if (javaEnv == NULL) {
+        lua_pushstring(L, "Invalid JNI Environment.");
+        lua_error(L);
+    }
+
+    /* Only direct buffers have an address; the bytes stay valid while
+       the object (held by its global reference) is alive */
+    address  = (*javaEnv)->GetDirectBufferAddress(javaEnv, *pObj);
+    capacity = (*javaEnv)->GetDirectBufferCapacity(javaEnv, *pObj);
+    if (address == NULL || capacity < 0) {
+        lua_pushstring(L, "Not a direct ByteBuffer.");
+        lua_error(L);
+    }
+
+    lua_pushlightuserdata(L, address);
+    lua_pushnumber(L, (lua_Number) capacity);
+
+    return 2;
+}
+
+
 /***************************************************************************
 *
 *  Function: javaBindClass
@@ -1252,6 +1323,19 @@ int pushJavaObject(lua_State *L, jobject javaObject) {
     lua_pushboolean(L, 1);
     lua_rawset(L, -3);
 
+    //压入__buffer方法(直接缓冲区的字节),并设置对象的环境
+    lua_pushstring(L, LUAJAVAOBJECTENV);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    if (lua_istable(L, -1)) {
+        lua_pushstring(L, LUA_BUFFERFIELD);
+        lua_pushvalue(L, -1);
+        lua_rawget(L, -3);
+        lua_rawset(L, -4);
+        lua_setfenv(L, -3);
+    }
+    else
+        lua_pop(L, 1);
+
     //设置元表
     if (lua_setmetatable(L, -2) == 0) {
         lua_pushstring(L, "Cannot create proxy to java object.");
@@ -1459,6 +1543,20 @@ JNIEXPORT void JNICALL Java_org_keplerproject_luajava_LuaState_luajava_1open
     lua_newtable(L);
     lua_setglobal(L, "luajava");
 
+    //创建java对象的环境,其__buffer方法是受信任的缓冲区读取函数
+    lua_pushstring(L, LUAJAVAOBJECTENV);
+    lua_newtable(L);
+    lua_pushstring(L, LUA_BUFFERFIELD);
+    lua_pushvalue(L, -2);
+    lua_pushcclosure(L, &javaBuffer, 1);
+    luaL_findtable(L, LUA_REGISTRYINDEX, LUA_BUFFERREADERS, 1);
+    lua_pushvalue(L, -2);
+    lua_pushboolean(L, 1);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+    lua_rawset(L, -3);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+
     lua_getglobal(L, "luajava");
     set_info(L);
 
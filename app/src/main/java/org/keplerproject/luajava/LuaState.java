@@ -263,6 +263,13 @@ public class LuaState {
     final public static Integer LUA_GCSTEP       = new Integer(5);
     final public static Integer LUA_GCSETPAUSE   = new Integer(6);
     final public static Integer LUA_GCSETSTEPMUL = new Integer(7);
+    final public static Integer LUA_GCGEN        = new Integer(8);
+    final public static Integer LUA_GCINC        = new Integer(9);
+    final public static Integer LUA_GCSETMAJORINC = new Integer(10);
+    final public static Integer LUA_GCSETBUDGETUS = new Integer(11);
+    final public static Integer LUA_GCPAUSEHIST  = new Integer(12);
+    final public static Integer LUA_GCBGSWEEP    = new Integer(13);
+    final public static Integer LUA_GCHISTSIZE   = new Integer(16);
 
     private synchronized native int _gc(CPtr ptr, int what, int data);
 
@@ -636,6 +643,29 @@ public class LuaState {
         return _getGcCount(luaState);
     }
 
+    /**
+     * Limits each incremental GC step to about <code>us</code> microseconds
+     * (0 removes the limit). Returns the previous limit.
+     */
+    public int setGcBudgetUs(int us) {
+        return _gc(luaState, LUA_GCSETBUDGETUS.intValue(), us);
+    }
+
+    /**
+     * Returns the GC pause histogram: element i counts the pauses shorter
+     * than 2^i microseconds, the last element all longer ones.
+     */
+    public int[] getGcPauseHistogram() {
+        int[] hist = new int[LUA_GCHISTSIZE.intValue()];
+        for (int i = 0; i < hist.length; i++)
+            hist[i] = _gc(luaState, LUA_GCPAUSEHIST.intValue(), i);
+        return hist;
+    }
+
+    public void resetGcPauseHistogram() {
+        _gc(luaState, LUA_GCPAUSEHIST.intValue(), -1);
+    }
+
     public int next(int idx) {
         return _next(luaState, idx);
     }